@@ -7,20 +7,40 @@
 
 namespace illumina {
 
+/**
+ * Reads an option name, which may contain spaces (such as 'Move Overhead'),
+ * up to the end of the string or the 'value' keyword.
+ */
+static std::string option_name(std::string_view str) {
+    std::string name;
+    ParseHelper parser(str);
+    while (!parser.finished()) {
+        std::string_view chunk = parser.read_chunk();
+        if (chunk == "value" || chunk.empty()) {
+            break;
+        }
+        if (!name.empty()) {
+            name += ' ';
+        }
+        name += chunk;
+    }
+    return name;
+}
+
 void register_commands(CLIApplication& server) {
     server.register_command("uci", [](const CommandContext& ctx) {
         global_state().uci();
     });
 
     server.register_command("setoption", [](const CommandContext& ctx) {
-        std::string opt_name  = ctx.word_after("name");
+        std::string opt_name  = option_name(ctx.all_after("name"));
         std::string value_str = ctx.word_after("value");
 
         global_state().set_option(opt_name, value_str);
     });
 
     server.register_command("option", [](const CommandContext& ctx) {
-        std::string opt_name  = ctx.word_after("");
+        std::string opt_name  = option_name(ctx.all_after(""));
 
         global_state().display_option_value(opt_name);
     });
@@ -98,6 +118,30 @@ void register_commands(CLIApplication& server) {
         global_state().bench();
     });
 
+    server.register_command("analyze-epd", [](const CommandContext& ctx) {
+        EPDAnalysisSettings settings;
+        if (ctx.has_arg("depth")) {
+            settings.max_depth = ctx.int_after("depth");
+        }
+        if (ctx.has_arg("nodes")) {
+            settings.max_nodes = ctx.int_after("nodes");
+        }
+        if (!settings.max_depth.has_value() && settings.max_nodes == UINT64_MAX) {
+            settings.max_depth = DEFAULT_EPD_ANALYSIS_DEPTH;
+        }
+        settings.n_threads    = int(ctx.int_after("threads", 1));
+        settings.hash_size_mb = size_t(ctx.int_after("hash", DEFAULT_EPD_ANALYSIS_HASH_SIZE_MB));
+
+        global_state().analyze_epd(ctx.word_after(""), settings, ctx.word_after("out", ""));
+    });
+
+    server.register_command("service", [](const CommandContext& ctx) {
+        size_t n_workers = size_t(std::max(ctx.int_after("threads", 1), i64(1)));
+        ui64 slice_nodes = ui64(std::max(ctx.int_after("slice", DEFAULT_SERVICE_SLICE_NODES), i64(1)));
+
+        global_state().run_service(n_workers, slice_nodes, ctx.word_after("socket", ""));
+    });
+
     server.register_command("perft", [](const CommandContext& ctx) {
         if (ctx.has_arg("nobulk")) {
             global_state().perft(int(ctx.int_after("nobulk")), false);
@@ -147,6 +191,12 @@ void register_commands(CLIApplication& server) {
             settings.max_nodes = ctx.int_after("nodes");
         }
 
+        if (ctx.has_arg("movestogo")) {
+            settings.moves_to_go = ctx.int_after("movestogo");
+        }
+
+        settings.ponder = ctx.has_arg("ponder");
+
         bool trace = false;
         if (ctx.has_arg("trace")) {
             trace = true;
@@ -171,10 +221,26 @@ void register_commands(CLIApplication& server) {
         global_state().search(settings, trace);
     });
 
+    server.register_command("savett", [](const CommandContext& ctx) {
+        global_state().save_tt(ctx.word_after(""));
+    });
+
+    server.register_command("loadtt", [](const CommandContext& ctx) {
+        global_state().load_tt(ctx.word_after(""));
+    });
+
+    server.register_command("tt-stats", [](const CommandContext& ctx) {
+        global_state().display_tt_stats();
+    });
+
     server.register_command("stop", [](const CommandContext& ctx) {
         global_state().stop_search();
     });
 
+    server.register_command("ponderhit", [](const CommandContext& ctx) {
+        global_state().ponder_hit();
+    });
+
     server.register_command("quit", [](const CommandContext& ctx) {
         global_state().quit();
     });
@@ -1,13 +1,18 @@
 #include "state.h"
 
 #include <type_traits>
+#include <algorithm>
 #include <climits>
+#include <fstream>
 #include <iomanip>
 
 #include "bench.h"
 #include "cliapplication.h"
+#include "epdanalysis.h"
 #include "evaluation.h"
 #include "endgame.h"
+#include "serviceserver.h"
+#include "tablebase.h"
 #include "transpositiontable.h"
 #include "tunablevalues.h"
 
@@ -60,8 +65,49 @@ static std::string wdl_string(const WDL& wdl) {
     return std::to_string(wdl.w) + " " + std::to_string(wdl.d) + " " + std::to_string(wdl.l);
 }
 
+static double percentage(ui64 part, ui64 total) {
+    return total == 0 ? 0.0 : 100.0 * double(part) / double(total);
+}
+
+static void print_tt_stats(const TranspositionTableStats& stats,
+                           const TranspositionTableOccupancy& occupancy) {
+    ui64 n_filled = occupancy.n_entries - occupancy.n_empty;
+    std::cout << "\tEntries:              " << n_filled << "/" << occupancy.n_entries
+              << " (" << percentage(n_filled, occupancy.n_entries) << "%)" << std::endl;
+    for (size_t age = 0; age < TT_AGE_BUCKETS; ++age) {
+        std::cout << "\t  Age " << age << (age == TT_AGE_BUCKETS - 1 ? "+" : " ")
+                  << "              " << occupancy.by_age[age]
+                  << " (" << percentage(occupancy.by_age[age], occupancy.n_entries) << "%)" << std::endl;
+    }
+
+#ifdef TT_STATS
+    std::cout << "\tProbes:               " << stats.probes << std::endl;
+    std::cout << "\tHits:                 " << stats.hits
+              << " (" << percentage(stats.hits, stats.probes) << "%)" << std::endl;
+    std::cout << "\tKey collisions:       " << stats.key_collisions
+              << " (" << percentage(stats.key_collisions, stats.hits) << "% of hits)" << std::endl;
+    std::cout << "\tStores:               " << stats.stores << std::endl;
+
+    auto print_store_outcome = [&stats](std::string_view name, ui64 count) {
+        std::cout << "\t  " << name << std::string(20 - name.size(), ' ') << count
+                  << " (" << percentage(count, stats.stores) << "%)" << std::endl;
+    };
+    print_store_outcome("Empty entry:", stats.stored_in_empty);
+    print_store_outcome("Other position:", stats.replaced_other_position);
+    print_store_outcome("Missing move:", stats.replaced_missing_move);
+    print_store_outcome("Older search:", stats.replaced_older_search);
+    print_store_outcome("Deeper:", stats.replaced_deeper);
+    print_store_outcome("Better bound:", stats.replaced_better_bound);
+    print_store_outcome("Kept (has move):", stats.kept_entry_with_move);
+    print_store_outcome("Kept:", stats.kept_existing);
+#else
+    std::cout << "\tProbe and store counters are only collected in builds with TT_STATS enabled." << std::endl;
+#endif
+}
+
 void State::new_game() {
-    m_searcher.tt().clear();
+    clear_tt();
+    m_searcher.clear_histories();
     m_eval_random_seed = random(ui64(1), UINT64_MAX);
 }
 
@@ -104,6 +150,21 @@ void State::bench() const {
     std::cout << "\tTotal search time:    "  << results.search_time_ms << " ms" << std::endl;
     std::cout << "\tTotal searched nodes: "  << results.total_nodes << std::endl;
     std::cout << "\tNodes/sec:            "  << results.nps << std::endl;
+    std::cout << "\tEval cache hits:      "  << results.eval_cache_stats.hits << "/" << results.eval_cache_stats.probes
+              << " (" << percentage(results.eval_cache_stats.hits, results.eval_cache_stats.probes) << "%)" << std::endl;
+
+    std::cout << "\nTransposition table statistics." << std::endl;
+    print_tt_stats(results.tt_stats, results.tt_occupancy);
+
+    IndexingBenchResults indexing = illumina::bench_tt_indexing(settings.hash_size_mb);
+    std::cout << "\nTT indexing microbenchmark (" << indexing.n_keys << " keys)." << std::endl;
+    std::cout << "\tModulo:               "  << indexing.modulo_ns_per_key << " ns/key" << std::endl;
+    std::cout << "\tMultiply-shift:       "  << indexing.mul_hi_ns_per_key << " ns/key" << std::endl;
+
+    StopLatencyBenchResults stop_latency = illumina::bench_stop_latency(settings);
+    std::cout << "\nStop latency (" << stop_latency.n_searches << " movetime searches)." << std::endl;
+    std::cout << "\tAverage:              "  << stop_latency.avg_latency_us << " us" << std::endl;
+    std::cout << "\tWorst:                "  << stop_latency.max_latency_us << " us" << std::endl;
 #else
     BenchSettings settings = default_bench_settings();
     BenchResults results = illumina::bench(settings);
@@ -119,6 +180,90 @@ void State::mperft(int depth) const {
     illumina::move_picker_perft(m_board, depth, { true });
 }
 
+void State::analyze_epd(const std::string& path,
+                        const EPDAnalysisSettings& settings,
+                        const std::string& out_path) const {
+    if (searching()) {
+        std::cerr << "Cannot analyze positions while searching." << std::endl;
+        return;
+    }
+
+    std::ifstream in_file(path);
+    if (!in_file) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return;
+    }
+
+    // Read every position, skipping invalid ones.
+    std::vector<EPDEntry> entries;
+    std::string line;
+    for (size_t line_number = 1; std::getline(in_file, line); ++line_number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        try {
+            entries.push_back(parse_epd_entry(line));
+        }
+        catch (const std::exception& e) {
+            std::cerr << path << ":" << line_number << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::ofstream out_file;
+    if (!out_path.empty()) {
+        out_file.open(out_path);
+        if (!out_file) {
+            std::cerr << "Failed to open " << out_path << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "info string Analyzing " << entries.size() << " positions with "
+              << settings.n_threads << " threads" << std::endl;
+
+    EPDAnalysisSettings progress_settings = settings;
+    std::mutex progress_mutex;
+    progress_settings.on_progress = [&progress_mutex, &entries](size_t n_finished) {
+        constexpr size_t PROGRESS_INTERVAL = 1000;
+        if (n_finished % PROGRESS_INTERVAL == 0) {
+            std::unique_lock lock(progress_mutex);
+            std::cout << "info string Analyzed " << n_finished << "/" << entries.size() << " positions" << std::endl;
+        }
+    };
+    EPDAnalysisResults results = illumina::analyze_epd(entries, progress_settings);
+
+    std::ostream& out = out_path.empty() ? std::cout : out_file;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        out << format_epd_result(entries[i], results.results[i]) << '\n';
+    }
+    out.flush();
+
+    std::cout << "info string Analyzed " << entries.size() << " positions in "
+              << results.time_ms << " ms (" << ui64(results.positions_per_second) << " positions/s, "
+              << results.total_nodes << " nodes)" << std::endl;
+}
+
+void State::run_service(size_t n_workers,
+                        ui64 slice_nodes,
+                        const std::string& socket_path) {
+    if (searching()) {
+        std::cerr << "Cannot start the search service while searching." << std::endl;
+        return;
+    }
+
+    SearchService service(n_workers, slice_nodes);
+    ServiceServer server(service);
+    if (socket_path.empty()) {
+        // Requests come from stdin, which only carries JSON from now on.
+        server.serve_stream(std::cin, std::cout);
+        return;
+    }
+
+    std::cout << "info string Serving " << n_workers << " search workers on " << socket_path << std::endl;
+    server.serve_unix_socket(socket_path);
+}
+
 void State::uci() {
     std::cout << "id name Illumina " << ILLUMINA_VERSION_NAME << std::endl;
     std::cout << "id author Thomas Mergener" << std::endl;
@@ -149,6 +294,83 @@ void State::set_option(std::string_view opt_name,
     m_options.option(opt_name).parse_and_set(value_str);
 }
 
+void State::clear_tt() {
+    size_t n_threads = m_options.option<UCIOptionSpin>("Threads").value();
+
+    TimePoint before = Clock::now();
+    m_searcher.tt().clear(n_threads);
+    m_searcher.reset_tt_stats();
+    TimePoint after = Clock::now();
+
+    std::cout << "info string Cleared transposition table in "
+              << delta_ms(after, before) << " ms using up to "
+              << n_threads << " thread(s)" << std::endl;
+}
+
+void State::save_tt(const std::string& path) const {
+    if (searching()) {
+        std::cerr << "Cannot save the transposition table while searching." << std::endl;
+        return;
+    }
+
+    TimePoint before = Clock::now();
+    if (!m_searcher.tt().save(path)) {
+        return;
+    }
+    TimePoint after = Clock::now();
+
+    std::cout << "info string Saved transposition table to " << path
+              << " in " << delta_ms(after, before) << " ms" << std::endl;
+}
+
+void State::load_tt(const std::string& path) {
+    if (searching()) {
+        std::cerr << "Cannot load the transposition table while searching." << std::endl;
+        return;
+    }
+
+    TimePoint before = Clock::now();
+    if (!m_searcher.tt().load(path)) {
+        return;
+    }
+    TimePoint after = Clock::now();
+
+    std::cout << "info string Loaded transposition table from " << path
+              << " in " << delta_ms(after, before) << " ms" << std::endl;
+    report_tt_allocation();
+
+    // The table takes the size it was saved with. Keep the Hash option
+    // in sync, otherwise setting it back to its previous value would
+    // discard the loaded table. Resizing to the same size is a no-op.
+    m_options.option<UCIOptionSpin>("Hash").parse_and_set(std::to_string(m_searcher.tt().size() / (1024 * 1024)));
+}
+
+void State::display_tt_stats() const {
+    if (searching()) {
+        std::cerr << "Cannot display transposition table statistics while searching." << std::endl;
+        return;
+    }
+
+    std::cout << "Transposition table statistics (" << m_searcher.tt().size() / (1024 * 1024) << " MiB)." << std::endl;
+    print_tt_stats(m_searcher.tt_stats(), m_searcher.tt().occupancy());
+}
+
+void State::report_tt_allocation() const {
+    const TranspositionTable& tt = m_searcher.tt();
+    std::cout << "info string Transposition table has "
+              << tt.size() / (1024 * 1024) << " MiB backed by "
+              << memory_backing_name(tt.backing()) << std::endl;
+}
+
+void State::report_syzygy_probe_limit() {
+    int max_pieces = syzygy_max_pieces();
+    int limit      = m_options.option<UCIOptionSpin>("SyzygyProbeLimit").value();
+    if (max_pieces > 0 && limit > max_pieces) {
+        std::cout << "info string Syzygy tablebases are probed up to "
+                  << max_pieces << " pieces, the largest ones loaded." << std::endl;
+    }
+}
+
 void State::check_if_ready() {
     std::cout << "readyok" << std::endl;
 }
@@ -301,6 +523,7 @@ void State::setup_searcher() {
                   << " hashfull " << m_searcher.tt().hash_full()
                   << " nodes "    << res.nodes
                   << " nps "      << ui64((double(res.nodes) / (double(std::max(res.time, ui64(1))) / 1000.0)))
+                  << " tbhits "   << res.tb_hits
                   << " time "     << res.time
                   << std::endl;
     });
@@ -314,6 +537,11 @@ void State::search(SearchSettings settings, bool trace) {
     settings.eval_random_margin  = m_options.option<UCIOptionSpin>("EvalRandomMargin").value();
     settings.eval_rand_seed      = m_eval_random_seed;
     settings.shallow_search_hint = m_options.option<UCIOptionCheck>("OptimizeForShallowSearches").value();
+    settings.numa_aware          = m_options.option<UCIOptionCheck>("NumaAware").value();
+    settings.move_overhead       = m_options.option<UCIOptionSpin>("Move Overhead").value();
+    settings.syzygy_probe_limit  = std::min(int(m_options.option<UCIOptionSpin>("SyzygyProbeLimit").value()),
+                                            syzygy_max_pieces());
+    settings.syzygy_probe_depth  = m_options.option<UCIOptionSpin>("SyzygyProbeDepth").value();
 
     // User might want to override number of search nodes.
     // This is useful when performing node-odds testing on a GUI that
@@ -386,6 +614,10 @@ void State::stop_search() {
     }
 }
 
+void State::ponder_hit() {
+    m_searcher.ponder_hit();
+}
+
 void State::quit() {
     std::exit(EXIT_SUCCESS);
 }
@@ -479,13 +711,37 @@ static void add_tuning_option(UCIOptionManager& options,
 #endif
 
 void State::register_options() {
+    // Clearing the transposition table depends on the number of threads,
+    // so make sure this option exists before any of the TT options.
+    m_options.register_option<UCIOptionSpin>("Threads", 1, 1, UINT16_MAX);
+
+    m_options.register_option<UCIOptionCheck>("LargePages", true)
+        .add_update_handler([this](const UCIOption& opt) {
+            const auto& check = dynamic_cast<const UCIOptionCheck&>(opt);
+            if (m_searcher.tt().set_large_pages(check.value())) {
+                report_tt_allocation();
+                clear_tt();
+            }
+        });
+
+    m_options.register_option<UCIOptionCheck>("NumaAware", false)
+        .add_update_handler([this](const UCIOption& opt) {
+            const auto& check = dynamic_cast<const UCIOptionCheck&>(opt);
+            if (m_searcher.tt().set_numa_interleave(check.value())) {
+                report_tt_allocation();
+                clear_tt();
+            }
+        });
+
     m_options.register_option<UCIOptionSpin>("Hash", TT_DEFAULT_SIZE_MB, 1, 1024 * 1024)
         .add_update_handler([this](const UCIOption& opt) {
             const auto& spin = dynamic_cast<const UCIOptionSpin&>(opt);
-            m_searcher.tt().resize(spin.value() * 1024 * 1024);
+            if (m_searcher.tt().resize(spin.value() * 1024 * 1024)) {
+                report_tt_allocation();
+                clear_tt();
+            }
         });
 
-    m_options.register_option<UCIOptionSpin>("Threads", 1, 1, UINT16_MAX);
     m_options.register_option<UCIOptionSpin>("MultiPV", 1, 1, MAX_PVS);
     m_options.register_option<UCIOptionSpin>("Contempt", 0, -MAX_SCORE, MAX_SCORE);
     m_options.register_option<UCIOptionCheck>("UCI_Chess960", false)
@@ -495,9 +751,37 @@ void State::register_options() {
         });
     m_options.register_option<UCIOptionSpin>("EvalRandomMargin", 0, 0, 1024);
     m_options.register_option<UCIOptionSpin>("OverrideNodesLimit", 0, 0, INT32_MAX);
+    m_options.register_option<UCIOptionSpin>("Move Overhead", LAG_MARGIN, 0, 5000);
     m_options.register_option<UCIOptionCheck>("NormalizeScores", true);
     m_options.register_option<UCIOptionCheck>("UCI_ShowWDL", false);
     m_options.register_option<UCIOptionCheck>("OptimizeForShallowSearches", false);
+    m_options.register_option<UCIOptionCheck>("Ponder", false);
+
+    m_options.register_option<UCIOptionString>("SyzygyPath", "<empty>")
+        .add_update_handler([this](const UCIOption& opt) {
+            const auto& path = dynamic_cast<const UCIOptionString&>(opt);
+            if (path.value() == path.default_value() && syzygy_max_pieces() == 0) {
+                return;
+            }
+            if (searching()) {
+                std::cerr << "Cannot load Syzygy tablebases while searching." << std::endl;
+                return;
+            }
+
+            int max_pieces = syzygy_init(path.value());
+            if (max_pieces > 0) {
+                std::cout << "info string Found " << max_pieces << "-piece Syzygy tablebases." << std::endl;
+                report_syzygy_probe_limit();
+            }
+            else {
+                std::cout << "info string No Syzygy tablebases loaded." << std::endl;
+            }
+        });
+    m_options.register_option<UCIOptionSpin>("SyzygyProbeDepth", 1, 1, MAX_DEPTH);
+    m_options.register_option<UCIOptionSpin>("SyzygyProbeLimit", 7, 0, 7)
+        .add_update_handler([this](const UCIOption&) {
+            report_syzygy_probe_limit();
+        });
 
 #ifdef TUNING_BUILD
 #define TUNABLE_VALUE(name, type, ...) add_tuning_option(m_options, \
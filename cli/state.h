@@ -24,12 +24,28 @@ public:
     void perft(int depth, bool bulk) const;
     void mperft(int depth) const;
 
+    // Batch analysis
+    void analyze_epd(const std::string& path,
+                     const EPDAnalysisSettings& settings,
+                     const std::string& out_path) const;
+
+    // Search service
+    void run_service(size_t n_workers,
+                     ui64 slice_nodes,
+                     const std::string& socket_path);
+
     // Evaluation
     void evaluate() const;
 
     // Search
     void search(SearchSettings settings, bool trace);
     void stop_search();
+    void ponder_hit();
+
+    // Transposition table persistence
+    void save_tt(const std::string& path) const;
+    void load_tt(const std::string& path);
+    void display_tt_stats() const;
 
     // Misc
     void uci();
@@ -59,6 +75,9 @@ private:
 
     void setup_searcher();
     void register_options();
+    void report_tt_allocation() const;
+    void report_syzygy_probe_limit();
+    void clear_tt();
     Score normalize_score_if_desired(Score score, const Board& board) const;
 };
 
@@ -438,6 +438,8 @@ void log_configuration(const NormalOptions& options) {
     while (true) {
         white_searcher.tt().new_search();
         black_searcher.tt().new_search();
+        white_searcher.clear_histories();
+        black_searcher.clear_histories();
 
         Game game = simulate_game(white_searcher, black_searcher, options);
         std::vector<DataPoint> data = select_data_points(game, options);
@@ -0,0 +1,1579 @@
+#include "tbprobe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+unsigned TB_LARGEST = 0;
+
+#define TB_PIECES 7
+#define BIT(sq)   (UINT64_C(1) << (sq))
+#define FILE_OF(sq) ((sq) & 7)
+#define RANK_OF(sq) ((sq) >> 3)
+
+#ifdef _WIN32
+#define PATH_SEPARATOR ';'
+#else
+#define PATH_SEPARATOR ':'
+#endif
+
+/* Piece codes, the same ones table files use. Black pieces add 8. */
+enum { WHITE, BLACK };
+enum { PAWN = 1, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+/* Outcomes from the perspective of the side to move. */
+enum { WDL_LOSS = -2, WDL_BLESSED_LOSS, WDL_DRAW, WDL_CURSED_WIN, WDL_WIN };
+
+/*
+ * Probe states. ZEROING_BEST_MOVE means the best move resets the 50
+ * move counter, for which DTZ tables hold no value. CHANGE_STM means
+ * the DTZ table holds the other side to move.
+ */
+enum { PS_CHANGE_STM = -1, PS_FAIL, PS_OK, PS_ZEROING_BEST_MOVE };
+
+/* Flags of each table part. */
+enum { TBF_STM = 1, TBF_MAPPED = 2, TBF_WIN_PLIES = 4, TBF_LOSS_PLIES = 8, TBF_WIDE = 16, TBF_SINGLE_VALUE = 128 };
+
+/* Flags in the first byte of table files. */
+enum { TBH_SPLIT = 1, TBH_HAS_PAWNS = 2 };
+
+static const uint8_t WDL_MAGIC[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const uint8_t DTZ_MAGIC[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+/*
+ * Values of a table part are compressed with recursive pairing: each
+ * symbol stands for a single value, or for a pair of symbols. Sequences
+ * of symbols are Huffman coded into fixed size blocks.
+ */
+typedef struct {
+    uint8_t        flags;
+    uint8_t        min_sym_len;     /* The value itself for single value parts. */
+    uint8_t        max_sym_len;
+    uint64_t       block_size;
+    uint64_t       span;            /* Values between consecutive sparse index entries. */
+    uint32_t       num_blocks;
+    uint32_t       block_length_size;
+    uint64_t       sparse_index_size;
+    const uint8_t* lowest_sym;      /* Lowest symbol of each code length, 16 bits each. */
+    const uint8_t* btree;           /* Symbols of each pair, 12 bits each. */
+    const uint8_t* sparse_index;    /* Block and offset within it, 6 bytes each. */
+    const uint8_t* block_length;    /* Number of values minus one of each block. */
+    const uint8_t* data;
+    uint64_t       base64[33];      /* Lowest code of each length, left aligned. */
+    uint8_t*       symlen;          /* Number of values minus one of each symbol. */
+    uint8_t        pieces[TB_PIECES];
+    uint64_t       group_idx[TB_PIECES + 1];
+    int            group_len[TB_PIECES + 1];
+    uint16_t       map_idx[4];      /* DTZ maps of wins, losses, cursed wins and blessed losses. */
+} PairsData;
+
+typedef struct {
+    const uint8_t* data;
+    uint64_t       size;
+#ifdef _WIN32
+    HANDLE         mapping;
+#endif
+} MappedFile;
+
+/*
+ * Tables are named after the side listed first, which holds the most
+ * pieces, or the most valuable ones. Its pieces are white in the files.
+ */
+typedef struct {
+    uint32_t       key;             /* Material of the first side, then of the second one. */
+    int            piece_count;
+    bool           has_pawns;
+    bool           has_unique_pieces;
+    bool           symmetric;
+    uint8_t        pawn_count[2];   /* Pawns of the leading color, then of the other one. */
+    MappedFile     wdl_file;
+    MappedFile     dtz_file;
+    bool           has_dtz;
+    const uint8_t* dtz_map;
+    PairsData      wdl[2][4];       /* [side to move][file of the leading pawn] */
+    PairsData      dtz[4];
+} Table;
+
+typedef struct {
+    uint64_t colors[2];
+    uint64_t types[KING + 1];
+    int      turn;
+    int      ep;
+    unsigned rule50;
+} Pos;
+
+typedef uint16_t Move;
+
+#define MOVE_FROM(m)     ((int) ((m) & 0x3F))
+#define MOVE_TO(m)       ((int) (((m) >> 6) & 0x3F))
+#define MOVE_PROMOTES(m) ((unsigned) ((m) >> 12))
+#define MAKE_MOVE(from, to, promotes) ((Move) ((from) | ((to) << 6) | ((promotes) << 12)))
+
+static Table* s_tables   = NULL;
+static size_t s_n_tables = 0;
+
+static uint64_t s_king_attacks[64];
+static uint64_t s_knight_attacks[64];
+static uint64_t s_pawn_attacks[2][64];
+
+static int      s_map_pawns[64];
+static int      s_map_b1h1h7[64];
+static int      s_map_a1d1d4[64];
+static int      s_map_kk[10][64];
+static uint64_t s_binomial[6][64];
+static uint64_t s_lead_pawn_idx[6][64];
+static uint64_t s_lead_pawns_size[6][4];
+
+/*
+ * Bit utilities.
+ */
+
+static int popcount(uint64_t bb) {
+    int n = 0;
+    for (; bb; bb &= bb - 1) {
+        n++;
+    }
+    return n;
+}
+
+static int lsb(uint64_t bb) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bb);
+#else
+    int sq = 0;
+    while (!(bb & BIT(sq))) {
+        sq++;
+    }
+    return sq;
+#endif
+}
+
+static int pop_lsb(uint64_t* bb) {
+    int sq = lsb(*bb);
+    *bb &= *bb - 1;
+    return sq;
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t* p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t read_be32(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+/*
+ * Attacks and moves.
+ */
+
+static uint64_t leaper_attacks(int sq, const int offsets[][2], int n) {
+    uint64_t attacks = 0;
+    for (int i = 0; i < n; ++i) {
+        int file = FILE_OF(sq) + offsets[i][0];
+        int rank = RANK_OF(sq) + offsets[i][1];
+        if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+            attacks |= BIT(rank * 8 + file);
+        }
+    }
+    return attacks;
+}
+
+static uint64_t slider_attacks(int sq, uint64_t occ, const int dirs[4][2]) {
+    uint64_t attacks = 0;
+    for (int i = 0; i < 4; ++i) {
+        int file = FILE_OF(sq) + dirs[i][0];
+        int rank = RANK_OF(sq) + dirs[i][1];
+        while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+            int to = rank * 8 + file;
+            attacks |= BIT(to);
+            if (occ & BIT(to)) {
+                break;
+            }
+            file += dirs[i][0];
+            rank += dirs[i][1];
+        }
+    }
+    return attacks;
+}
+
+static uint64_t rook_attacks(int sq, uint64_t occ) {
+    static const int DIRS[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+    return slider_attacks(sq, occ, DIRS);
+}
+
+static uint64_t bishop_attacks(int sq, uint64_t occ) {
+    static const int DIRS[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+    return slider_attacks(sq, occ, DIRS);
+}
+
+static void init_attacks(void) {
+    static const int KING_OFFSETS[8][2]   = { {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+    static const int KNIGHT_OFFSETS[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+    static const int WHITE_PAWN_OFFSETS[2][2] = { {-1, 1}, {1, 1} };
+    static const int BLACK_PAWN_OFFSETS[2][2] = { {-1, -1}, {1, -1} };
+
+    for (int sq = 0; sq < 64; ++sq) {
+        s_king_attacks[sq]          = leaper_attacks(sq, KING_OFFSETS, 8);
+        s_knight_attacks[sq]        = leaper_attacks(sq, KNIGHT_OFFSETS, 8);
+        s_pawn_attacks[WHITE][sq]   = leaper_attacks(sq, WHITE_PAWN_OFFSETS, 2);
+        s_pawn_attacks[BLACK][sq]   = leaper_attacks(sq, BLACK_PAWN_OFFSETS, 2);
+    }
+}
+
+static uint64_t occupancy(const Pos* pos) {
+    return pos->colors[WHITE] | pos->colors[BLACK];
+}
+
+static int piece_type_on(const Pos* pos, int sq) {
+    for (int type = PAWN; type <= KING; ++type) {
+        if (pos->types[type] & BIT(sq)) {
+            return type;
+        }
+    }
+    return 0;
+}
+
+static int piece_on(const Pos* pos, int sq) {
+    return piece_type_on(pos, sq) | ((pos->colors[BLACK] & BIT(sq)) ? 8 : 0);
+}
+
+static bool is_attacked(const Pos* pos, int sq, int by, uint64_t occ) {
+    uint64_t them = pos->colors[by];
+    return (s_king_attacks[sq] & them & pos->types[KING])
+        || (s_knight_attacks[sq] & them & pos->types[KNIGHT])
+        || (s_pawn_attacks[by ^ 1][sq] & them & pos->types[PAWN])
+        || (rook_attacks(sq, occ) & them & (pos->types[ROOK] | pos->types[QUEEN]))
+        || (bishop_attacks(sq, occ) & them & (pos->types[BISHOP] | pos->types[QUEEN]));
+}
+
+static bool in_check(const Pos* pos) {
+    int king = lsb(pos->colors[pos->turn] & pos->types[KING]);
+    return is_attacked(pos, king, pos->turn ^ 1, occupancy(pos));
+}
+
+static bool is_capture(const Pos* pos, Move move) {
+    int to = MOVE_TO(move);
+    return (pos->colors[pos->turn ^ 1] & BIT(to))
+        || (pos->ep != 0 && to == pos->ep && (pos->types[PAWN] & BIT(MOVE_FROM(move))));
+}
+
+static bool is_pawn_move(const Pos* pos, Move move) {
+    return (pos->types[PAWN] & BIT(MOVE_FROM(move))) != 0;
+}
+
+static Move* add_pawn_moves(Move* moves, int from, int to) {
+    if (RANK_OF(to) == 0 || RANK_OF(to) == 7) {
+        for (unsigned promotes = TB_PROMOTES_QUEEN; promotes <= TB_PROMOTES_KNIGHT; ++promotes) {
+            *moves++ = MAKE_MOVE(from, to, promotes);
+        }
+    }
+    else {
+        *moves++ = MAKE_MOVE(from, to, TB_PROMOTES_NONE);
+    }
+    return moves;
+}
+
+/* Generates the pseudo legal moves of the side to move. */
+static int gen_moves(const Pos* pos, Move* moves) {
+    Move* end     = moves;
+    int us        = pos->turn;
+    uint64_t occ  = occupancy(pos);
+    uint64_t ours = pos->colors[us];
+    uint64_t them = pos->colors[us ^ 1];
+
+    for (uint64_t b = ours & ~pos->types[PAWN]; b;) {
+        int from = pop_lsb(&b);
+        uint64_t targets;
+        switch (piece_type_on(pos, from)) {
+            case KNIGHT: targets = s_knight_attacks[from]; break;
+            case BISHOP: targets = bishop_attacks(from, occ); break;
+            case ROOK:   targets = rook_attacks(from, occ); break;
+            case QUEEN:  targets = rook_attacks(from, occ) | bishop_attacks(from, occ); break;
+            default:     targets = s_king_attacks[from]; break;
+        }
+        for (targets &= ~ours; targets;) {
+            *end++ = MAKE_MOVE(from, pop_lsb(&targets), TB_PROMOTES_NONE);
+        }
+    }
+
+    int push = us == WHITE ? 8 : -8;
+    for (uint64_t b = ours & pos->types[PAWN]; b;) {
+        int from = pop_lsb(&b);
+        int to   = from + push;
+        if (!(occ & BIT(to))) {
+            end = add_pawn_moves(end, from, to);
+            int start_rank = us == WHITE ? 1 : 6;
+            if (RANK_OF(from) == start_rank && !(occ & BIT(to + push))) {
+                *end++ = MAKE_MOVE(from, to + push, TB_PROMOTES_NONE);
+            }
+        }
+        uint64_t captures = s_pawn_attacks[us][from] & (them | (pos->ep != 0 ? BIT(pos->ep) : 0));
+        while (captures) {
+            end = add_pawn_moves(end, from, pop_lsb(&captures));
+        }
+    }
+
+    return (int) (end - moves);
+}
+
+/* Makes a move into next. Returns false if it leaves our king in check. */
+static bool do_move(Pos* next, const Pos* pos, Move move) {
+    int from = MOVE_FROM(move);
+    int to   = MOVE_TO(move);
+    int us   = pos->turn;
+    int them = us ^ 1;
+    int type = piece_type_on(pos, from);
+
+    *next        = *pos;
+    next->turn   = them;
+    next->ep     = 0;
+    next->rule50 = pos->rule50 + 1;
+
+    if (pos->colors[them] & BIT(to)) {
+        next->types[piece_type_on(pos, to)] &= ~BIT(to);
+        next->colors[them]                  &= ~BIT(to);
+        next->rule50                         = 0;
+    }
+
+    next->colors[us]  ^= BIT(from) | BIT(to);
+    next->types[type] ^= BIT(from) | BIT(to);
+
+    if (type == PAWN) {
+        next->rule50 = 0;
+        if (pos->ep != 0 && to == pos->ep) {
+            next->types[PAWN]  &= ~BIT(to ^ 8);
+            next->colors[them] &= ~BIT(to ^ 8);
+        }
+        else if (to - from == 16 || from - to == 16) {
+            /* Only keep en passant squares that can be captured on. */
+            int ep = (from + to) / 2;
+            if (s_pawn_attacks[us][ep] & pos->colors[them] & pos->types[PAWN]) {
+                next->ep = ep;
+            }
+        }
+        if (MOVE_PROMOTES(move) != TB_PROMOTES_NONE) {
+            next->types[PAWN]                           &= ~BIT(to);
+            next->types[KING - MOVE_PROMOTES(move)] |= BIT(to);
+        }
+    }
+
+    int king = lsb(next->colors[us] & next->types[KING]);
+    return !is_attacked(next, king, them, occupancy(next));
+}
+
+static int legal_move_count(const Pos* pos) {
+    Move moves[TB_MAX_MOVES];
+    int n_moves = gen_moves(pos, moves);
+    int count   = 0;
+    for (int i = 0; i < n_moves; ++i) {
+        Pos next;
+        count += do_move(&next, pos, moves[i]);
+    }
+    return count;
+}
+
+static bool is_mate(const Pos* pos) {
+    return in_check(pos) && legal_move_count(pos) == 0;
+}
+
+/*
+ * Table lookup.
+ */
+
+/* Material of a side, as the piece counts from queens to pawns. */
+static uint32_t side_key(const int counts[KING]) {
+    uint32_t key = 0;
+    for (int type = QUEEN; type >= PAWN; --type) {
+        key = key * 8 + (uint32_t) counts[type];
+    }
+    return key;
+}
+
+static int key_piece_count(uint32_t key) {
+    int n = 0;
+    for (; key; key /= 8) {
+        n += (int) (key % 8);
+    }
+    return n;
+}
+
+static uint32_t pos_side_key(const Pos* pos, int color) {
+    int counts[KING] = { 0 };
+    for (int type = PAWN; type < KING; ++type) {
+        counts[type] = popcount(pos->colors[color] & pos->types[type]);
+    }
+    return side_key(counts);
+}
+
+/* Whether a side should be listed before the other one in table names. */
+static bool is_listed_first(uint32_t key, uint32_t other) {
+    int n       = key_piece_count(key);
+    int n_other = key_piece_count(other);
+    return n != n_other ? n > n_other : key >= other;
+}
+
+static int compare_tables(const void* lhs, const void* rhs) {
+    uint32_t a = ((const Table*) lhs)->key;
+    uint32_t b = ((const Table*) rhs)->key;
+    return a < b ? -1 : a > b;
+}
+
+static const Table* find_table(const Pos* pos) {
+    uint32_t white = pos_side_key(pos, WHITE);
+    uint32_t black = pos_side_key(pos, BLACK);
+    Table key;
+    key.key = is_listed_first(white, black) ? (white << 16) | black : (black << 16) | white;
+    return bsearch(&key, s_tables, s_n_tables, sizeof(Table), compare_tables);
+}
+
+/*
+ * Index encoding, which maps positions to the index of their value.
+ */
+
+static int off_a1h8(int sq) {
+    return RANK_OF(sq) - FILE_OF(sq);
+}
+
+static void init_indices(void) {
+    int code = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        if (off_a1h8(sq) < 0) {
+            s_map_b1h1h7[sq] = code++;
+        }
+    }
+
+    /* Squares of the a1-d1-d4 triangle, the diagonal ones last. */
+    code = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        if (off_a1h8(sq) < 0 && FILE_OF(sq) <= 3 && RANK_OF(sq) <= 3) {
+            s_map_a1d1d4[sq] = code++;
+        }
+    }
+    for (int sq = 0; sq < 64; ++sq) {
+        if (off_a1h8(sq) == 0 && FILE_OF(sq) <= 3) {
+            s_map_a1d1d4[sq] = code++;
+        }
+    }
+
+    /*
+     * The 462 placements of two kings with the first one in the a1-d1-d4
+     * triangle. If the first one is on the diagonal, the second one can't
+     * be above it. Placements with both kings on the diagonal go last.
+     */
+    int both_on_diagonal[64][2];
+    int n_both_on_diagonal = 0;
+    code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (int s1 = 0; s1 < 64; ++s1) {
+            if (FILE_OF(s1) > 3 || RANK_OF(s1) > 3 || off_a1h8(s1) > 0 || s_map_a1d1d4[s1] != idx) {
+                continue;
+            }
+            for (int s2 = 0; s2 < 64; ++s2) {
+                if ((s_king_attacks[s1] | BIT(s1)) & BIT(s2)) {
+                    continue;
+                }
+                if (off_a1h8(s1) == 0 && off_a1h8(s2) > 0) {
+                    continue;
+                }
+                if (off_a1h8(s1) == 0 && off_a1h8(s2) == 0) {
+                    both_on_diagonal[n_both_on_diagonal][0]   = idx;
+                    both_on_diagonal[n_both_on_diagonal++][1] = s2;
+                }
+                else {
+                    s_map_kk[idx][s2] = code++;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n_both_on_diagonal; ++i) {
+        s_map_kk[both_on_diagonal[i][0]][both_on_diagonal[i][1]] = code++;
+    }
+
+    s_binomial[0][0] = 1;
+    for (int n = 1; n < 64; ++n) {
+        for (int k = 0; k < 6 && k <= n; ++k) {
+            s_binomial[k][n] = (k > 0 ? s_binomial[k - 1][n - 1] : 0)
+                             + (k < n ? s_binomial[k][n - 1] : 0);
+        }
+    }
+
+    /*
+     * Pawn squares a2-h7 map to 47..0, so that the leading pawn, the one
+     * with the highest value, is the one closest to the edge, and the
+     * lowest one among those on the same file.
+     */
+    int available_squares = 47;
+    for (int lead_pawns_cnt = 1; lead_pawns_cnt <= 5; ++lead_pawns_cnt) {
+        for (int file = 0; file < 4; ++file) {
+            uint64_t idx = 0;
+            for (int rank = 1; rank <= 6; ++rank) {
+                int sq = rank * 8 + file;
+                if (lead_pawns_cnt == 1) {
+                    s_map_pawns[sq]     = available_squares--;
+                    s_map_pawns[sq ^ 7] = available_squares--;
+                }
+                s_lead_pawn_idx[lead_pawns_cnt][sq] = idx;
+                idx += s_binomial[lead_pawns_cnt - 1][s_map_pawns[sq]];
+            }
+            s_lead_pawns_size[lead_pawns_cnt][file] = idx;
+        }
+    }
+}
+
+/* Sorts squares by s_map_pawns, keeping the order of equal ones. */
+static void sort_pawns(int* squares, int n) {
+    for (int i = 1; i < n; ++i) {
+        for (int j = i; j > 0 && s_map_pawns[squares[j]] < s_map_pawns[squares[j - 1]]; --j) {
+            int tmp        = squares[j];
+            squares[j]     = squares[j - 1];
+            squares[j - 1] = tmp;
+        }
+    }
+}
+
+static void sort_squares(int* squares, int n) {
+    for (int i = 1; i < n; ++i) {
+        for (int j = i; j > 0 && squares[j] < squares[j - 1]; --j) {
+            int tmp        = squares[j];
+            squares[j]     = squares[j - 1];
+            squares[j - 1] = tmp;
+        }
+    }
+}
+
+/*
+ * Decompression.
+ */
+
+static uint16_t btree_left(const PairsData* d, int sym) {
+    const uint8_t* lr = d->btree + 3 * sym;
+    return (uint16_t) (((lr[1] & 0xF) << 8) | lr[0]);
+}
+
+static uint16_t btree_right(const PairsData* d, int sym) {
+    const uint8_t* lr = d->btree + 3 * sym;
+    return (uint16_t) ((lr[2] << 4) | (lr[1] >> 4));
+}
+
+/* Returns the value at index idx of a table part. */
+static int decompress_pairs(const PairsData* d, uint64_t idx) {
+    if (d->flags & TBF_SINGLE_VALUE) {
+        return d->min_sym_len;
+    }
+
+    /* Sparse index entry k points to value k * span + span / 2. */
+    uint64_t k      = idx / d->span;
+    uint32_t block  = read_le32(d->sparse_index + 6 * k);
+    int      offset = read_le16(d->sparse_index + 6 * k + 4);
+    offset += (int) (idx % d->span) - (int) (d->span / 2);
+
+    while (offset < 0) {
+        offset += read_le16(d->block_length + 2 * --block) + 1;
+    }
+    while (offset > read_le16(d->block_length + 2 * block)) {
+        offset -= read_le16(d->block_length + 2 * block++) + 1;
+    }
+
+    const uint8_t* ptr = d->data + block * d->block_size;
+    uint64_t buf64     = ((uint64_t) read_be32(ptr) << 32) | read_be32(ptr + 4);
+    int buf64_size     = 64;
+    ptr += 8;
+
+    int sym;
+    for (;;) {
+        /* Symbols of a given length are consecutive, and longer ones have
+         * lower codes. */
+        int len = 0;
+        while (buf64 < d->base64[len]) {
+            ++len;
+        }
+        sym = (int) ((buf64 - d->base64[len]) >> (64 - len - d->min_sym_len));
+        sym += read_le16(d->lowest_sym + 2 * len);
+
+        if (offset < d->symlen[sym] + 1) {
+            break;
+        }
+        offset -= d->symlen[sym] + 1;
+        len    += d->min_sym_len;
+        buf64 <<= len;
+        buf64_size -= len;
+        if (buf64_size <= 32) {
+            buf64_size += 32;
+            buf64 |= (uint64_t) read_be32(ptr) << (64 - buf64_size);
+            ptr += 4;
+        }
+    }
+
+    /* Expand the symbol until reaching the one holding our value. */
+    while (d->symlen[sym]) {
+        int left = btree_left(d, sym);
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        }
+        else {
+            offset -= d->symlen[left] + 1;
+            sym = btree_right(d, sym);
+        }
+    }
+
+    return btree_left(d, sym);
+}
+
+/*
+ * Table parsing.
+ */
+
+static uint8_t set_symlen(PairsData* d, int sym, uint8_t* visited) {
+    visited[sym] = 1;
+    int right    = btree_right(d, sym);
+    if (right == 0xFFF) {
+        return 0;
+    }
+    int left = btree_left(d, sym);
+    if (!visited[left]) {
+        d->symlen[left] = set_symlen(d, left, visited);
+    }
+    if (!visited[right]) {
+        d->symlen[right] = set_symlen(d, right, visited);
+    }
+    return (uint8_t) (d->symlen[left] + d->symlen[right] + 1);
+}
+
+/*
+ * Groups pieces encoded together: pawns of the same color, and pieces of
+ * the same type and color. Pawnless tables lead with 3 unique pieces, or
+ * with the kings if there aren't enough of them. The order of groups
+ * within the index is stored in the file.
+ */
+static void set_groups(const Table* table, PairsData* d, const int order[2], int file) {
+    int n = 0;
+    int first_len = table->has_pawns ? 0 : table->has_unique_pieces ? 3 : 2;
+    d->group_len[n] = 1;
+    for (int i = 1; i < table->piece_count; ++i) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->group_len[n]++;
+        }
+        else {
+            d->group_len[++n] = 1;
+        }
+    }
+    d->group_len[++n] = 0;
+
+    bool pp = table->has_pawns && table->pawn_count[1];
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= table->has_pawns ? s_lead_pawns_size[d->group_len[0]][file]
+                 : table->has_unique_pieces ? 31332 : 462;
+        }
+        else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= s_binomial[d->group_len[1]][48 - d->group_len[0]];
+        }
+        else {
+            d->group_idx[next] = idx;
+            idx *= s_binomial[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+}
+
+/* Reads the compression parameters of a table part. Returns the offset
+ * past them, or 0 if they don't fit in the file. */
+static uint64_t set_sizes(PairsData* d, const MappedFile* file, uint64_t offset) {
+    const uint8_t* data = file->data;
+    if (offset + 2 > file->size) {
+        return 0;
+    }
+
+    d->flags = data[offset++];
+    if (d->flags & TBF_SINGLE_VALUE) {
+        d->num_blocks = d->block_length_size = 0;
+        d->span = d->sparse_index_size = 0;
+        d->min_sym_len = data[offset++];
+        return offset;
+    }
+
+    if (offset + 9 > file->size) {
+        return 0;
+    }
+    int n = 0;
+    while (d->group_len[n]) {
+        n++;
+    }
+    uint64_t tb_size = d->group_idx[n];
+
+    d->block_size        = UINT64_C(1) << data[offset++];
+    d->span              = UINT64_C(1) << data[offset++];
+    d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+    uint8_t padding      = data[offset++];
+    d->num_blocks        = read_le32(data + offset);
+    offset += 4;
+    d->block_length_size = d->num_blocks + padding;
+    d->max_sym_len       = data[offset++];
+    d->min_sym_len       = data[offset++];
+    d->lowest_sym        = data + offset;
+
+    if (d->min_sym_len == 0 || d->max_sym_len > 32 || d->max_sym_len < d->min_sym_len) {
+        return 0;
+    }
+    int n_lengths = d->max_sym_len - d->min_sym_len + 1;
+    if (offset + 2 * (uint64_t) n_lengths + 2 > file->size) {
+        return 0;
+    }
+
+    /* Longer codes have lower values: the lowest code of each length is
+     * half past the codes of the next longer length. */
+    d->base64[n_lengths - 1] = 0;
+    for (int i = n_lengths - 2; i >= 0; --i) {
+        d->base64[i] = (d->base64[i + 1] + read_le16(d->lowest_sym + 2 * i)
+                                          - read_le16(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (int i = 0; i < n_lengths; ++i) {
+        d->base64[i] <<= 64 - i - d->min_sym_len;
+    }
+    offset += 2 * (uint64_t) n_lengths;
+
+    int n_syms = read_le16(data + offset);
+    offset += 2;
+    if (n_syms == 0 || n_syms > 4095 || offset + 3 * (uint64_t) n_syms > file->size) {
+        return 0;
+    }
+    d->btree  = data + offset;
+    d->symlen = calloc((size_t) n_syms, 1);
+    uint8_t* visited = calloc((size_t) n_syms, 1);
+    if (d->symlen == NULL || visited == NULL) {
+        free(visited);
+        return 0;
+    }
+    for (int sym = 0; sym < n_syms; ++sym) {
+        if (!visited[sym]) {
+            d->symlen[sym] = set_symlen(d, sym, visited);
+        }
+    }
+    free(visited);
+
+    return offset + 3 * (uint64_t) n_syms + (n_syms & 1);
+}
+
+static uint64_t set_dtz_map(Table* table, uint64_t offset, int n_files) {
+    const uint8_t* data = table->dtz_file.data;
+    uint64_t map_offset = offset;
+    table->dtz_map      = data + offset;
+
+    for (int f = 0; f < n_files; ++f) {
+        PairsData* d = &table->dtz[f];
+        if (!(d->flags & TBF_MAPPED)) {
+            continue;
+        }
+        if (d->flags & TBF_WIDE) {
+            offset += offset & 1;
+            for (int i = 0; i < 4; ++i) {
+                if (offset + 2 > table->dtz_file.size) {
+                    return 0;
+                }
+                d->map_idx[i] = (uint16_t) ((offset - map_offset) / 2 + 1);
+                offset += 2 * (uint64_t) read_le16(data + offset) + 2;
+            }
+        }
+        else {
+            for (int i = 0; i < 4; ++i) {
+                if (offset + 1 > table->dtz_file.size) {
+                    return 0;
+                }
+                d->map_idx[i] = (uint16_t) (offset - map_offset + 1);
+                offset += (uint64_t) data[offset] + 1;
+            }
+        }
+    }
+
+    return offset + (offset & 1);
+}
+
+/* Parses the header of a WDL or DTZ file. Returns false if it is invalid. */
+static bool parse_table(Table* table, bool dtz) {
+    const MappedFile* file = dtz ? &table->dtz_file : &table->wdl_file;
+    const uint8_t* data    = file->data;
+    int sides              = !dtz && !table->symmetric ? 2 : 1;
+    int n_files            = table->has_pawns ? 4 : 1;
+    bool pp                = table->has_pawns && table->pawn_count[1];
+
+    if (   file->size < 5
+        || memcmp(data, dtz ? DTZ_MAGIC : WDL_MAGIC, 4) != 0
+        || ((data[4] & TBH_HAS_PAWNS) != 0) != table->has_pawns
+        || ((data[4] & TBH_SPLIT) != 0) == table->symmetric) {
+        return false;
+    }
+
+    uint64_t offset = 5;
+    for (int f = 0; f < n_files; ++f) {
+        if (offset + 1 + pp + (uint64_t) table->piece_count > file->size) {
+            return false;
+        }
+        int order[2][2] = { { data[offset] & 0xF, pp ? data[offset + 1] & 0xF : 0xF },
+                            { data[offset] >> 4,  pp ? data[offset + 1] >> 4  : 0xF } };
+        offset += 1 + pp;
+
+        for (int k = 0; k < table->piece_count; ++k, ++offset) {
+            for (int i = 0; i < sides; ++i) {
+                PairsData* d = dtz ? &table->dtz[f] : &table->wdl[i][f];
+                d->pieces[k] = i ? data[offset] >> 4 : data[offset] & 0xF;
+            }
+        }
+        for (int i = 0; i < sides; ++i) {
+            set_groups(table, dtz ? &table->dtz[f] : &table->wdl[i][f], order[i], f);
+        }
+    }
+    offset += offset & 1;
+
+    for (int f = 0; f < n_files; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            offset = set_sizes(dtz ? &table->dtz[f] : &table->wdl[i][f], file, offset);
+            if (offset == 0) {
+                return false;
+            }
+        }
+    }
+
+    if (dtz) {
+        offset = set_dtz_map(table, offset, n_files);
+        if (offset == 0) {
+            return false;
+        }
+    }
+
+    for (int f = 0; f < n_files; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d    = dtz ? &table->dtz[f] : &table->wdl[i][f];
+            d->sparse_index = data + offset;
+            offset += 6 * d->sparse_index_size;
+        }
+    }
+    for (int f = 0; f < n_files; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d    = dtz ? &table->dtz[f] : &table->wdl[i][f];
+            d->block_length = data + offset;
+            offset += 2 * (uint64_t) d->block_length_size;
+        }
+    }
+    for (int f = 0; f < n_files; ++f) {
+        for (int i = 0; i < sides; ++i) {
+            PairsData* d = dtz ? &table->dtz[f] : &table->wdl[i][f];
+            offset  = (offset + 0x3F) & ~(uint64_t) 0x3F;
+            d->data = data + offset;
+            offset += d->num_blocks * d->block_size;
+        }
+    }
+
+    return offset <= file->size;
+}
+
+/*
+ * Probing.
+ */
+
+static int map_dtz(const Table* table, int file, int value, int wdl) {
+    static const int WDL_MAP[] = { 1, 3, 0, 2, 0 };
+
+    const PairsData* d = &table->dtz[file];
+    if (d->flags & TBF_MAPPED) {
+        int idx = d->map_idx[WDL_MAP[wdl + 2]] + value;
+        value = (d->flags & TBF_WIDE) ? read_le16(table->dtz_map + 2 * idx) : table->dtz_map[idx];
+    }
+
+    /* Values are stored in moves, unless flagged otherwise. */
+    if (   (wdl == WDL_WIN  && !(d->flags & TBF_WIN_PLIES))
+        || (wdl == WDL_LOSS && !(d->flags & TBF_LOSS_PLIES))
+        ||  wdl == WDL_CURSED_WIN
+        ||  wdl == WDL_BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+/*
+ * Reads the value of a position from its WDL table, or its DTZ table
+ * given its WDL outcome. Tables are stored with the side listed first
+ * in their names as white, so positions are flipped when black holds
+ * those pieces.
+ */
+static int probe_table(const Pos* pos, bool dtz, int wdl, int* state) {
+    if (popcount(occupancy(pos)) == 2) {
+        return WDL_DRAW;
+    }
+
+    const Table* table = find_table(pos);
+    if (table == NULL || (dtz && !table->has_dtz)) {
+        *state = PS_FAIL;
+        return 0;
+    }
+
+    int squares[TB_PIECES] = { 0 };
+    int pieces[TB_PIECES];
+    int size           = 0;
+    int lead_pawns_cnt = 0;
+    int file           = 0;
+    uint64_t lead_pawns = 0;
+    uint64_t idx;
+
+    /* Symmetric tables only hold white to move. */
+    bool symmetric_black_to_move = table->symmetric && pos->turn == BLACK;
+    bool black_stronger          = (table->key >> 16) != pos_side_key(pos, WHITE);
+    bool flip                    = symmetric_black_to_move || black_stronger;
+    int flip_color               = flip ? 8 : 0;
+    int flip_squares             = flip ? 56 : 0;
+    int stm                      = flip ^ pos->turn;
+
+    /* Pawn tables are split by the file of the leading pawn. */
+    if (table->has_pawns) {
+        int pawn = (dtz ? table->dtz[0].pieces[0] : table->wdl[0][0].pieces[0]) ^ flip_color;
+        uint64_t b = lead_pawns = pos->colors[pawn >> 3] & pos->types[PAWN];
+        while (b) {
+            squares[size++] = pop_lsb(&b) ^ flip_squares;
+        }
+        lead_pawns_cnt = size;
+
+        int lead = 0;
+        for (int i = 1; i < lead_pawns_cnt; ++i) {
+            if (s_map_pawns[squares[i]] > s_map_pawns[squares[lead]]) {
+                lead = i;
+            }
+        }
+        int tmp       = squares[0];
+        squares[0]    = squares[lead];
+        squares[lead] = tmp;
+
+        file = FILE_OF(squares[0]);
+        if (file > 3) {
+            file = FILE_OF(squares[0] ^ 7);
+        }
+    }
+
+    const PairsData* d = dtz ? &table->dtz[file] : &table->wdl[stm][file];
+    if (dtz && (d->flags & TBF_STM) != stm && !(table->symmetric && !table->has_pawns)) {
+        *state = PS_CHANGE_STM;
+        return 0;
+    }
+
+    for (uint64_t b = occupancy(pos) ^ lead_pawns; b;) {
+        int sq = pop_lsb(&b);
+        squares[size]  = sq ^ flip_squares;
+        pieces[size++] = piece_on(pos, sq) ^ flip_color;
+    }
+
+    /* Order pieces the way the table lists them. */
+    for (int i = lead_pawns_cnt; i < size - 1; ++i) {
+        for (int j = i + 1; j < size; ++j) {
+            if (d->pieces[i] == pieces[j]) {
+                int tmp    = pieces[i];
+                pieces[i]  = pieces[j];
+                pieces[j]  = tmp;
+                tmp        = squares[i];
+                squares[i] = squares[j];
+                squares[j] = tmp;
+                break;
+            }
+        }
+    }
+
+    /* Mirror the leading piece into files a-d. */
+    if (FILE_OF(squares[0]) > 3) {
+        for (int i = 0; i < size; ++i) {
+            squares[i] ^= 7;
+        }
+    }
+
+    if (table->has_pawns) {
+        idx = s_lead_pawn_idx[lead_pawns_cnt][squares[0]];
+        sort_pawns(squares + 1, lead_pawns_cnt - 1);
+        for (int i = 1; i < lead_pawns_cnt; ++i) {
+            idx += s_binomial[i][s_map_pawns[squares[i]]];
+        }
+    }
+    else {
+        /* Mirror the leading piece into ranks 1-4, then below the a1-h8
+         * diagonal, taking the first leading piece off the diagonal. */
+        if (RANK_OF(squares[0]) > 3) {
+            for (int i = 0; i < size; ++i) {
+                squares[i] ^= 56;
+            }
+        }
+        for (int i = 0; i < d->group_len[0]; ++i) {
+            if (!off_a1h8(squares[i])) {
+                continue;
+            }
+            if (off_a1h8(squares[i]) > 0) {
+                for (int j = i; j < size; ++j) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+
+        if (table->has_unique_pieces) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+            if (off_a1h8(squares[0])) {
+                idx = ((uint64_t) s_map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62
+                    + (uint64_t) (squares[2] - adjust2);
+            }
+            else if (off_a1h8(squares[1])) {
+                idx = ((uint64_t) 6 * 63 + RANK_OF(squares[0]) * 28 + s_map_b1h1h7[squares[1]]) * 62
+                    + (uint64_t) (squares[2] - adjust2);
+            }
+            else if (off_a1h8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62
+                    + RANK_OF(squares[0]) * 7 * 28
+                    + (RANK_OF(squares[1]) - adjust1) * 28
+                    + s_map_b1h1h7[squares[2]];
+            }
+            else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                    + RANK_OF(squares[0]) * 7 * 6
+                    + (RANK_OF(squares[1]) - adjust1) * 6
+                    + (RANK_OF(squares[2]) - adjust2);
+            }
+        }
+        else {
+            idx = (uint64_t) s_map_kk[s_map_a1d1d4[squares[0]]][squares[1]];
+        }
+    }
+
+    /* Every other group is encoded as a combination of the squares left. */
+    idx *= d->group_idx[0];
+    int* group_sq = squares + d->group_len[0];
+    bool remaining_pawns = table->has_pawns && table->pawn_count[1];
+
+    for (int next = 1; d->group_len[next]; ++next) {
+        sort_squares(group_sq, d->group_len[next]);
+        uint64_t n = 0;
+        for (int i = 0; i < d->group_len[next]; ++i) {
+            int adjust = 0;
+            for (const int* sq = squares; sq < group_sq; ++sq) {
+                adjust += group_sq[i] > *sq;
+            }
+            n += s_binomial[i + 1][group_sq[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        idx += n * d->group_idx[next];
+        group_sq += d->group_len[next];
+    }
+
+    int value = decompress_pairs(d, idx);
+    return dtz ? map_dtz(table, file, value, wdl) : value - 2;
+}
+
+/* DTZ of the move before a zeroing move, given the outcome after it. */
+static int dtz_before_zeroing(int wdl) {
+    return wdl == WDL_WIN          ?  1
+         : wdl == WDL_CURSED_WIN   ?  101
+         : wdl == WDL_BLESSED_LOSS ? -101
+         : wdl == WDL_LOSS         ? -1
+         : 0;
+}
+
+static int sign_of(int value) {
+    return (value > 0) - (value < 0);
+}
+
+/*
+ * Tables may hold any value for positions decided by a capture, which
+ * must be searched. Positions whose best move is zeroing are flagged,
+ * since DTZ tables hold no value for them either. Only checks pawn
+ * moves if check_zeroing_moves is set.
+ */
+static int search(const Pos* pos, bool check_zeroing_moves, int* state) {
+    Move moves[TB_MAX_MOVES];
+    int n_moves     = gen_moves(pos, moves);
+    int best_value  = WDL_LOSS;
+    int total_count = 0;
+    int move_count  = 0;
+    int value;
+
+    for (int i = 0; i < n_moves; ++i) {
+        Pos next;
+        if (!do_move(&next, pos, moves[i])) {
+            continue;
+        }
+        total_count++;
+        if (!is_capture(pos, moves[i]) && (!check_zeroing_moves || !is_pawn_move(pos, moves[i]))) {
+            continue;
+        }
+        move_count++;
+
+        value = -search(&next, false, state);
+        if (*state == PS_FAIL) {
+            return WDL_DRAW;
+        }
+        if (value > best_value) {
+            best_value = value;
+            if (value >= WDL_WIN) {
+                *state = PS_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    /* Tables don't know about en passant, so when every move has been
+     * searched their value can't be trusted. */
+    bool no_more_moves = move_count && move_count == total_count;
+    if (no_more_moves) {
+        value = best_value;
+    }
+    else {
+        value = probe_table(pos, false, WDL_DRAW, state);
+        if (*state == PS_FAIL) {
+            return WDL_DRAW;
+        }
+    }
+
+    if (best_value >= value) {
+        *state = best_value > WDL_DRAW || no_more_moves ? PS_ZEROING_BEST_MOVE : PS_OK;
+        return best_value;
+    }
+    *state = PS_OK;
+    return value;
+}
+
+static int probe_wdl(const Pos* pos, int* state) {
+    *state = PS_OK;
+    return search(pos, false, state);
+}
+
+/*
+ * Plies until a zeroing move, positive if winning. Values are off by
+ * one ply for tables storing moves, and above 100 for 50 move draws.
+ */
+static int probe_dtz(const Pos* pos, int* state) {
+    *state  = PS_OK;
+    int wdl = search(pos, true, state);
+    if (*state == PS_FAIL || wdl == WDL_DRAW) {
+        return 0;
+    }
+    if (*state == PS_ZEROING_BEST_MOVE) {
+        return dtz_before_zeroing(wdl);
+    }
+
+    int dtz = probe_table(pos, true, wdl, state);
+    if (*state == PS_FAIL) {
+        return 0;
+    }
+    if (*state != PS_CHANGE_STM) {
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * sign_of(wdl);
+    }
+
+    /* The table holds the other side to move, search a ply deeper. */
+    Move moves[TB_MAX_MOVES];
+    int n_moves = gen_moves(pos, moves);
+    int min_dtz = 0xFFFF;
+
+    for (int i = 0; i < n_moves; ++i) {
+        Pos next;
+        bool zeroing = is_capture(pos, moves[i]) || is_pawn_move(pos, moves[i]);
+        if (!do_move(&next, pos, moves[i])) {
+            continue;
+        }
+
+        dtz = zeroing ? -dtz_before_zeroing(search(&next, false, state))
+                      : -probe_dtz(&next, state);
+        if (*state == PS_FAIL) {
+            return 0;
+        }
+        if (dtz == 1 && is_mate(&next)) {
+            min_dtz = 1;
+        }
+        if (!zeroing) {
+            dtz += sign_of(dtz);
+        }
+        if (dtz < min_dtz && sign_of(dtz) == sign_of(wdl)) {
+            min_dtz = dtz;
+        }
+    }
+
+    /* Without legal moves, we are mated. */
+    return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+static unsigned dtz_to_wdl(unsigned rule50, int dtz) {
+    if (dtz > 0) {
+        return (unsigned) dtz + rule50 <= 100 ? TB_WIN : TB_CURSED_WIN;
+    }
+    if (dtz < 0) {
+        return (unsigned) -dtz + rule50 <= 100 ? TB_LOSS : TB_BLESSED_LOSS;
+    }
+    return TB_DRAW;
+}
+
+static bool set_position(Pos*     pos,
+                         uint64_t white,
+                         uint64_t black,
+                         uint64_t kings,
+                         uint64_t queens,
+                         uint64_t rooks,
+                         uint64_t bishops,
+                         uint64_t knights,
+                         uint64_t pawns,
+                         unsigned rule50,
+                         unsigned ep,
+                         bool     turn) {
+    memset(pos, 0, sizeof(Pos));
+    pos->colors[WHITE]  = white;
+    pos->colors[BLACK]  = black;
+    pos->types[KING]    = kings;
+    pos->types[QUEEN]   = queens;
+    pos->types[ROOK]    = rooks;
+    pos->types[BISHOP]  = bishops;
+    pos->types[KNIGHT]  = knights;
+    pos->types[PAWN]    = pawns;
+    pos->turn           = turn ? WHITE : BLACK;
+    pos->ep             = (int) ep;
+    pos->rule50         = rule50;
+
+    return popcount(white | black) <= (int) TB_LARGEST
+        && popcount(kings & white) == 1
+        && popcount(kings & black) == 1
+        && !(pawns & 0xFF000000000000FF)
+        && ep < 64;
+}
+
+/*
+ * Public interface.
+ */
+
+static bool map_file(const char* path, MappedFile* file) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE mapping = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL) {
+        return false;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    file->data    = data;
+    file->size    = (uint64_t) size.QuadPart;
+    file->mapping = mapping;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file->data = data;
+    file->size = (uint64_t) st.st_size;
+    return true;
+#endif
+}
+
+static void unmap_file(MappedFile* file) {
+    if (file->data == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+#else
+    munmap((void*) file->data, (size_t) file->size);
+#endif
+    file->data = NULL;
+}
+
+static void free_table(Table* table) {
+    for (int f = 0; f < 4; ++f) {
+        free(table->wdl[0][f].symlen);
+        free(table->wdl[1][f].symlen);
+        free(table->dtz[f].symlen);
+    }
+    unmap_file(&table->wdl_file);
+    unmap_file(&table->dtz_file);
+}
+
+/* Maps the first file named name + suffix found in the directories of path. */
+static bool find_file(const char* path, const char* name, const char* suffix, MappedFile* file) {
+    char file_path[4096];
+    const char* dir = path;
+    while (*dir) {
+        const char* end = strchr(dir, PATH_SEPARATOR);
+        size_t len = end ? (size_t) (end - dir) : strlen(dir);
+        if (len > 0 && len + strlen(name) + strlen(suffix) + 2 < sizeof(file_path)) {
+            memcpy(file_path, dir, len);
+            sprintf(file_path + len, "/%s%s", name, suffix);
+            if (map_file(file_path, file)) {
+                return true;
+            }
+        }
+        dir += len + (end != NULL);
+    }
+    return false;
+}
+
+static void side_name(uint32_t key, char* name) {
+    static const char PIECE_CHARS[] = " PNBRQ";
+    *name++ = 'K';
+    for (int type = QUEEN; type >= PAWN; --type) {
+        int count = (int) (key >> (3 * (type - PAWN))) & 7;
+        while (count--) {
+            *name++ = PIECE_CHARS[type];
+        }
+    }
+    *name = '\0';
+}
+
+/* Adds the table of the given material if its WDL file is found. */
+static bool add_table(const char* path, uint32_t first, uint32_t second, size_t* capacity) {
+    char name[TB_PIECES + 3];
+    side_name(first, name);
+    strcat(name, "v");
+    side_name(second, name + strlen(name));
+
+    Table table;
+    memset(&table, 0, sizeof(Table));
+    if (!find_file(path, name, ".rtbw", &table.wdl_file)) {
+        return true;
+    }
+
+    table.key         = (first << 16) | second;
+    table.piece_count = 2 + key_piece_count(first) + key_piece_count(second);
+    table.symmetric   = first == second;
+
+    int counts[2][KING];
+    for (int type = PAWN; type < KING; ++type) {
+        counts[0][type] = (int) (first >> (3 * (type - PAWN))) & 7;
+        counts[1][type] = (int) (second >> (3 * (type - PAWN))) & 7;
+        table.has_unique_pieces |= counts[0][type] == 1 || counts[1][type] == 1;
+    }
+    table.has_pawns = counts[0][PAWN] || counts[1][PAWN];
+
+    /* Pawns of the side with fewer of them lead, if it has any. */
+    bool white_leads = !counts[1][PAWN] || (counts[0][PAWN] && counts[1][PAWN] >= counts[0][PAWN]);
+    table.pawn_count[0] = (uint8_t) counts[white_leads ? 0 : 1][PAWN];
+    table.pawn_count[1] = (uint8_t) counts[white_leads ? 1 : 0][PAWN];
+
+    bool valid = parse_table(&table, false);
+    if (valid && find_file(path, name, ".rtbz", &table.dtz_file)) {
+        table.has_dtz = parse_table(&table, true);
+    }
+    if (!valid) {
+        free_table(&table);
+        return true;
+    }
+
+    if (s_n_tables == *capacity) {
+        size_t new_capacity = *capacity ? 2 * *capacity : 64;
+        Table* tables = realloc(s_tables, new_capacity * sizeof(Table));
+        if (tables == NULL) {
+            free_table(&table);
+            return false;
+        }
+        s_tables  = tables;
+        *capacity = new_capacity;
+    }
+    s_tables[s_n_tables++] = table;
+    if ((unsigned) table.piece_count > TB_LARGEST) {
+        TB_LARGEST = (unsigned) table.piece_count;
+    }
+    return true;
+}
+
+/* Calls add_table for every material with up to TB_PIECES pieces. */
+static bool add_tables(const char* path) {
+    /* Side keys hold 3 bits per piece type, pawns in the lowest ones. */
+    static uint32_t keys[1 << 15];
+    int n_keys = 0;
+    for (uint32_t key = 0; key < (1u << 15); ++key) {
+        if (key_piece_count(key) <= TB_PIECES - 2) {
+            keys[n_keys++] = key;
+        }
+    }
+
+    size_t capacity = 0;
+    for (int i = 0; i < n_keys; ++i) {
+        for (int j = 0; j < n_keys; ++j) {
+            int n_pieces = key_piece_count(keys[i]) + key_piece_count(keys[j]);
+            if (n_pieces == 0 || n_pieces > TB_PIECES - 2 || !is_listed_first(keys[i], keys[j])) {
+                continue;
+            }
+            if (!add_table(path, keys[i], keys[j], &capacity)) {
+                return false;
+            }
+        }
+    }
+
+    qsort(s_tables, s_n_tables, sizeof(Table), compare_tables);
+    return true;
+}
+
+bool tb_init(const char* path) {
+    static bool initialized = false;
+    if (!initialized) {
+        init_attacks();
+        init_indices();
+        initialized = true;
+    }
+
+    tb_free();
+    if (path == NULL || *path == '\0' || strcmp(path, "<empty>") == 0) {
+        return true;
+    }
+    if (!add_tables(path)) {
+        tb_free();
+        return false;
+    }
+    return true;
+}
+
+void tb_free(void) {
+    for (size_t i = 0; i < s_n_tables; ++i) {
+        free_table(&s_tables[i]);
+    }
+    free(s_tables);
+    s_tables   = NULL;
+    s_n_tables = 0;
+    TB_LARGEST = 0;
+}
+
+unsigned tb_probe_wdl(uint64_t white,
+                      uint64_t black,
+                      uint64_t kings,
+                      uint64_t queens,
+                      uint64_t rooks,
+                      uint64_t bishops,
+                      uint64_t knights,
+                      uint64_t pawns,
+                      unsigned rule50,
+                      unsigned castling,
+                      unsigned ep,
+                      bool     turn) {
+    Pos pos;
+    if (   rule50 != 0
+        || castling != 0
+        || !set_position(&pos, white, black, kings, queens, rooks, bishops, knights, pawns, rule50, ep, turn)) {
+        return TB_RESULT_FAILED;
+    }
+
+    int state;
+    int wdl = probe_wdl(&pos, &state);
+    return state == PS_FAIL ? TB_RESULT_FAILED : (unsigned) (wdl + 2);
+}
+
+unsigned tb_probe_root(uint64_t  white,
+                       uint64_t  black,
+                       uint64_t  kings,
+                       uint64_t  queens,
+                       uint64_t  rooks,
+                       uint64_t  bishops,
+                       uint64_t  knights,
+                       uint64_t  pawns,
+                       unsigned  rule50,
+                       unsigned  castling,
+                       unsigned  ep,
+                       bool      turn,
+                       unsigned* results) {
+    Pos pos;
+    if (   castling != 0
+        || !set_position(&pos, white, black, kings, queens, rooks, bishops, knights, pawns, rule50, ep, turn)) {
+        return TB_RESULT_FAILED;
+    }
+
+    int state;
+    int dtz = probe_dtz(&pos, &state);
+    if (state == PS_FAIL) {
+        return TB_RESULT_FAILED;
+    }
+
+    Move moves[TB_MAX_MOVES];
+    int n_moves = gen_moves(&pos, moves);
+    int n       = 0;
+    unsigned best = TB_RESULT_FAILED;
+    int best_dtz  = 0;
+
+    for (int i = 0; i < n_moves; ++i) {
+        Pos next;
+        if (!do_move(&next, &pos, moves[i])) {
+            continue;
+        }
+
+        /* DTZ of the move counting from the root position. */
+        int v;
+        if (dtz > 0 && is_mate(&next)) {
+            v = 1;
+        }
+        else if (next.rule50 != 0) {
+            v = -probe_dtz(&next, &state);
+            v += sign_of(v);
+        }
+        else {
+            v = dtz_before_zeroing(-probe_wdl(&next, &state));
+        }
+        if (state == PS_FAIL) {
+            return TB_RESULT_FAILED;
+        }
+
+        unsigned result = 0;
+        result = TB_SET_WDL(result, dtz_to_wdl(rule50, v));
+        result = TB_SET_FROM(result, (unsigned) MOVE_FROM(moves[i]));
+        result = TB_SET_TO(result, (unsigned) MOVE_TO(moves[i]));
+        result = TB_SET_PROMOTES(result, MOVE_PROMOTES(moves[i]));
+        result = TB_SET_EP(result, (unsigned) (pos.ep != 0 && MOVE_TO(moves[i]) == pos.ep && is_pawn_move(&pos, moves[i])));
+        result = TB_SET_DTZ(result, (unsigned) (v < 0 ? -v : v));
+        results[n++] = result;
+
+        /* Win with the lowest DTZ, lose with the highest one, or keep
+         * the first drawing move. */
+        bool better = best == TB_RESULT_FAILED
+                   || (dtz > 0 && v > 0 && (best_dtz <= 0 || v < best_dtz))
+                   || (dtz < 0 && v < best_dtz)
+                   || (dtz == 0 && v == 0 && best_dtz != 0);
+        if (better) {
+            best     = result;
+            best_dtz = v;
+        }
+    }
+    results[n] = TB_RESULT_FAILED;
+
+    if (n == 0) {
+        return in_check(&pos) ? TB_RESULT_CHECKMATE : TB_RESULT_STALEMATE;
+    }
+    best = TB_SET_WDL(best, dtz_to_wdl(rule50, dtz));
+    return TB_SET_DTZ(best, (unsigned) (dtz < 0 ? -dtz : dtz));
+}
@@ -0,0 +1,121 @@
+/*
+ * Minimal Syzygy prober exposing the subset of Fathom's tbprobe.h API
+ * used by Illumina. It reads the WDL (.rtbw) and DTZ (.rtbz) files of
+ * endings with up to 7 pieces, mapping them into memory.
+ */
+#ifndef MINIFATHOM_TBPROBE_H
+#define MINIFATHOM_TBPROBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Largest number of pieces of the loaded WDL tables, 0 if none are.
+ */
+extern unsigned TB_LARGEST;
+
+#define TB_LOSS            0
+#define TB_BLESSED_LOSS    1
+#define TB_DRAW            2
+#define TB_CURSED_WIN      3
+#define TB_WIN             4
+
+#define TB_PROMOTES_NONE   0
+#define TB_PROMOTES_QUEEN  1
+#define TB_PROMOTES_ROOK   2
+#define TB_PROMOTES_BISHOP 3
+#define TB_PROMOTES_KNIGHT 4
+
+#define TB_RESULT_WDL_MASK      0x0000000F
+#define TB_RESULT_TO_MASK       0x000003F0
+#define TB_RESULT_FROM_MASK     0x0000FC00
+#define TB_RESULT_PROMOTES_MASK 0x00070000
+#define TB_RESULT_EP_MASK       0x00080000
+#define TB_RESULT_DTZ_MASK      0xFFF00000
+#define TB_RESULT_WDL_SHIFT      0
+#define TB_RESULT_TO_SHIFT       4
+#define TB_RESULT_FROM_SHIFT     10
+#define TB_RESULT_PROMOTES_SHIFT 16
+#define TB_RESULT_EP_SHIFT       19
+#define TB_RESULT_DTZ_SHIFT      20
+
+#define TB_GET_WDL(_res)      (((_res) & TB_RESULT_WDL_MASK) >> TB_RESULT_WDL_SHIFT)
+#define TB_GET_TO(_res)       (((_res) & TB_RESULT_TO_MASK) >> TB_RESULT_TO_SHIFT)
+#define TB_GET_FROM(_res)     (((_res) & TB_RESULT_FROM_MASK) >> TB_RESULT_FROM_SHIFT)
+#define TB_GET_PROMOTES(_res) (((_res) & TB_RESULT_PROMOTES_MASK) >> TB_RESULT_PROMOTES_SHIFT)
+#define TB_GET_EP(_res)       (((_res) & TB_RESULT_EP_MASK) >> TB_RESULT_EP_SHIFT)
+#define TB_GET_DTZ(_res)      (((_res) & TB_RESULT_DTZ_MASK) >> TB_RESULT_DTZ_SHIFT)
+
+#define TB_SET_WDL(_res, _wdl)    (((_res) & ~TB_RESULT_WDL_MASK) | (((_wdl) << TB_RESULT_WDL_SHIFT) & TB_RESULT_WDL_MASK))
+#define TB_SET_TO(_res, _to)      (((_res) & ~TB_RESULT_TO_MASK) | (((_to) << TB_RESULT_TO_SHIFT) & TB_RESULT_TO_MASK))
+#define TB_SET_FROM(_res, _from)  (((_res) & ~TB_RESULT_FROM_MASK) | (((_from) << TB_RESULT_FROM_SHIFT) & TB_RESULT_FROM_MASK))
+#define TB_SET_PROMOTES(_res, _p) (((_res) & ~TB_RESULT_PROMOTES_MASK) | (((_p) << TB_RESULT_PROMOTES_SHIFT) & TB_RESULT_PROMOTES_MASK))
+#define TB_SET_EP(_res, _ep)      (((_res) & ~TB_RESULT_EP_MASK) | (((_ep) << TB_RESULT_EP_SHIFT) & TB_RESULT_EP_MASK))
+#define TB_SET_DTZ(_res, _dtz)    (((_res) & ~TB_RESULT_DTZ_MASK) | (((_dtz) << TB_RESULT_DTZ_SHIFT) & TB_RESULT_DTZ_MASK))
+
+#define TB_RESULT_CHECKMATE TB_SET_WDL(0, TB_WIN)
+#define TB_RESULT_STALEMATE TB_SET_WDL(0, TB_DRAW)
+#define TB_RESULT_FAILED    0xFFFFFFFF
+
+#define TB_MAX_MOVES (192 + 1)
+
+/*
+ * Loads the tables found in the directories of path, separated by ':'
+ * (';' on Windows), freeing previously loaded ones. An empty path or
+ * "<empty>" loads nothing. Returns false if memory ran out, finding no
+ * tables isn't an error. Not thread safe, unlike probes.
+ */
+bool tb_init(const char *path);
+
+/*
+ * Frees the tables.
+ */
+void tb_free(void);
+
+/*
+ * Probes the WDL value of a position, from the perspective of the side
+ * to move. Squares go from a1 = 0 to h8 = 63, turn is true when white is
+ * to move. Like Fathom, fails unless rule50 and castling are 0.
+ */
+unsigned tb_probe_wdl(uint64_t white,
+                      uint64_t black,
+                      uint64_t kings,
+                      uint64_t queens,
+                      uint64_t rooks,
+                      uint64_t bishops,
+                      uint64_t knights,
+                      uint64_t pawns,
+                      unsigned rule50,
+                      unsigned castling,
+                      unsigned ep,
+                      bool     turn);
+
+/*
+ * Probes every legal move of a root position, writing their outcomes
+ * under the 50 move rule and their DTZ to results, terminated by
+ * TB_RESULT_FAILED. Returns the result of the best move, or
+ * TB_RESULT_CHECKMATE/TB_RESULT_STALEMATE if there are no moves.
+ */
+unsigned tb_probe_root(uint64_t  white,
+                       uint64_t  black,
+                       uint64_t  kings,
+                       uint64_t  queens,
+                       uint64_t  rooks,
+                       uint64_t  bishops,
+                       uint64_t  knights,
+                       uint64_t  pawns,
+                       unsigned  rule50,
+                       unsigned  castling,
+                       unsigned  ep,
+                       bool      turn,
+                       unsigned* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MINIFATHOM_TBPROBE_H */
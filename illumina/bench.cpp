@@ -1,5 +1,7 @@
 #include "bench.h"
 
+#include <algorithm>
+
 namespace illumina {
 
 BenchSettings default_bench_settings() {
@@ -59,8 +61,76 @@ BenchResults bench(const BenchSettings& settings) {
     // Compute NPS and save final results to bench results object.
     results.bench_time_ms = elapsed_ms;
     results.nps = double(results.total_nodes) / (double(results.search_time_ms) / 1000.0);
+    results.tt_stats     = searcher.tt_stats();
+    results.tt_occupancy = searcher.tt().occupancy();
+    results.eval_cache_stats = searcher.eval_cache_stats();
+
+    return results;
+}
+
+template <typename TIndexer>
+static double ns_per_key(ui64 n_keys, TIndexer indexer) {
+    // Keys are generated by a xorshift so that they are not known at
+    // compile time. Indices are accumulated to prevent the compiler from
+    // discarding the work.
+    ui64 key = 0x9E3779B97F4A7C15;
+    ui64 acc = 0;
+
+    TimePoint before = Clock::now();
+    for (ui64 i = 0; i < n_keys; ++i) {
+        key ^= key << 13;
+        key ^= key >> 7;
+        key ^= key << 17;
+        acc += indexer(key);
+    }
+    TimePoint after = Clock::now();
+
+    volatile ui64 sink = acc;
+    (void) sink;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+    return double(ns) / double(n_keys);
+}
+
+IndexingBenchResults bench_tt_indexing(size_t table_size_mb, ui64 n_keys) {
+    // Read the cluster count through a volatile so that it behaves as the
+    // runtime value it is in the real table.
+    volatile ui64 volatile_count = table_size_mb * 1024 * 1024 / sizeof(TranspositionTableCluster);
+    ui64 cluster_count = volatile_count;
 
+    IndexingBenchResults results;
+    results.n_keys            = n_keys;
+    results.modulo_ns_per_key = ns_per_key(n_keys, [cluster_count](ui64 key) { return key % cluster_count; });
+    results.mul_hi_ns_per_key = ns_per_key(n_keys, [cluster_count](ui64 key) { return mul_hi64(key, cluster_count); });
+    return results;
+}
+
+StopLatencyBenchResults bench_stop_latency(const BenchSettings& settings, i64 move_time_ms) {
+    Searcher searcher;
+    searcher.tt().resize(settings.hash_size_mb * 1024 * 1024);
+
+    SearchSettings search_settings = settings.search_settings;
+    search_settings.max_depth.reset();
+    search_settings.move_time = move_time_ms;
+
+    StopLatencyBenchResults results;
+    ui64 total_latency_us = 0;
+    for (const Board& board: settings.boards) {
+        SearchResults search_results = searcher.search(board, search_settings);
+        if (search_results.stop_latency_us == 0) {
+            // Search finished before the hard bound, e.g. forced mates.
+            continue;
+        }
+
+        results.n_searches++;
+        results.max_latency_us = std::max(results.max_latency_us, search_results.stop_latency_us);
+        total_latency_us += search_results.stop_latency_us;
+    }
+
+    if (results.n_searches > 0) {
+        results.avg_latency_us = total_latency_us / results.n_searches;
+    }
     return results;
 }
 
-} // illumina
\ No newline at end of file
+} // illumina
@@ -24,11 +24,41 @@ struct BenchResults {
     ui64 search_time_ms {};
     ui64 nps {};
     std::vector<Move> best_moves;
+    TranspositionTableStats     tt_stats;
+    TranspositionTableOccupancy tt_occupancy;
+    EvalCacheStats              eval_cache_stats;
+};
+
+struct IndexingBenchResults {
+    ui64   n_keys {};
+    double modulo_ns_per_key {};
+    double mul_hi_ns_per_key {};
+};
+
+struct StopLatencyBenchResults {
+    ui64 n_searches {};
+    ui64 max_latency_us {};
+    ui64 avg_latency_us {};
 };
 
 BenchSettings default_bench_settings();
 BenchResults bench(const BenchSettings& settings = default_bench_settings());
 
+/**
+ * Microbenchmark comparing the cost of mapping hash keys into a table
+ * by 64-bit modulo against the multiply-shift scheme used by the
+ * transposition table.
+ */
+IndexingBenchResults bench_tt_indexing(size_t table_size_mb = DEFAULT_BENCH_HASH_SIZE_MB,
+                                       ui64 n_keys = 1 << 24);
+
+/**
+ * Searches every bench position with a fixed movetime and measures how
+ * long searches take to return once their hard time bound is reached.
+ */
+StopLatencyBenchResults bench_stop_latency(const BenchSettings& settings = default_bench_settings(),
+                                           i64 move_time_ms = 20);
+
 } // illumina
 
 #endif //ILLUMINA_BENCH_H
@@ -0,0 +1,185 @@
+#include "epdanalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "clock.h"
+#include "parsehelper.h"
+#include "search.h"
+#include "utils.h"
+
+namespace illumina {
+
+/**
+ * Finds the operand of an EPD operation, such as 'id "position 1"',
+ * without its quotes.
+ */
+static std::string epd_operand(std::string_view operations, std::string_view opcode) {
+    size_t pos = 0;
+    while (pos < operations.size()) {
+        // Read the opcode.
+        while (pos < operations.size() && std::isspace(operations[pos])) {
+            pos++;
+        }
+        size_t opcode_begin = pos;
+        while (pos < operations.size() && !std::isspace(operations[pos]) && operations[pos] != ';') {
+            pos++;
+        }
+        std::string_view curr_opcode = operations.substr(opcode_begin, pos - opcode_begin);
+
+        // Read the operands, which end at the first ';' outside of quotes.
+        size_t operands_begin = pos;
+        bool quoted = false;
+        while (pos < operations.size() && (quoted || operations[pos] != ';')) {
+            quoted = quoted != (operations[pos] == '"');
+            pos++;
+        }
+        std::string_view operands = operations.substr(operands_begin, pos - operands_begin);
+        pos++;
+
+        if (curr_opcode != opcode) {
+            continue;
+        }
+
+        size_t first = operands.find_first_not_of(" \t\"");
+        size_t last  = operands.find_last_not_of(" \t\"");
+        if (first == std::string_view::npos) {
+            return "";
+        }
+        return std::string(operands.substr(first, last - first + 1));
+    }
+    return "";
+}
+
+EPDEntry parse_epd_entry(std::string_view line) {
+    ParseHelper parser(line);
+
+    // Both formats start with the same four fields.
+    std::string fen;
+    for (int i = 0; i < 4; ++i) {
+        std::string_view field = parser.read_chunk();
+        if (field.empty()) {
+            throw std::invalid_argument("Expected at least 4 fields in '" + std::string(line) + "'");
+        }
+        fen += field;
+        fen += ' ';
+    }
+
+    // FEN lines are followed by the move counters, EPD lines by operations.
+    std::string_view operations = parser.remainder();
+    ParseHelper counters_parser(operations);
+    int rule50;
+    int move_counter;
+    bool is_fen = try_parse_int(counters_parser.read_chunk(), rule50)
+               && try_parse_int(counters_parser.read_chunk(), move_counter);
+
+    EPDEntry entry { Board(is_fen ? fen + std::string(operations) : fen), {} };
+    if (!is_fen) {
+        entry.id = epd_operand(operations, "id");
+    }
+    return entry;
+}
+
+std::string format_epd_result(const EPDEntry& entry, const EPDAnalysisResult& result) {
+    // EPD positions don't have move counters.
+    std::string fen = entry.board.fen();
+    ParseHelper parser(fen);
+    std::stringstream stream;
+    for (int i = 0; i < 4; ++i) {
+        stream << parser.read_chunk() << (i < 3 ? " " : "");
+    }
+
+    stream << " acd " << result.depth << ";";
+    stream << " acn " << result.nodes << ";";
+    stream << " ce " << result.score << ";";
+    if (is_mate_score(result.score)) {
+        // Negative when the side to move is getting mated.
+        int n_moves = moves_to_mate(result.score);
+        stream << " dm " << (result.score > 0 ? n_moves : -n_moves) << ";";
+    }
+
+    stream << " pv";
+    if (result.pv.empty()) {
+        stream << " " << result.best_move.to_uci();
+    }
+    for (Move move: result.pv) {
+        stream << " " << move.to_uci();
+    }
+    stream << ";";
+
+    if (!entry.id.empty()) {
+        stream << " id \"" << entry.id << "\";";
+    }
+    return stream.str();
+}
+
+EPDAnalysisResults analyze_epd(const std::vector<EPDEntry>& entries,
+                               const EPDAnalysisSettings& settings) {
+    EPDAnalysisResults results;
+    results.results.resize(entries.size());
+
+    SearchSettings search_settings;
+    search_settings.max_depth = settings.max_depth;
+    search_settings.max_nodes = settings.max_nodes;
+
+    std::atomic<size_t> next_entry  = 0;
+    std::atomic<size_t> n_finished  = 0;
+    std::atomic<ui64>   total_nodes = 0;
+    auto analyze_entries = [&]() {
+        // Searchers are created by the threads using them, so that their
+        // memory gets allocated close to them.
+        Searcher searcher(TranspositionTable(settings.hash_size_mb * 1024 * 1024));
+
+        PVResults last_pv {};
+        searcher.set_pv_finish_listener([&last_pv](PVResults& pv_results) {
+            last_pv = pv_results;
+        });
+
+        size_t entry_idx;
+        while ((entry_idx = next_entry.fetch_add(1, std::memory_order_relaxed)) < entries.size()) {
+            searcher.tt().clear();
+            searcher.clear_histories();
+            last_pv = {};
+
+            SearchResults search_results = searcher.search(entries[entry_idx].board, search_settings);
+
+            EPDAnalysisResult& result = results.results[entry_idx];
+            result.best_move = search_results.best_move;
+            result.score     = search_results.score;
+            result.nodes     = search_results.total_nodes;
+            result.depth     = last_pv.depth;
+            result.pv        = std::move(last_pv.line);
+            total_nodes.fetch_add(search_results.total_nodes, std::memory_order_relaxed);
+
+            size_t n = n_finished.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (settings.on_progress != nullptr) {
+                settings.on_progress(n);
+            }
+        }
+    };
+
+    TimePoint before = Clock::now();
+
+    // The calling thread analyzes positions as well.
+    size_t n_threads = std::clamp(size_t(std::max(settings.n_threads, 1)), size_t(1), std::max(entries.size(), size_t(1)));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n_threads; ++i) {
+        threads.emplace_back(analyze_entries);
+    }
+    analyze_entries();
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    TimePoint after = Clock::now();
+
+    results.total_nodes = total_nodes;
+    results.time_ms     = delta_ms(after, before);
+    results.positions_per_second = double(entries.size()) / (std::max(double(results.time_ms), 1.0) / 1000.0);
+    return results;
+}
+
+} // illumina
@@ -0,0 +1,79 @@
+#ifndef ILLUMINA_EPDANALYSIS_H
+#define ILLUMINA_EPDANALYSIS_H
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "searchdefs.h"
+
+namespace illumina {
+
+static constexpr size_t DEFAULT_EPD_ANALYSIS_HASH_SIZE_MB = 4;
+static constexpr Depth  DEFAULT_EPD_ANALYSIS_DEPTH = 10;
+
+/**
+ * A position read from an EPD or FEN line. Only the 'id' operation
+ * of EPD lines is kept, so that results can be matched to their inputs.
+ */
+struct EPDEntry {
+    Board       board;
+    std::string id;
+};
+
+struct EPDAnalysisSettings {
+    std::optional<Depth> max_depth;
+    ui64   max_nodes = UINT64_MAX;
+    int    n_threads = 1;
+    size_t hash_size_mb = DEFAULT_EPD_ANALYSIS_HASH_SIZE_MB;
+
+    /**
+     * Called from the analysis threads whenever a position is finished,
+     * with the number of positions finished so far.
+     */
+    std::function<void(size_t n_finished)> on_progress = nullptr;
+};
+
+struct EPDAnalysisResult {
+    Move  best_move;
+    Score score {};
+    Depth depth {};
+    ui64  nodes {};
+    std::vector<Move> pv;
+};
+
+struct EPDAnalysisResults {
+    /** Results in the same order as the analyzed entries. */
+    std::vector<EPDAnalysisResult> results;
+    ui64   total_nodes {};
+    ui64   time_ms {};
+    double positions_per_second {};
+};
+
+/**
+ * Parses a line in either EPD or FEN format. Throws std::invalid_argument
+ * if the position is invalid.
+ */
+EPDEntry parse_epd_entry(std::string_view line);
+
+/**
+ * Formats an analysis result as an EPD line, with the standard 'acd',
+ * 'acn', 'ce', 'dm' and 'pv' operations. Moves are written in UCI notation.
+ */
+std::string format_epd_result(const EPDEntry& entry, const EPDAnalysisResult& result);
+
+/**
+ * Searches every entry with its own single threaded search. Each analysis
+ * thread owns a Searcher with a small transposition table, and picks up
+ * positions one at a time. Hash tables and histories are cleared before
+ * every position, so results don't depend on the number of threads.
+ */
+EPDAnalysisResults analyze_epd(const std::vector<EPDEntry>& entries,
+                               const EPDAnalysisSettings& settings);
+
+} // illumina
+
+#endif // ILLUMINA_EPDANALYSIS_H
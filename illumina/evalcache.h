@@ -0,0 +1,85 @@
+#ifndef ILLUMINA_EVALCACHE_H
+#define ILLUMINA_EVALCACHE_H
+
+#include <array>
+#include <memory>
+
+#include "searchdefs.h"
+#include "types.h"
+
+namespace illumina {
+
+static constexpr size_t EVAL_CACHE_ENTRIES = 1 << 16;
+
+struct EvalCacheStats {
+    ui64 probes = 0;
+    ui64 hits   = 0;
+
+    EvalCacheStats& operator+=(const EvalCacheStats& rhs);
+};
+
+/**
+ * Small direct-mapped cache of static evaluations, keyed by the board's
+ * hash key. Meant to be owned by a single search thread, so that it
+ * doesn't need any synchronization. Positions evaluated moments ago
+ * through a transposition are often gone from the transposition table
+ * already, but still here.
+ */
+class EvalCache {
+public:
+    bool probe(ui64 key, Score& score);
+    void store(ui64 key, Score score);
+    void clear();
+
+    const EvalCacheStats& stats() const;
+    void reset_stats();
+
+private:
+    // The low bits of the key select the entry, so each entry only
+    // needs to keep the high bits of the key, next to the score.
+    static constexpr ui64 KEY_MASK = ~ui64(BITMASK(16));
+    static_assert(EVAL_CACHE_ENTRIES <= (1 << 16));
+
+    // To prevent unintended stack allocations, entries are kept
+    // behind a unique_ptr.
+    using Entries = std::array<ui64, EVAL_CACHE_ENTRIES>;
+    std::unique_ptr<Entries> m_entries = std::make_unique<Entries>();
+    EvalCacheStats m_stats;
+};
+
+inline EvalCacheStats& EvalCacheStats::operator+=(const EvalCacheStats& rhs) {
+    probes += rhs.probes;
+    hits   += rhs.hits;
+    return *this;
+}
+
+inline bool EvalCache::probe(ui64 key, Score& score) {
+    m_stats.probes++;
+    ui64 entry = (*m_entries)[key & (EVAL_CACHE_ENTRIES - 1)];
+    if (entry == 0 || (entry & KEY_MASK) != (key & KEY_MASK)) {
+        return false;
+    }
+    m_stats.hits++;
+    score = i16(entry & BITMASK(16));
+    return true;
+}
+
+inline void EvalCache::store(ui64 key, Score score) {
+    (*m_entries)[key & (EVAL_CACHE_ENTRIES - 1)] = (key & KEY_MASK) | ui16(i16(score));
+}
+
+inline void EvalCache::clear() {
+    m_entries->fill(0);
+}
+
+inline const EvalCacheStats& EvalCache::stats() const {
+    return m_stats;
+}
+
+inline void EvalCache::reset_stats() {
+    m_stats = {};
+}
+
+} // illumina
+
+#endif // ILLUMINA_EVALCACHE_H
@@ -8,124 +8,67 @@ namespace illumina {
 
 void Evaluation::on_new_board(const Board& board) {
     m_nnue.clear();
-    m_n_lazy_updates = 0;
-    m_ctm = board.color_to_move();
-
-    // Activate every feature individually.
-    Bitboard bb = board.occupancy();
-    while (bb) {
-        Square s = lsb(bb);
-        m_nnue.enable_feature(s, board.piece_at(s));
-        bb = unset_lsb(bb);
-    }
-}
-
-void Evaluation::apply_lazy_updates() {
-    for (size_t i = 0; i < m_n_lazy_updates; ++i) {
-        Move move = m_lazy_updates[i];
-        if (move != MOVE_NULL) {
-            apply_make_move(move);
-        }
-        else {
-            apply_make_null_move();
-        }
-    }
-    m_n_lazy_updates = 0;
 }
 
 void Evaluation::on_make_move(const Board& board, Move move) {
-    m_lazy_updates[m_n_lazy_updates++] = move;
+    m_nnue.push_accumulator(dirty_pieces(move));
 }
 
 void Evaluation::on_undo_move(const Board& board, Move move) {
-    if (m_n_lazy_updates == 0) {
-        apply_undo_move(move);
-    }
-    else {
-        m_n_lazy_updates--;
-    }
+    m_nnue.pop_accumulator();
 }
 
 void Evaluation::on_make_null_move(const Board& board) {
-    m_lazy_updates[m_n_lazy_updates++] = MOVE_NULL;
+    // Null moves don't change any pieces, the accumulator stays the same.
 }
 
 void Evaluation::on_undo_null_move(const Board& board) {
-    if (m_n_lazy_updates == 0) {
-        apply_undo_null_move();
-    }
-    else {
-        m_n_lazy_updates--;
-    }
 }
 
-void Evaluation::apply_make_move(Move move) {
-    m_nnue.push_accumulator();
-    Color moved_color = m_ctm;
-    m_ctm = opposite_color(m_ctm);
+DirtyPieces Evaluation::dirty_pieces(Move move) {
+    DirtyPieces dirty;
+    Piece moved_piece = move.source_piece();
+    Color moved_color = moved_piece.color();
 
     switch (move.type()) {
         case MT_EN_PASSANT:
-            m_nnue.update_features<1, 2>(
-                    {move.destination()},
-                    {move.source_piece()},
-                    {move.source(), move.destination() - pawn_push_direction(moved_color)},
-                    {move.source_piece(), Piece(m_ctm, PT_PAWN)});
+            dirty.add(move.destination(), moved_piece);
+            dirty.remove(move.source(), moved_piece);
+            dirty.remove(move.destination() - pawn_push_direction(moved_color),
+                         Piece(opposite_color(moved_color), PT_PAWN));
             break;
         case MT_CASTLES:
-            m_nnue.update_features<2, 2>(
-                    {castled_rook_square(moved_color, move.castles_side()), move.destination()},
-                    {Piece(moved_color, PT_ROOK), move.source_piece()},
-                    {move.castles_rook_src_square(), move.source()},
-                    {Piece(moved_color, PT_ROOK), move.source_piece()});
+            dirty.add(castled_rook_square(moved_color, move.castles_side()), Piece(moved_color, PT_ROOK));
+            dirty.add(move.destination(), moved_piece);
+            dirty.remove(move.castles_rook_src_square(), Piece(moved_color, PT_ROOK));
+            dirty.remove(move.source(), moved_piece);
             break;
         case MT_PROMOTION_CAPTURE:
-            m_nnue.update_features<1, 2>(
-                    {move.destination()},
-                    {Piece(moved_color, move.promotion_piece_type())},
-                    {move.source(), move.destination()},
-                    {move.source_piece(), move.captured_piece()});
+            dirty.add(move.destination(), Piece(moved_color, move.promotion_piece_type()));
+            dirty.remove(move.source(), moved_piece);
+            dirty.remove(move.destination(), move.captured_piece());
             break;
         case MT_SIMPLE_CAPTURE:
-            m_nnue.update_features<1, 2>(
-                    {move.destination()},
-                    {move.source_piece()},
-                    {move.source(), move.destination()},
-                    {move.source_piece(), move.captured_piece()});
+            dirty.add(move.destination(), moved_piece);
+            dirty.remove(move.source(), moved_piece);
+            dirty.remove(move.destination(), move.captured_piece());
             break;
         case MT_SIMPLE_PROMOTION:
-            m_nnue.update_features<1, 1>(
-                    {move.destination()},
-                    {Piece(moved_color, move.promotion_piece_type())},
-                    {move.source()},
-                    {move.source_piece()});
+            dirty.add(move.destination(), Piece(moved_color, move.promotion_piece_type()));
+            dirty.remove(move.source(), moved_piece);
             break;
         default:
-            m_nnue.update_features<1, 1>(
-                    {move.destination()},
-                    {move.source_piece()},
-                    {move.source()},
-                    {move.source_piece()});
+            dirty.add(move.destination(), moved_piece);
+            dirty.remove(move.source(), moved_piece);
             break;
     }
-}
-
-void Evaluation::apply_undo_move(Move move) {
-    m_ctm = opposite_color(m_ctm);
-    m_nnue.pop_accumulator();
-}
-
-void Evaluation::apply_make_null_move() {
-    m_ctm = opposite_color(m_ctm);
-}
 
-void Evaluation::apply_undo_null_move() {
-    m_ctm = opposite_color(m_ctm);
+    return dirty;
 }
 
 Score Evaluation::compute(const Board& board) {
-    apply_lazy_updates();
-    return std::clamp(m_nnue.forward(m_ctm, popcount(board.occupancy())), -KNOWN_WIN + 1, KNOWN_WIN - 1);
+    m_nnue.update_accumulators(board);
+    return std::clamp(m_nnue.forward(board.color_to_move(), popcount(board.occupancy())), -KNOWN_WIN + 1, KNOWN_WIN - 1);
 }
 
 static std::pair<double, double> wdl_params(Score score, const Board& board) {
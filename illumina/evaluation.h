@@ -20,18 +20,10 @@ public:
     void on_make_null_move(const Board& board);
     void on_undo_null_move(const Board& board);
 
-    void apply_lazy_updates();
-
 private:
     NNUE m_nnue;
-    Color m_ctm;
-    std::array<Move, MAX_DEPTH> m_lazy_updates;
-    size_t m_n_lazy_updates = 0;
-
-    void apply_make_move(Move move);
-    void apply_undo_move(Move move);
-    void apply_make_null_move();
-    void apply_undo_null_move();
+
+    static DirtyPieces dirty_pieces(Move move);
 };
 
 Score normalize_score(Score score, const Board& board);
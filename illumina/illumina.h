@@ -7,13 +7,16 @@
 #include "clock.h"
 #include "debug.h"
 #include "endgame.h"
+#include "epdanalysis.h"
 #include "evaluation.h"
 #include "movegen.h"
 #include "parsehelper.h"
 #include "perft.h"
 #include "search.h"
 #include "searchdefs.h"
+#include "searchservice.h"
 #include "staticlist.h"
+#include "tablebase.h"
 #include "types.h"
 #include "utils.h"
 #include "zobrist.h"
@@ -0,0 +1,331 @@
+#include "json.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace illumina {
+
+JSONValue::JSONValue(bool b)
+    : m_type(JSON_BOOL), m_bool(b) { }
+
+JSONValue::JSONValue(double number)
+    : m_type(JSON_NUMBER), m_number(number) { }
+
+JSONValue::JSONValue(std::string str)
+    : m_type(JSON_STRING), m_string(std::move(str)) { }
+
+JSONValue::JSONValue(std::vector<JSONValue> array)
+    : m_type(JSON_ARRAY), m_array(std::move(array)) { }
+
+JSONValue::JSONValue(std::map<std::string, JSONValue, std::less<>> object)
+    : m_type(JSON_OBJECT), m_object(std::move(object)) { }
+
+static void expect_type(const JSONValue& value, JSONType type, const char* type_name) {
+    if (value.type() != type) {
+        throw std::invalid_argument(std::string("Expected a JSON ") + type_name);
+    }
+}
+
+bool JSONValue::as_bool() const {
+    expect_type(*this, JSON_BOOL, "boolean");
+    return m_bool;
+}
+
+double JSONValue::as_number() const {
+    expect_type(*this, JSON_NUMBER, "number");
+    return m_number;
+}
+
+i64 JSONValue::as_int() const {
+    expect_type(*this, JSON_NUMBER, "number");
+    if (m_number != std::floor(m_number) || std::abs(m_number) > 9007199254740992.0) {
+        throw std::invalid_argument("Expected an integer");
+    }
+    return i64(m_number);
+}
+
+const std::string& JSONValue::as_string() const {
+    expect_type(*this, JSON_STRING, "string");
+    return m_string;
+}
+
+const std::vector<JSONValue>& JSONValue::as_array() const {
+    expect_type(*this, JSON_ARRAY, "array");
+    return m_array;
+}
+
+const JSONValue* JSONValue::find(std::string_view key) const {
+    if (m_type != JSON_OBJECT) {
+        return nullptr;
+    }
+    auto it = m_object.find(key);
+    return it == m_object.end() ? nullptr : &it->second;
+}
+
+namespace {
+
+/**
+ * Recursive descent parser over a string view.
+ */
+class JSONParser {
+public:
+    explicit JSONParser(std::string_view str)
+        : m_str(str) { }
+
+    JSONValue parse_document() {
+        JSONValue value = parse_value(0);
+        skip_whitespace();
+        if (m_pos != m_str.size()) {
+            fail("Unexpected trailing characters");
+        }
+        return value;
+    }
+
+private:
+    static constexpr int MAX_NESTING = 64;
+
+    std::string_view m_str;
+    size_t m_pos = 0;
+
+    [[noreturn]] void fail(const char* reason) const {
+        throw std::invalid_argument(std::string(reason) + " at offset " + std::to_string(m_pos));
+    }
+
+    void skip_whitespace() {
+        while (m_pos < m_str.size() && std::isspace(m_str[m_pos])) {
+            m_pos++;
+        }
+    }
+
+    char peek() const {
+        return m_pos < m_str.size() ? m_str[m_pos] : '\0';
+    }
+
+    void expect(char c) {
+        skip_whitespace();
+        if (peek() != c) {
+            fail((std::string("Expected '") + c + "'").c_str());
+        }
+        m_pos++;
+    }
+
+    bool consume_literal(std::string_view literal) {
+        if (m_str.substr(m_pos, literal.size()) != literal) {
+            return false;
+        }
+        m_pos += literal.size();
+        return true;
+    }
+
+    JSONValue parse_value(int nesting) {
+        if (nesting > MAX_NESTING) {
+            fail("Too deeply nested");
+        }
+
+        skip_whitespace();
+        char c = peek();
+        if (c == '{') {
+            return parse_object(nesting);
+        }
+        if (c == '[') {
+            return parse_array(nesting);
+        }
+        if (c == '"') {
+            return JSONValue(parse_string());
+        }
+        if (consume_literal("true")) {
+            return JSONValue(true);
+        }
+        if (consume_literal("false")) {
+            return JSONValue(false);
+        }
+        if (consume_literal("null")) {
+            return JSONValue();
+        }
+        return JSONValue(parse_number());
+    }
+
+    JSONValue parse_object(int nesting) {
+        std::map<std::string, JSONValue, std::less<>> object;
+        expect('{');
+        skip_whitespace();
+        if (peek() == '}') {
+            m_pos++;
+            return JSONValue(std::move(object));
+        }
+
+        while (true) {
+            skip_whitespace();
+            std::string key = parse_string();
+            expect(':');
+            object[key] = parse_value(nesting + 1);
+
+            skip_whitespace();
+            if (peek() == '}') {
+                m_pos++;
+                return JSONValue(std::move(object));
+            }
+            expect(',');
+        }
+    }
+
+    JSONValue parse_array(int nesting) {
+        std::vector<JSONValue> array;
+        expect('[');
+        skip_whitespace();
+        if (peek() == ']') {
+            m_pos++;
+            return JSONValue(std::move(array));
+        }
+
+        while (true) {
+            array.push_back(parse_value(nesting + 1));
+
+            skip_whitespace();
+            if (peek() == ']') {
+                m_pos++;
+                return JSONValue(std::move(array));
+            }
+            expect(',');
+        }
+    }
+
+    std::string parse_string() {
+        if (peek() != '"') {
+            fail("Expected a string");
+        }
+        m_pos++;
+
+        std::string str;
+        while (m_pos < m_str.size()) {
+            char c = m_str[m_pos++];
+            if (c == '"') {
+                return str;
+            }
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+
+            char escaped = peek();
+            m_pos++;
+            switch (escaped) {
+                case '"':  str += '"';  break;
+                case '\\': str += '\\'; break;
+                case '/':  str += '/';  break;
+                case 'b':  str += '\b'; break;
+                case 'f':  str += '\f'; break;
+                case 'n':  str += '\n'; break;
+                case 'r':  str += '\r'; break;
+                case 't':  str += '\t'; break;
+                case 'u': {
+                    // Only code points in the basic multilingual
+                    // plane are supported, encoded as UTF-8.
+                    if (m_pos + 4 > m_str.size()) {
+                        fail("Truncated unicode escape");
+                    }
+                    ui32 code_point;
+                    if (!try_parse_hex(m_str.substr(m_pos, 4), code_point)) {
+                        fail("Invalid unicode escape");
+                    }
+                    m_pos += 4;
+                    append_utf8(str, code_point);
+                    break;
+                }
+                default:
+                    fail("Invalid escape sequence");
+            }
+        }
+        fail("Unterminated string");
+    }
+
+    double parse_number() {
+        size_t begin = m_pos;
+        while (m_pos < m_str.size() && (std::isdigit(m_str[m_pos]) || std::string_view("+-.eE").find(m_str[m_pos]) != std::string_view::npos)) {
+            m_pos++;
+        }
+        if (begin == m_pos) {
+            fail("Unexpected character");
+        }
+
+        std::string number_str(m_str.substr(begin, m_pos - begin));
+        char* end = nullptr;
+        double number = std::strtod(number_str.c_str(), &end);
+        if (end != number_str.c_str() + number_str.size()) {
+            m_pos = begin;
+            fail("Invalid number");
+        }
+        return number;
+    }
+
+    static bool try_parse_hex(std::string_view sv, ui32& value) {
+        value = 0;
+        for (char c: sv) {
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= ui32(c - '0');
+            }
+            else if (c >= 'a' && c <= 'f') {
+                value |= ui32(c - 'a' + 10);
+            }
+            else if (c >= 'A' && c <= 'F') {
+                value |= ui32(c - 'A' + 10);
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& str, ui32 code_point) {
+        if (code_point < 0x80) {
+            str += char(code_point);
+        }
+        else if (code_point < 0x800) {
+            str += char(0xC0 | (code_point >> 6));
+            str += char(0x80 | (code_point & 0x3F));
+        }
+        else {
+            str += char(0xE0 | (code_point >> 12));
+            str += char(0x80 | ((code_point >> 6) & 0x3F));
+            str += char(0x80 | (code_point & 0x3F));
+        }
+    }
+};
+
+} // namespace
+
+JSONValue JSONValue::parse(std::string_view str) {
+    return JSONParser(str).parse_document();
+}
+
+std::string json_quote(std::string_view str) {
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+    std::string quoted = "\"";
+    for (char c: str) {
+        switch (c) {
+            case '"':  quoted += "\\\""; break;
+            case '\\': quoted += "\\\\"; break;
+            case '\n': quoted += "\\n";  break;
+            case '\r': quoted += "\\r";  break;
+            case '\t': quoted += "\\t";  break;
+            default:
+                if (ui8(c) < 0x20) {
+                    quoted += "\\u00";
+                    quoted += HEX_DIGITS[ui8(c) >> 4];
+                    quoted += HEX_DIGITS[ui8(c) & 0xF];
+                }
+                else {
+                    quoted += c;
+                }
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+} // illumina
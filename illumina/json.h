@@ -0,0 +1,84 @@
+#ifndef ILLUMINA_JSON_H
+#define ILLUMINA_JSON_H
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+namespace illumina {
+
+enum JSONType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+/**
+ * Minimal JSON document model, just enough for line based protocols.
+ * Numbers are kept as doubles.
+ */
+class JSONValue {
+public:
+    JSONType type() const;
+    bool is_null() const;
+
+    /**
+     * Typed accessors. Throw std::invalid_argument if the value
+     * is of a different type.
+     */
+    bool                          as_bool() const;
+    double                        as_number() const;
+    i64                           as_int() const;
+    const std::string&            as_string() const;
+    const std::vector<JSONValue>& as_array() const;
+
+    /**
+     * Returns the member with the given key, or nullptr if this isn't
+     * an object or has no such member.
+     */
+    const JSONValue* find(std::string_view key) const;
+
+    /**
+     * Parses a whole JSON document. Throws std::invalid_argument
+     * on malformed input.
+     */
+    static JSONValue parse(std::string_view str);
+
+    JSONValue() = default;
+    explicit JSONValue(bool b);
+    explicit JSONValue(double number);
+    explicit JSONValue(std::string str);
+    explicit JSONValue(std::vector<JSONValue> array);
+    explicit JSONValue(std::map<std::string, JSONValue, std::less<>> object);
+
+private:
+    JSONType    m_type = JSON_NULL;
+    bool        m_bool = false;
+    double      m_number = 0;
+    std::string m_string;
+    std::vector<JSONValue> m_array;
+    std::map<std::string, JSONValue, std::less<>> m_object;
+};
+
+/**
+ * Quotes and escapes a string to be written in a JSON document.
+ */
+std::string json_quote(std::string_view str);
+
+inline JSONType JSONValue::type() const {
+    return m_type;
+}
+
+inline bool JSONValue::is_null() const {
+    return m_type == JSON_NULL;
+}
+
+} // illumina
+
+#endif // ILLUMINA_JSON_H
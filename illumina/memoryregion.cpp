@@ -0,0 +1,249 @@
+#include "memoryregion.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <string>
+#include <utility>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace illumina {
+
+const char* memory_backing_name(MemoryBacking backing) {
+    switch (backing) {
+        case MB_NONE:                   return "none";
+        case MB_REGULAR_PAGES:          return "regular pages";
+        case MB_TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+        case MB_HUGETLB_PAGES:          return "hugetlb pages";
+        case MB_FILE_MAPPING:           return "file mapping";
+    }
+    return "unknown";
+}
+
+static size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+#if defined(__linux__)
+
+static bool transparent_huge_pages_enabled() {
+    // When THP is disabled system-wide, madvise still succeeds but
+    // has no effect. Check the system mode so that we can report
+    // the backing correctly.
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string mode;
+    if (!std::getline(file, mode)) {
+        return false;
+    }
+    return mode.find("[never]") == std::string::npos;
+}
+
+void MemoryRegion::allocate(size_t size_bytes, bool large_pages) {
+    release();
+
+    size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    large_pages = large_pages && size_bytes >= HUGE_PAGE_SIZE;
+
+    if (!large_pages) {
+        size_t mapped_size = round_up(std::max(size_bytes, size_t(1)), page_size);
+        void* ptr = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        m_data        = ptr;
+        m_size        = size_bytes;
+        m_mapped_size = mapped_size;
+        m_backing     = MB_REGULAR_PAGES;
+        return;
+    }
+
+    size_t mapped_size = round_up(size_bytes, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+    // First, try to get pages from the explicitly reserved huge page pool.
+    // This usually only works if the system administrator reserved them.
+    void* hugetlb_ptr = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (hugetlb_ptr != MAP_FAILED) {
+        m_data        = hugetlb_ptr;
+        m_size        = size_bytes;
+        m_mapped_size = mapped_size;
+        m_backing     = MB_HUGETLB_PAGES;
+        return;
+    }
+#endif
+
+    // Otherwise, map regular memory aligned to a huge page boundary and
+    // ask the kernel to back it with transparent huge pages. We reserve an
+    // additional huge page and trim the excess to get the alignment.
+    size_t reserved_size = mapped_size + HUGE_PAGE_SIZE;
+    void* ptr = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    uintptr_t begin   = uintptr_t(ptr);
+    uintptr_t aligned = round_up(begin, HUGE_PAGE_SIZE);
+    uintptr_t end     = begin + reserved_size;
+    if (aligned > begin) {
+        munmap(ptr, aligned - begin);
+    }
+    if (end > aligned + mapped_size) {
+        munmap(reinterpret_cast<void*>(aligned + mapped_size), end - (aligned + mapped_size));
+    }
+
+    m_data        = reinterpret_cast<void*>(aligned);
+    m_size        = size_bytes;
+    m_mapped_size = mapped_size;
+    m_backing     = MB_REGULAR_PAGES;
+
+#ifdef MADV_HUGEPAGE
+    if (   transparent_huge_pages_enabled()
+        && madvise(m_data, m_mapped_size, MADV_HUGEPAGE) == 0) {
+        m_backing = MB_TRANSPARENT_HUGE_PAGES;
+    }
+#endif
+}
+
+bool MemoryRegion::map_file(const std::string& path) {
+    release();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file, so the
+    // descriptor can be closed right away.
+    size_t size = size_t(file_stat.st_size);
+    void* ptr   = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    m_data        = ptr;
+    m_size        = size;
+    m_mapped_size = size;
+    m_backing     = MB_FILE_MAPPING;
+    return true;
+}
+
+void MemoryRegion::release() {
+    if (m_data != nullptr) {
+        munmap(m_data, m_mapped_size);
+    }
+    m_data        = nullptr;
+    m_size        = 0;
+    m_mapped_size = 0;
+    m_backing     = MB_NONE;
+}
+
+#else
+
+static constexpr size_t FALLBACK_ALIGNMENT = 4096;
+
+void MemoryRegion::allocate(size_t size_bytes, bool large_pages) {
+    release();
+
+    // Huge pages are only supported on Linux, always fall back
+    // to regular aligned allocations elsewhere.
+    size_t mapped_size = round_up(std::max(size_bytes, size_t(1)), FALLBACK_ALIGNMENT);
+#if defined(_WIN32)
+    void* ptr = _aligned_malloc(mapped_size, FALLBACK_ALIGNMENT);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, FALLBACK_ALIGNMENT, mapped_size) != 0) {
+        ptr = nullptr;
+    }
+#endif
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memset(ptr, 0, mapped_size);
+
+    m_data        = ptr;
+    m_size        = size_bytes;
+    m_mapped_size = mapped_size;
+    m_backing     = MB_REGULAR_PAGES;
+}
+
+bool MemoryRegion::map_file(const std::string& path) {
+    release();
+
+    // No file mapping support here, read the whole file instead.
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+
+    std::streamoff size = file.tellg();
+    if (size <= 0) {
+        return false;
+    }
+
+    allocate(size_t(size), false);
+    file.seekg(0);
+    if (!file.read(static_cast<char*>(m_data), size)) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void MemoryRegion::release() {
+    if (m_data != nullptr) {
+#if defined(_WIN32)
+        _aligned_free(m_data);
+#else
+        std::free(m_data);
+#endif
+    }
+    m_data        = nullptr;
+    m_size        = 0;
+    m_mapped_size = 0;
+    m_backing     = MB_NONE;
+}
+
+#endif
+
+MemoryRegion::~MemoryRegion() {
+    release();
+}
+
+MemoryRegion::MemoryRegion(MemoryRegion&& rhs) noexcept
+    : m_data(std::exchange(rhs.m_data, nullptr)),
+      m_size(std::exchange(rhs.m_size, 0)),
+      m_mapped_size(std::exchange(rhs.m_mapped_size, 0)),
+      m_backing(std::exchange(rhs.m_backing, MB_NONE)) { }
+
+MemoryRegion& MemoryRegion::operator=(MemoryRegion&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        m_data        = std::exchange(rhs.m_data, nullptr);
+        m_size        = std::exchange(rhs.m_size, 0);
+        m_mapped_size = std::exchange(rhs.m_mapped_size, 0);
+        m_backing     = std::exchange(rhs.m_backing, MB_NONE);
+    }
+    return *this;
+}
+
+} // illumina
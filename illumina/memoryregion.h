@@ -0,0 +1,83 @@
+#ifndef ILLUMINA_MEMORYREGION_H
+#define ILLUMINA_MEMORYREGION_H
+
+#include <cstddef>
+#include <string>
+
+#include "types.h"
+
+namespace illumina {
+
+/**
+ * Describes which kind of pages back a memory region.
+ */
+enum MemoryBacking {
+    MB_NONE,
+    MB_REGULAR_PAGES,
+    MB_TRANSPARENT_HUGE_PAGES,
+    MB_HUGETLB_PAGES,
+    MB_FILE_MAPPING,
+};
+
+const char* memory_backing_name(MemoryBacking backing);
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Owning handle to a large, page-aligned and zero-initialized block of
+ * memory. Meant for big tables that are probed at random, such as the
+ * transposition table, where backing the block with huge pages greatly
+ * reduces TLB misses.
+ */
+class MemoryRegion {
+public:
+    void*         data() const;
+    size_t        size() const;
+    MemoryBacking backing() const;
+
+    /**
+     * Releases the current block (if any) and allocates a new one.
+     * If large pages are requested, try to obtain huge pages and fall
+     * back to regular pages when the system can't provide them.
+     * Throws std::bad_alloc when no memory could be obtained at all.
+     */
+    void allocate(size_t size_bytes, bool large_pages);
+
+    /**
+     * Releases the current block (if any) and maps the whole contents of
+     * a file as a private, copy-on-write block. Pages are only read from
+     * the file once they are touched, and writes never reach the file.
+     * Returns false if the file couldn't be mapped.
+     */
+    bool map_file(const std::string& path);
+    void release();
+
+    MemoryRegion() = default;
+    ~MemoryRegion();
+    MemoryRegion(MemoryRegion&& rhs) noexcept;
+    MemoryRegion& operator=(MemoryRegion&& rhs) noexcept;
+    MemoryRegion(const MemoryRegion& rhs) = delete;
+    MemoryRegion& operator=(const MemoryRegion& rhs) = delete;
+
+private:
+    void*         m_data         = nullptr;
+    size_t        m_size         = 0;
+    size_t        m_mapped_size  = 0;
+    MemoryBacking m_backing      = MB_NONE;
+};
+
+inline void* MemoryRegion::data() const {
+    return m_data;
+}
+
+inline size_t MemoryRegion::size() const {
+    return m_size;
+}
+
+inline MemoryBacking MemoryRegion::backing() const {
+    return m_backing;
+}
+
+} // illumina
+
+#endif // ILLUMINA_MEMORYREGION_H
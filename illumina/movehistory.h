@@ -42,6 +42,13 @@ public:
     void set_killer(Depth ply, Move killer);
     void reset();
 
+    /**
+     * Prepares the history for a new search in the same game.
+     * Killers are cleared since they are ply-relative, while
+     * history scores are aged so that newer information weighs more.
+     */
+    void new_search();
+
     void update_corrhist(const Board& board,
                          Depth depth,
                          int diff);
@@ -72,7 +79,7 @@ private:
     struct Data {
         CorrhistTable pawn_corrhist;
         CorrhistTable non_pawn_corrhist;
-        std::array<std::array<Move, 2>, MAX_DEPTH> killers {};
+        std::array<std::array<Move, 2>, MAX_PLY + 1> killers {};
         ButterflyArray<i16> butterfly {};
         std::array<std::array<PieceToArray<i16>, 2>, 2> threat_history {};
         PieceToArray<PieceToArray<i16>> counter_move_history {};
@@ -82,6 +89,12 @@ private:
     };
     std::unique_ptr<Data> m_data = std::make_unique<Data>();
 
+    static size_t corrhist_index(ui64 key);
+
+    template <typename T, size_t N>
+    static void age_history(std::array<T, N>& arr);
+    static void age_history(i16& history);
+
     void update_corrhist_entry(CorrhistTable& table,
                                ui64 key,
                                Color color,
@@ -138,6 +151,25 @@ inline void MoveHistory::reset() {
     std::memset(m_data.get(), 0, sizeof(Data));
 }
 
+inline void MoveHistory::new_search() {
+    m_data->killers = {};
+    age_history(m_data->butterfly);
+    age_history(m_data->threat_history);
+    age_history(m_data->counter_move_history);
+    age_history(m_data->capt_hist);
+}
+
+template <typename T, size_t N>
+inline void MoveHistory::age_history(std::array<T, N>& arr) {
+    for (T& elem: arr) {
+        age_history(elem);
+    }
+}
+
+inline void MoveHistory::age_history(i16& history) {
+    history /= 2;
+}
+
 inline int MoveHistory::quiet_history(Move move, Move last_move, bool threatened_from, bool threatened_to) const {
     return int(
                i64(MV_HIST_REGULAR_QHIST_WEIGHT * m_data->butterfly.get(move))
@@ -166,13 +198,19 @@ inline void MoveHistory::update_capture_history(Move move, Depth depth, bool goo
     update_history_by_depth(m_data->capt_hist.get(move)[move.captured_piece().type() - 1], depth, good);
 }
 
+inline size_t MoveHistory::corrhist_index(ui64 key) {
+    // Index with the upper bits of the key, so that the lower bits
+    // stored in the entry are independent from its position.
+    return mul_hi64(key, CORRHIST_ENTRIES);
+}
+
 inline void MoveHistory::update_corrhist_entry(CorrhistTable& table,
                                                ui64 key,
                                                Color color,
                                                int depth_score,
                                                int diff) {
     int scaled_diff = diff * CORRHIST_GRAIN;
-    CorrhistEntry& entry = table[color][key % CORRHIST_ENTRIES];
+    CorrhistEntry& entry = table[color][corrhist_index(key)];
     entry.key_low = key & BITMASK(16);
     i16& entry_value = entry.value;
     entry_value = std::clamp((int(entry_value) * (CORRHIST_BASE_WEIGHT - depth_score) + scaled_diff * depth_score) / CORRHIST_BASE_WEIGHT,
@@ -202,7 +240,7 @@ inline void MoveHistory::update_corrhist(const Board& board,
 
 inline int MoveHistory::pawn_corrhist(const Board& board) const {
     CorrhistEntry& entry = m_data->pawn_corrhist[board.color_to_move()]
-                                                [board.pawn_key() % CORRHIST_ENTRIES];
+                                                [corrhist_index(board.pawn_key())];
     return entry.key_low == (board.pawn_key() & BITMASK(16))
          ? entry.value
          : 0;
@@ -210,7 +248,7 @@ inline int MoveHistory::pawn_corrhist(const Board& board) const {
 
 inline int MoveHistory::non_pawn_corrhist(const Board& board) const {
     CorrhistEntry& entry = m_data->non_pawn_corrhist[board.color_to_move()]
-                                                    [board.pawn_key() % CORRHIST_ENTRIES];
+                                                    [corrhist_index(board.pawn_key())];
     return entry.key_low == (board.non_pawn_key() & BITMASK(16))
          ? entry.value
          : 0;
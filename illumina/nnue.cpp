@@ -6,6 +6,8 @@
 #include <cstddef>
 #include <stdexcept>
 
+#include "board.h"
+
 namespace illumina {
 
 INCBIN(_default_network, NNUE_PATH);
@@ -16,7 +18,7 @@ constexpr int SCALE = 400;
 constexpr int Q1    = 255;
 constexpr int Q2    = 64;
 
-constexpr size_t L1_WEIGHTS_BYTES = N_INPUTS * L1_SIZE * sizeof(i16);
+constexpr size_t L1_WEIGHTS_BYTES = INPUT_BUCKETS * N_INPUTS * L1_SIZE * sizeof(i16);
 constexpr size_t L1_BIASES_BYTES = L1_SIZE * sizeof(i16);
 constexpr size_t OUTPUT_WEIGHTS_BYTES = OUTPUT_BUCKETS * 2 * L1_SIZE * sizeof(i16);
 constexpr size_t OUTPUT_BIASES_BYTES = OUTPUT_BUCKETS * sizeof(i16);
@@ -44,13 +46,128 @@ constexpr size_t output_bucket(size_t piece_count) {
 }
 
 void NNUE::clear() {
-    // Copy all biases.
-    std::copy(m_net->l1_biases.begin(), m_net->l1_biases.end(), m_accum.white.begin());
-    std::copy(m_net->l1_biases.begin(), m_net->l1_biases.end(), m_accum.black.begin());
+    // The root accumulator has no parent, it always needs to be refreshed.
+    m_accum = m_accum_stack->data();
+    m_accum->computed      = { false, false };
+    m_accum->needs_refresh = { true, true };
+}
+
+void NNUE::push_accumulator(const DirtyPieces& dirty) {
+    ILLUMINA_ASSERT(m_accum < m_accum_stack->data() + ACCUMULATOR_STACK_SIZE - 1);
+
+    Accumulator& child  = *(++m_accum);
+    child.dirty         = dirty;
+    child.computed      = { false, false };
+    child.needs_refresh = { false, false };
+
+    if constexpr (INPUT_BUCKETS > 1) {
+        // Check if a king moved into another input bucket.
+        for (int i = 0; i < dirty.n_added; ++i) {
+            Piece piece = dirty.added_pieces[i];
+            if (piece.type() != PT_KING) {
+                continue;
+            }
+            for (int j = 0; j < dirty.n_removed; ++j) {
+                if (dirty.removed_pieces[j] == piece) {
+                    Color c = piece.color();
+                    child.needs_refresh[c] = king_bucket(c, dirty.removed_squares[j])
+                                          != king_bucket(c, dirty.added_squares[i]);
+                }
+            }
+        }
+    }
+}
+
+void NNUE::pop_accumulator() {
+    ILLUMINA_ASSERT(m_accum > m_accum_stack->data());
+
+    m_accum--;
+}
+
+void NNUE::update_accumulators(const Board& board) {
+    update_accumulator<CL_WHITE>(board);
+    update_accumulator<CL_BLACK>(board);
+}
+
+template <Color C>
+void NNUE::update_accumulator(const Board& board) {
+    // Walk back to the closest accumulator that is either computed
+    // or can't be derived from its parent.
+    Accumulator* it = m_accum;
+    while (!it->computed[C] && !it->needs_refresh[C]) {
+        ILLUMINA_ASSERT(it > m_accum_stack->data());
+        --it;
+    }
+
+    if (!it->computed[C]) {
+        // Deltas can't be applied across a refresh. Compute the current
+        // accumulator from scratch, leaving the ones in between untouched.
+        refresh(C, board);
+        return;
+    }
+
+    // Apply the deltas of every ply up to the current one.
+    for (; it != m_accum; ++it) {
+        apply_dirty_pieces<C>(*it, *(it + 1));
+    }
+}
+
+template <Color C>
+void NNUE::apply_dirty_pieces(const Accumulator& parent, Accumulator& child) const {
+    const DirtyPieces& dirty = child.dirty;
+    size_t bucket = parent.buckets[C];
+
+    std::array<size_t, 2> enabled {};
+    std::array<size_t, 2> disabled {};
+    for (int i = 0; i < dirty.n_added; ++i) {
+        enabled[i] = feature_index<C>(dirty.added_squares[i], dirty.added_pieces[i], bucket);
+    }
+    for (int i = 0; i < dirty.n_removed; ++i) {
+        disabled[i] = feature_index<C>(dirty.removed_squares[i], dirty.removed_pieces[i], bucket);
+    }
+
+    const i16* src = C == CL_WHITE ? parent.white.data() : parent.black.data();
+    i16* dst       = C == CL_WHITE ? child.white.data()  : child.black.data();
+
+    if (dirty.n_added == 1 && dirty.n_removed == 1) {
+        update_features<1, 1>(src, dst, enabled, disabled);
+    }
+    else if (dirty.n_added == 1 && dirty.n_removed == 2) {
+        update_features<1, 2>(src, dst, enabled, disabled);
+    }
+    else {
+        ILLUMINA_ASSERT(dirty.n_added == 2 && dirty.n_removed == 2);
+        update_features<2, 2>(src, dst, enabled, disabled);
+    }
+
+    child.buckets[C]  = ui8(bucket);
+    child.computed[C] = true;
+}
+
+template <int N_ENABLED, int N_DISABLED>
+void NNUE::update_features(const i16* src, i16* dst,
+                           const std::array<size_t, 2>& enabled,
+                           const std::array<size_t, 2>& disabled) const {
+    static_assert(N_ENABLED >= 0  && N_ENABLED <= 2);
+    static_assert(N_DISABLED >= 0 && N_DISABLED <= 2);
+
+    for (size_t i = 0; i < L1_SIZE; i += SimdVecI16::STRIDE) {
+        SimdVecI16 value = SimdVecI16::load_aligned(&src[i]);
+
+        for (int j = 0; j < N_ENABLED; ++j) {
+            value += SimdVecI16::load_aligned(&m_net->l1_weights[enabled[j] * L1_SIZE + i]);
+        }
+        for (int j = 0; j < N_DISABLED; ++j) {
+            value -= SimdVecI16::load_aligned(&m_net->l1_weights[disabled[j] * L1_SIZE + i]);
+        }
+
+        value.store_aligned(&dst[i]);
+    }
 }
 
 int NNUE::forward(Color color, size_t piece_count) const {
     ILLUMINA_ASSERT(bucket < OUTPUT_BUCKETS);
+    ILLUMINA_ASSERT(m_accum->computed[CL_WHITE] && m_accum->computed[CL_BLACK]);
 
     size_t bucket = output_bucket(piece_count);
 
@@ -58,18 +175,18 @@ int NNUE::forward(Color color, size_t piece_count) const {
     const SimdVecI16 zero = SimdVecI16::zero();
     const SimdVecI16 max  = SimdVecI16::broadcast(Q1);
 
-    const auto& our_accum   = color == CL_WHITE ? m_accum.white : m_accum.black;
-    const auto& their_accum = color == CL_WHITE ? m_accum.black : m_accum.white;
+    const auto& our_accum   = color == CL_WHITE ? m_accum->white : m_accum->black;
+    const auto& their_accum = color == CL_WHITE ? m_accum->black : m_accum->white;
     const i16* output_weights = m_net->output_weights.data() + bucket * 2 * L1_SIZE;
 
     for (size_t i = 0; i < L1_SIZE; i += SimdVecI16::STRIDE) {
         SimdVecI16 activated = SimdVecI16::clamp(SimdVecI16::load_aligned(&our_accum[i]), zero, max);
         SimdVecI16 weighted  = activated * SimdVecI16::load_aligned(&output_weights[i]);
-        sum += SimdVecI16::madd(activated, weighted);
+        sum = SimdVecI16::madd_add(sum, activated, weighted);
 
         activated = SimdVecI16::clamp(SimdVecI16::load_aligned(&their_accum[i]), zero, max);
         weighted = activated * SimdVecI16::load_aligned(&output_weights[L1_SIZE + i]);
-        sum += SimdVecI16::madd(activated, weighted);
+        sum = SimdVecI16::madd_add(sum, activated, weighted);
     }
 
     int output = sum.hadd();
@@ -78,27 +195,74 @@ int NNUE::forward(Color color, size_t piece_count) const {
     return output * SCALE / (Q1 * Q2);
 }
 
-void NNUE::enable_feature(Square square, Piece piece) {
-    update_features<1, 0>({square}, {piece}, {}, {});
-}
+void NNUE::refresh(Color perspective, const Board& board) {
+    PieceBitboards pieces {};
+    for (Color c: COLORS) {
+        for (PieceType pt: PIECE_TYPES) {
+            pieces[c][pt] = board.piece_bb(Piece(c, pt));
+        }
+    }
 
-void NNUE::disable_feature(Square square, Piece piece) {
-    update_features<0, 1>({}, {}, {square}, {piece});
-}
+    size_t bucket = king_bucket(perspective, board.king_square(perspective));
+    AccumulatorCacheEntry& entry = m_refresh_cache[perspective][bucket];
 
-void NNUE::push_accumulator() {
-    m_accum_stack.push_back(m_accum);
-}
+    // Collect the features that changed since the cached accumulator
+    // was computed.
+    std::array<size_t, 32> enabled;
+    std::array<size_t, 32> disabled;
+    size_t n_enabled  = 0;
+    size_t n_disabled = 0;
+    for (Color c: COLORS) {
+        for (PieceType pt: PIECE_TYPES) {
+            Piece piece(c, pt);
+            Bitboard added   = pieces[c][pt] & ~entry.pieces[c][pt];
+            Bitboard removed = entry.pieces[c][pt] & ~pieces[c][pt];
 
-void NNUE::pop_accumulator() {
-    ILLUMINA_ASSERT(!m_accum_stack.empty());
+            while (added) {
+                Square s = lsb(added);
+                enabled[n_enabled++] = perspective == CL_WHITE
+                                     ? feature_index<CL_WHITE>(s, piece, bucket)
+                                     : feature_index<CL_BLACK>(s, piece, bucket);
+                added = unset_lsb(added);
+            }
+            while (removed) {
+                Square s = lsb(removed);
+                disabled[n_disabled++] = perspective == CL_WHITE
+                                       ? feature_index<CL_WHITE>(s, piece, bucket)
+                                       : feature_index<CL_BLACK>(s, piece, bucket);
+                removed = unset_lsb(removed);
+            }
+        }
+    }
+    entry.pieces = pieces;
+
+    // Bring the cached accumulator up to date and copy it over.
+    auto& accum = perspective == CL_WHITE ? m_accum->white : m_accum->black;
+    for (size_t i = 0; i < L1_SIZE; i += SimdVecI16::STRIDE) {
+        SimdVecI16 value = SimdVecI16::load_aligned(&entry.values[i]);
 
-    m_accum = m_accum_stack.back();
-    m_accum_stack.pop_back();
+        for (size_t j = 0; j < n_enabled; ++j) {
+            value += SimdVecI16::load_aligned(&m_net->l1_weights[enabled[j] * L1_SIZE + i]);
+        }
+        for (size_t j = 0; j < n_disabled; ++j) {
+            value -= SimdVecI16::load_aligned(&m_net->l1_weights[disabled[j] * L1_SIZE + i]);
+        }
+
+        value.store_aligned(&entry.values[i]);
+        value.store_aligned(&accum[i]);
+    }
+    m_accum->buckets[perspective]  = ui8(bucket);
+    m_accum->computed[perspective] = true;
 }
 
 NNUE::NNUE()
     : m_net(s_default_network) {
+    // Cached accumulators start from an empty board.
+    for (auto& perspective_entries: m_refresh_cache) {
+        for (AccumulatorCacheEntry& entry: perspective_entries) {
+            std::copy(m_net->l1_biases.begin(), m_net->l1_biases.end(), entry.values.begin());
+        }
+    }
     clear();
 }
 
@@ -3,59 +3,186 @@
 
 #include <algorithm>
 #include <array>
-#include <vector>
+#include <memory>
 
+#include "searchdefs.h"
 #include "simd.h"
 #include "types.h"
 
 namespace illumina {
 
+class Board;
+
 static constexpr size_t N_INPUTS = 768;
 static constexpr size_t L1_SIZE  = 768;
 static constexpr size_t OUTPUT_BUCKETS = 2;
+static constexpr size_t INPUT_BUCKETS  = 1;
+
+/**
+ * Input bucket used by each perspective given the square of its own king,
+ * seen from white's point of view (black king squares are mirrored).
+ */
+static constexpr std::array<ui8, SQ_COUNT> KING_BUCKETS_LAYOUT {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+constexpr size_t king_bucket(Color perspective, Square king_square) {
+    if (perspective == CL_BLACK) {
+        king_square = mirror_vertical(king_square);
+    }
+    return KING_BUCKETS_LAYOUT[king_square];
+}
+
+/** Bitboards of every piece on the board, indexed by [color][piece type]. */
+using PieceBitboards = std::array<std::array<Bitboard, PT_COUNT>, CL_COUNT>;
 
 struct EvalNetwork {
-    alignas(64) std::array<i16, N_INPUTS * L1_SIZE> l1_weights;
+    alignas(64) std::array<i16, INPUT_BUCKETS * N_INPUTS * L1_SIZE> l1_weights;
     alignas(64) std::array<i16, L1_SIZE> l1_biases;
     alignas(64) std::array<i16, OUTPUT_BUCKETS * L1_SIZE * 2> output_weights;
     std::array<i16, OUTPUT_BUCKETS> output_biases;
 };
 
+/**
+ * Pieces added to and removed from the board by a single move.
+ * A move changes at most two pieces each way (castling).
+ */
+struct DirtyPieces {
+    int n_added   = 0;
+    int n_removed = 0;
+    std::array<Square, 2> added_squares {};
+    std::array<Piece, 2>  added_pieces {};
+    std::array<Square, 2> removed_squares {};
+    std::array<Piece, 2>  removed_pieces {};
+
+    void add(Square square, Piece piece);
+    void remove(Square square, Piece piece);
+};
+
 struct Accumulator {
     alignas(64) std::array<i16, L1_SIZE> white {};
     alignas(64) std::array<i16, L1_SIZE> black {};
+
+    /** Input bucket each perspective was computed with. */
+    std::array<ui8, CL_COUNT> buckets {};
+
+    /** Whether each perspective is up to date with its position. */
+    std::array<bool, CL_COUNT> computed {};
+
+    /**
+     * Whether each perspective can't be derived from the parent
+     * accumulator, since its king moved to another input bucket.
+     */
+    std::array<bool, CL_COUNT> needs_refresh {};
+
+    /** Pieces that changed from the parent position to this one. */
+    DirtyPieces dirty {};
 };
 
+/**
+ * Entry of the accumulator refresh cache (a.k.a. 'finny table').
+ * Holds the accumulator of one perspective in one input bucket, along with
+ * the pieces that were on the board when it was computed.
+ */
+struct AccumulatorCacheEntry {
+    alignas(64) std::array<i16, L1_SIZE> values {};
+    PieceBitboards pieces {};
+};
+
+/** One accumulator for the root position plus one for each ply below it. */
+static constexpr size_t ACCUMULATOR_STACK_SIZE = MAX_PLY + 1;
+using AccumulatorStack = std::array<Accumulator, ACCUMULATOR_STACK_SIZE>;
+
+/**
+ * Efficiently updatable network.
+ * Accumulators are updated lazily: making a move only records which pieces
+ * changed, and values are computed when an evaluation is requested. Only
+ * plies between the requested one and its closest computed ancestor are
+ * updated, so nodes that are never evaluated don't cost any work.
+ */
 class NNUE {
 public:
+    /**
+     * Resets the accumulator stack to a new root position.
+     */
     void clear();
-    void push_accumulator();
-    void pop_accumulator();
 
-    void enable_feature(Square square, Piece piece);
-    void disable_feature(Square square, Piece piece);
+    /**
+     * Pushes the accumulator of a child position, reached by the given
+     * piece changes. Its values are only computed on demand.
+     */
+    void push_accumulator(const DirtyPieces& dirty);
 
-    template <int N_ENABLED, int N_DISABLED>
-    void update_features(const std::array<Square, N_ENABLED>& enabled_squares,
-                         const std::array<Piece, N_ENABLED>& enabled_pieces,
-                         const std::array<Square, N_DISABLED>& disabled_squares,
-                         const std::array<Piece, N_DISABLED>& disabled_pieces);
+    /**
+     * Discards the current accumulator and goes back to its parent.
+     */
+    void pop_accumulator();
 
+    /**
+     * Brings both perspectives of the current accumulator up to date.
+     * The given board must be the current position.
+     */
+    void update_accumulators(const Board& board);
+
+    /**
+     * Evaluates the current accumulator. Requires it to be up to date.
+     */
     int forward(Color color, size_t piece_count) const;
 
     NNUE();
 
 private:
     const EvalNetwork* m_net;
-    Accumulator m_accum {};
-    std::vector<Accumulator> m_accum_stack;
+
+    // The accumulator stack is rather large. Keep it in the heap
+    // to prevent unintended stack allocations.
+    std::unique_ptr<AccumulatorStack> m_accum_stack = std::make_unique<AccumulatorStack>();
+    Accumulator* m_accum = m_accum_stack->data();
+    std::array<std::array<AccumulatorCacheEntry, INPUT_BUCKETS>, CL_COUNT> m_refresh_cache;
 
     template <Color C>
-    static size_t feature_index(Square square, Piece piece);
+    void update_accumulator(const Board& board);
+
+    template <Color C>
+    void apply_dirty_pieces(const Accumulator& parent, Accumulator& child) const;
+
+    template <int N_ENABLED, int N_DISABLED>
+    void update_features(const i16* src, i16* dst,
+                         const std::array<size_t, 2>& enabled,
+                         const std::array<size_t, 2>& disabled) const;
+
+    /**
+     * Recomputes the current accumulator of the given perspective from scratch.
+     * Starts from the last accumulator computed for the same perspective
+     * and input bucket, and only applies the pieces that changed since.
+     */
+    void refresh(Color perspective, const Board& board);
+
+    template <Color C>
+    static size_t feature_index(Square square, Piece piece, size_t bucket);
 };
 
+inline void DirtyPieces::add(Square square, Piece piece) {
+    added_squares[n_added] = square;
+    added_pieces[n_added]  = piece;
+    n_added++;
+}
+
+inline void DirtyPieces::remove(Square square, Piece piece) {
+    removed_squares[n_removed] = square;
+    removed_pieces[n_removed]  = piece;
+    n_removed++;
+}
+
 template <Color C>
-size_t NNUE::feature_index(Square square, Piece piece) {
+size_t NNUE::feature_index(Square square, Piece piece, size_t bucket) {
     Color color     = piece.color();
     size_t type_idx = piece.type() - 1;
 
@@ -64,54 +191,13 @@ size_t NNUE::feature_index(Square square, Piece piece) {
         color  = opposite_color(color);
     }
 
-    size_t index = 0;
+    size_t index = bucket;
     index = index * CL_COUNT + color;
     index = index * (PT_COUNT - 1) + type_idx;
     index = index * SQ_COUNT + square;
     return index;
 }
 
-template <int N_ENABLED, int N_DISABLED>
-void NNUE::update_features(const std::array<Square, N_ENABLED>& enabled_squares,
-                           const std::array<Piece, N_ENABLED>& enabled_pieces,
-                           const std::array<Square, N_DISABLED>& disabled_squares,
-                           const std::array<Piece, N_DISABLED>& disabled_pieces) {
-    static_assert(N_ENABLED >= 0  && N_ENABLED <= 2);
-    static_assert(N_DISABLED >= 0 && N_DISABLED <= 2);
-
-    std::array<size_t, N_ENABLED>  en_white_idxs;
-    std::array<size_t, N_ENABLED>  en_black_idxs;
-    std::array<size_t, N_DISABLED> dis_white_idxs;
-    std::array<size_t, N_DISABLED> dis_black_idxs;
-
-    for (int i = 0; i < N_ENABLED; ++i) {
-        en_white_idxs[i] = feature_index<CL_WHITE>(enabled_squares[i], enabled_pieces[i]);
-        en_black_idxs[i] = feature_index<CL_BLACK>(enabled_squares[i], enabled_pieces[i]);
-    }
-    for (int i = 0; i < N_DISABLED; ++i) {
-        dis_white_idxs[i] = feature_index<CL_WHITE>(disabled_squares[i], disabled_pieces[i]);
-        dis_black_idxs[i] = feature_index<CL_BLACK>(disabled_squares[i], disabled_pieces[i]);
-    }
-
-    auto update = [this](auto& accum, const auto& enabled, const auto& disabled) {
-        for (size_t i = 0; i < L1_SIZE; i += SimdVecI16::STRIDE) {
-            SimdVecI16 value = SimdVecI16::load_aligned(&accum[i]);
-
-            for (size_t index : enabled) {
-                value += SimdVecI16::load_aligned(&m_net->l1_weights[index * L1_SIZE + i]);
-            }
-            for (size_t index : disabled) {
-                value -= SimdVecI16::load_aligned(&m_net->l1_weights[index * L1_SIZE + i]);
-            }
-
-            value.store_aligned(&accum[i]);
-        }
-    };
-
-    update(m_accum.white, en_white_idxs, dis_white_idxs);
-    update(m_accum.black, en_black_idxs, dis_black_idxs);
-}
-
 } // illumina
 
 #endif // ILLUMINA_NNUE_H
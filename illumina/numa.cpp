@@ -0,0 +1,132 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "utils.h"
+
+namespace illumina {
+
+std::vector<int> parse_cpu_list(std::string_view cpu_list) {
+    std::vector<int> cpus;
+
+    while (!cpu_list.empty() && std::isspace(cpu_list.back())) {
+        cpu_list.remove_suffix(1);
+    }
+
+    while (!cpu_list.empty()) {
+        size_t comma = cpu_list.find(',');
+        std::string_view range = cpu_list.substr(0, comma);
+        cpu_list = comma == std::string_view::npos ? std::string_view() : cpu_list.substr(comma + 1);
+
+        size_t dash = range.find('-');
+        int first;
+        int last;
+        if (!try_parse_int(range.substr(0, dash), first)) {
+            return {};
+        }
+        if (dash == std::string_view::npos) {
+            last = first;
+        }
+        else if (!try_parse_int(range.substr(dash + 1), last)) {
+            return {};
+        }
+
+        if (first < 0 || last < first) {
+            return {};
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+#if defined(__linux__)
+
+using NumaNodes = std::vector<std::vector<int>>;
+
+static NumaNodes read_numa_nodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+
+    // Node ids may have gaps, but are never too far apart. Stop after a
+    // few consecutive missing ids.
+    constexpr int MAX_MISSING_NODES = 8;
+
+    NumaNodes nodes;
+    int n_missing = 0;
+    for (int node = 0; n_missing < MAX_MISSING_NODES; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpu_list;
+        if (!std::getline(file, cpu_list)) {
+            n_missing++;
+            continue;
+        }
+        n_missing = 0;
+
+        // Skip CPUs we're not allowed to run on (taskset, cgroups). Nodes
+        // left without CPUs (e.g. memory-only nodes) are ignored.
+        std::vector<int> cpus;
+        for (int cpu: parse_cpu_list(cpu_list)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+    return nodes;
+}
+
+static const NumaNodes& numa_nodes() {
+    static const NumaNodes s_nodes = read_numa_nodes();
+    return s_nodes;
+}
+
+size_t numa_node_count() {
+    return std::max(size_t(1), numa_nodes().size());
+}
+
+bool bind_thread_to_numa_node(size_t node) {
+    const NumaNodes& nodes = numa_nodes();
+    if (nodes.size() <= 1 || node >= nodes.size()) {
+        return false;
+    }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu: nodes[node]) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+#else
+
+size_t numa_node_count() {
+    return 1;
+}
+
+bool bind_thread_to_numa_node(size_t node) {
+    return false;
+}
+
+#endif
+
+size_t numa_node_for_thread(size_t thread_idx) {
+    return thread_idx % numa_node_count();
+}
+
+} // illumina
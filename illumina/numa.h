@@ -0,0 +1,40 @@
+#ifndef ILLUMINA_NUMA_H
+#define ILLUMINA_NUMA_H
+
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+namespace illumina {
+
+/**
+ * Number of NUMA nodes with CPUs available to this process, read from
+ * /sys/devices/system/node. Always at least 1, and exactly 1 wherever
+ * the topology can't be read.
+ */
+size_t numa_node_count();
+
+/**
+ * The node the thread_idx-th thread of a group should run on. Threads
+ * are spread across nodes in a round-robin fashion.
+ */
+size_t numa_node_for_thread(size_t thread_idx);
+
+/**
+ * Restricts the calling thread to the CPUs of the given node. Memory
+ * first touched by the thread afterwards is placed on that node.
+ * Returns false if the thread couldn't be bound, which is always the
+ * case on single node machines.
+ */
+bool bind_thread_to_numa_node(size_t node);
+
+/**
+ * Parses a Linux CPU list such as "0-3,8,10-11".
+ * Returns an empty list if the string is malformed.
+ */
+std::vector<int> parse_cpu_list(std::string_view cpu_list);
+
+} // illumina
+
+#endif // ILLUMINA_NUMA_H
@@ -3,6 +3,8 @@
 #include <atomic>
 #include <limits.h>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <sstream>
 #include <utility>
@@ -11,7 +13,10 @@
 #include "timemanager.h"
 #include "tunablevalues.h"
 #include "movepicker.h"
+#include "evalcache.h"
 #include "evaluation.h"
+#include "numa.h"
+#include "tablebase.h"
 #include "utils.h"
 
 namespace illumina {
@@ -25,8 +30,30 @@ struct RootInfo {
 
     /** The color to move in the root board. */
     Color color;
+
+    /** Tablebase probes done to filter the moves above. */
+    ui64 tb_hits = 0;
+};
+
+/**
+ * A move searched by a worker at the root. When searching multiple PVs,
+ * moves that beat the worst line found so far get an exact score and
+ * their own PV.
+ */
+struct RootMove {
+    Move  move;
+    Score score      = -MAX_SCORE; // -MAX_SCORE if not a line in this iteration.
+    Score prev_score = -MAX_SCORE; // Score in the previous iteration.
+    Depth sel_depth  = 0;
+    ui64  nodes      = 0;          // Nodes spent in this move's subtree.
+    std::vector<Move> pv;
+
+    explicit RootMove(Move move);
 };
 
+inline RootMove::RootMove(Move move)
+    : move(move) { }
+
 /**
  * Search node on the search stack.
  */
@@ -38,6 +65,7 @@ struct SearchNode {
 };
 
 class SearchWorker;
+class SearchTimer;
 
 /**
  * Search context shared among search workers.
@@ -45,6 +73,7 @@ class SearchWorker;
 class SearchContext {
 public:
     TimeManager&               time_manager() const;
+    SearchTimer&               timer() const;
     TranspositionTable&        tt() const;
     const Searcher::Listeners& listeners() const;
     const RootInfo&            root_info() const;
@@ -59,19 +88,29 @@ public:
     void stop_search() const;
     bool should_stop() const;
 
+    /**
+     * Whether we're still searching on the opponent's time, i.e. the
+     * GUI hasn't sent 'ponderhit' yet.
+     */
+    bool pondering() const;
+
     SearchContext(TranspositionTable* tt,
                   std::atomic<bool>* should_stop,
+                  const std::atomic<bool>* pondering,
                   const Searcher::Listeners* listeners,
                   const RootInfo* root_info,
                   const std::vector<std::unique_ptr<SearchWorker>>* helper_workers,
-                  TimeManager* time_manager);
+                  TimeManager* time_manager,
+                  SearchTimer* timer);
 
 private:
     TranspositionTable*        m_tt;
     const Searcher::Listeners* m_listeners;
     const RootInfo*            m_root_info;
     std::atomic<bool>*         m_stop;
+    const std::atomic<bool>*   m_pondering;
     TimeManager*               m_time_manager;
+    SearchTimer*               m_timer;
     TimePoint                  m_search_start;
     const std::vector<std::unique_ptr<SearchWorker>>* m_helper_workers;
 };
@@ -84,6 +123,10 @@ bool SearchContext::should_stop() const {
     return m_stop->load(std::memory_order_relaxed);
 }
 
+bool SearchContext::pondering() const {
+    return m_pondering->load(std::memory_order_relaxed);
+}
+
 ui64 SearchContext::elapsed() const {
     return delta_ms(now(), m_search_start);
 }
@@ -94,15 +137,19 @@ const Searcher::Listeners& SearchContext::listeners() const {
 
 SearchContext::SearchContext(TranspositionTable* tt,
                              std::atomic<bool>* should_stop,
+                             const std::atomic<bool>* pondering,
                              const Searcher::Listeners* listeners,
                              const RootInfo* root_info,
                              const std::vector<std::unique_ptr<SearchWorker>>* helper_workers,
-                             TimeManager* time_manager)
+                             TimeManager* time_manager,
+                             SearchTimer* timer)
         : m_tt(tt),
           m_listeners(listeners),
           m_root_info(root_info),
           m_stop(should_stop),
+          m_pondering(pondering),
           m_time_manager(time_manager),
+          m_timer(timer),
           m_search_start(now()),
           m_helper_workers(helper_workers)
 { }
@@ -115,6 +162,10 @@ TimeManager& SearchContext::time_manager() const {
     return *m_time_manager;
 }
 
+SearchTimer& SearchContext::timer() const {
+    return *m_timer;
+}
+
 const RootInfo& SearchContext::root_info() const {
     return *m_root_info;
 }
@@ -152,43 +203,105 @@ enum SearchFlags {
     SHALLOW = BIT(0)
 };
 
+/**
+ * Node counter of a single search worker, alone in its cache line. It is
+ * only ever written by the worker's own thread, while other threads may
+ * read it at any time to report or limit the total number of nodes.
+ */
+struct alignas(64) NodeCounter {
+    std::atomic<ui64> value { 0 };
+
+    void increment();
+    ui64 load() const;
+    void reset();
+};
+
+inline void NodeCounter::increment() {
+    // Single writer, no need for an atomic read-modify-write.
+    value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline ui64 NodeCounter::load() const {
+    return value.load(std::memory_order_relaxed);
+}
+
+inline void NodeCounter::reset() {
+    value.store(0, std::memory_order_relaxed);
+}
+
 class SearchWorker {
 public:
     void iterative_deepening();
     bool should_stop() const;
 
     ui64  nodes() const;
+
+    /**
+     * Nodes searched by this worker and every helper worker of
+     * the current search so far.
+     */
+    ui64  total_nodes() const;
+
+    /**
+     * Tablebase hits of this worker, every helper worker and the
+     * root of the current search so far.
+     */
+    ui64  total_tb_hits() const;
     Score score() const;
     Move  best_move() const;
     Move  ponder_move() const;
 
-    SearchWorker(bool main,
-                 const Board& board,
-                 SearchContext* context,
+    /**
+     * Prepares this worker for a new search on the given board.
+     * Workers are reused across searches, so every piece of per-search
+     * state must be reset here.
+     */
+    void prepare(const Board& board,
+                 const SearchContext* context,
                  const SearchSettings* settings);
 
+    void clear_history();
+
+    TranspositionTableStats& tt_stats();
+    const EvalCacheStats& eval_cache_stats() const;
+
+    explicit SearchWorker(bool main);
+
 private:
-    const SearchSettings* m_settings;
-    const SearchContext*  m_context;
+    const SearchSettings* m_settings = nullptr;
+    const SearchContext*  m_context  = nullptr;
     const bool m_main;
     int m_eval_random_margin = 0;
     int m_eval_random_seed = 0;
-    std::vector<Move> m_search_moves;
+
+    /**
+     * Moves searched at the root. After each iteration, they are sorted
+     * by score, so that the first n_pvs moves are our PV lines.
+     */
+    std::vector<RootMove> m_root_moves;
+    int m_n_pvs = 1;
 
     Board       m_board;
     MoveHistory m_hist;
     Evaluation  m_eval {};
+    EvalCache   m_eval_cache;
     Depth       m_root_depth = 1;
     Move        m_curr_move  = MOVE_NULL;
     int         m_curr_move_number = 0;
-    int         m_curr_pv_idx = 0;
     Depth       m_sel_depth = 0;
 
+    /** Positions with more pieces than this aren't probed in tablebases. */
+    int         m_tb_max_pieces = 0;
+
     Score m_score = 0;
-    ui64  m_nodes = 0;
+    NodeCounter m_nodes;
+    NodeCounter m_tb_hits;
+    bool  m_waiting_ponder_hit = false;
     Move  m_best_move = MOVE_NULL;
     Move  m_ponder_move = MOVE_NULL;
 
+    TranspositionTableStats m_tt_stats;
+
     template <TraceMode TRACE_MODE,
             SearchType SEARCH_TYPE,
             SearchFlags FLAGS = NO_SEARCH_FLAGS,
@@ -232,16 +345,363 @@ private:
 
     void check_limits();
     bool tracing() const;
+
+    void report_pv_line(int pv_idx,
+                        Score score,
+                        BoundType bound_type,
+                        Depth sel_depth,
+                        std::vector<Move> line,
+                        bool notify_tm);
+
+    RootMove& root_move(Move move);
+    bool is_root_move(Move move) const;
+    double root_move_node_fraction(Move move) const;
+    Score worst_pv_line_score() const;
+    void finish_multi_pv_iteration(bool interrupted);
+};
+
+/**
+ * Persistent set of search workers owned by a Searcher.
+ * The main worker always runs on the thread that called Searcher::search,
+ * while each helper worker lives on its own thread, sleeping on a condition
+ * variable between searches. Workers (and their histories/accumulators) stay
+ * allocated for as long as the number of threads doesn't change.
+ */
+class SearchThreadPool {
+public:
+    SearchWorker& main_worker();
+    const std::vector<std::unique_ptr<SearchWorker>>& helper_workers() const;
+
+    /**
+     * Spawns or joins helper threads so that exactly n_helpers are alive.
+     * If numa_aware is set, helpers are bound to NUMA nodes before creating
+     * their workers, so that each worker's memory is local to its node.
+     * Does nothing if neither the count nor the NUMA setting changed.
+     */
+    void set_helper_count(size_t n_helpers, bool numa_aware);
+
+    /**
+     * Prepares all helpers for a new search and wakes them up at once.
+     */
+    void start_helpers(const Board& board,
+                       const SearchContext* context,
+                       const SearchSettings* settings);
+
+    /**
+     * Blocks until every helper has finished its current search.
+     */
+    void wait_helpers();
+
+    void clear_histories();
+
+    TranspositionTableStats tt_stats();
+    void reset_tt_stats();
+    EvalCacheStats eval_cache_stats();
+
+    SearchThreadPool();
+    ~SearchThreadPool();
+    SearchThreadPool(const SearchThreadPool& rhs) = delete;
+    SearchThreadPool& operator=(const SearchThreadPool& rhs) = delete;
+
+private:
+    std::unique_ptr<SearchWorker> m_main_worker = std::make_unique<SearchWorker>(true);
+    std::vector<std::unique_ptr<SearchWorker>> m_helpers;
+    std::vector<std::thread> m_threads;
+    bool m_numa_aware = false;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wake_cv;
+    std::condition_variable m_idle_cv;
+    ui64   m_search_id = 0;
+    size_t m_n_busy    = 0;
+    bool   m_quit      = false;
+
+    void helper_loop(size_t idx, ui64 search_id);
+    void join_helpers();
 };
 
+/**
+ * Thread owned by a Searcher that raises its stop flag once the hard
+ * time bound is reached, so that search workers don't need to read the
+ * clock themselves. Sleeps on a condition variable while disarmed.
+ */
+class SearchTimer {
+public:
+    /**
+     * Schedules the stop flag to be raised at the given deadline,
+     * replacing any previously scheduled deadline.
+     */
+    void arm(TimePoint deadline);
+
+    /**
+     * Cancels the scheduled deadline. Returns the deadline if the timer
+     * already fired since it was last armed.
+     */
+    std::optional<TimePoint> disarm();
+
+    explicit SearchTimer(std::atomic_bool* stop);
+    ~SearchTimer();
+    SearchTimer(const SearchTimer& rhs) = delete;
+    SearchTimer& operator=(const SearchTimer& rhs) = delete;
+
+private:
+    std::atomic_bool* m_stop;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    TimePoint m_deadline {};
+    bool      m_armed = false;
+    bool      m_fired = false;
+    bool      m_quit  = false;
+    std::thread m_thread;
+
+    void timer_loop();
+};
+
+SearchThreadPool::SearchThreadPool() = default;
+
+SearchThreadPool::~SearchThreadPool() {
+    join_helpers();
+}
+
+SearchWorker& SearchThreadPool::main_worker() {
+    return *m_main_worker;
+}
+
+const std::vector<std::unique_ptr<SearchWorker>>& SearchThreadPool::helper_workers() const {
+    return m_helpers;
+}
+
+void SearchThreadPool::set_helper_count(size_t n_helpers, bool numa_aware) {
+    if (n_helpers == m_threads.size() && numa_aware == m_numa_aware) {
+        return;
+    }
+
+    join_helpers();
+
+    if (numa_aware && !m_numa_aware) {
+        // The calling thread has just been bound to its node. Recreate
+        // the main worker so that its memory is local to it as well.
+        m_main_worker = std::make_unique<SearchWorker>(true);
+    }
+    m_numa_aware = numa_aware;
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_quit   = false;
+        m_n_busy = n_helpers;
+        m_helpers.clear();
+        m_helpers.resize(n_helpers);
+    }
+
+    for (size_t i = 0; i < n_helpers; ++i) {
+        m_threads.emplace_back(&SearchThreadPool::helper_loop, this, i, m_search_id);
+    }
+
+    // Helpers construct their own workers, wait until all of them are done.
+    wait_helpers();
+}
+
+void SearchThreadPool::start_helpers(const Board& board,
+                                     const SearchContext* context,
+                                     const SearchSettings* settings) {
+    {
+        std::unique_lock lock(m_mutex);
+        for (std::unique_ptr<SearchWorker>& worker: m_helpers) {
+            worker->prepare(board, context, settings);
+        }
+        m_n_busy = m_helpers.size();
+        m_search_id++;
+    }
+    m_wake_cv.notify_all();
+}
+
+void SearchThreadPool::wait_helpers() {
+    std::unique_lock lock(m_mutex);
+    m_idle_cv.wait(lock, [this]() { return m_n_busy == 0; });
+}
+
+void SearchThreadPool::clear_histories() {
+    std::unique_lock lock(m_mutex);
+    m_main_worker->clear_history();
+    for (std::unique_ptr<SearchWorker>& worker: m_helpers) {
+        worker->clear_history();
+    }
+}
+
+TranspositionTableStats SearchThreadPool::tt_stats() {
+    std::unique_lock lock(m_mutex);
+    TranspositionTableStats stats = m_main_worker->tt_stats();
+    for (std::unique_ptr<SearchWorker>& worker: m_helpers) {
+        stats += worker->tt_stats();
+    }
+    return stats;
+}
+
+void SearchThreadPool::reset_tt_stats() {
+    std::unique_lock lock(m_mutex);
+    m_main_worker->tt_stats() = {};
+    for (std::unique_ptr<SearchWorker>& worker: m_helpers) {
+        worker->tt_stats() = {};
+    }
+}
+
+EvalCacheStats SearchThreadPool::eval_cache_stats() {
+    std::unique_lock lock(m_mutex);
+    EvalCacheStats stats = m_main_worker->eval_cache_stats();
+    for (std::unique_ptr<SearchWorker>& worker: m_helpers) {
+        stats += worker->eval_cache_stats();
+    }
+    return stats;
+}
+
+void SearchThreadPool::join_helpers() {
+    {
+        std::unique_lock lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake_cv.notify_all();
+
+    for (std::thread& thread: m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+}
+
+void SearchThreadPool::helper_loop(size_t idx, ui64 search_id) {
+    // The main thread is the first of the group.
+    if (m_numa_aware) {
+        bind_thread_to_numa_node(numa_node_for_thread(idx + 1));
+    }
+
+    // Construct the worker on its own thread, so that its memory
+    // is first touched by the thread that is going to use it.
+    auto worker = std::make_unique<SearchWorker>(false);
+
+    std::unique_lock lock(m_mutex);
+    m_helpers[idx] = std::move(worker);
+
+    while (true) {
+        if (--m_n_busy == 0) {
+            m_idle_cv.notify_all();
+        }
+
+        m_wake_cv.wait(lock, [this, search_id]() { return m_quit || m_search_id != search_id; });
+        if (m_quit) {
+            return;
+        }
+        search_id = m_search_id;
+
+        lock.unlock();
+        m_helpers[idx]->iterative_deepening();
+        lock.lock();
+    }
+}
+
+SearchTimer::SearchTimer(std::atomic_bool* stop)
+    : m_stop(stop), m_thread(&SearchTimer::timer_loop, this) { }
+
+SearchTimer::~SearchTimer() {
+    {
+        std::unique_lock lock(m_mutex);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void SearchTimer::arm(TimePoint deadline) {
+    {
+        std::unique_lock lock(m_mutex);
+        m_deadline = deadline;
+        m_armed    = true;
+        m_fired    = false;
+    }
+    m_cv.notify_all();
+}
+
+std::optional<TimePoint> SearchTimer::disarm() {
+    std::unique_lock lock(m_mutex);
+    m_armed = false;
+    if (!m_fired) {
+        return std::nullopt;
+    }
+    m_fired = false;
+    return m_deadline;
+}
+
+void SearchTimer::timer_loop() {
+    std::unique_lock lock(m_mutex);
+    while (!m_quit) {
+        if (!m_armed) {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        // We might be woken up early, either spuriously or because
+        // the deadline changed. Only fire once it has really passed.
+        m_cv.wait_until(lock, m_deadline);
+        if (m_armed && now() >= m_deadline) {
+            m_stop->store(true, std::memory_order_relaxed);
+            m_armed = false;
+            m_fired = true;
+        }
+    }
+}
+
+Searcher::Searcher()
+    : m_pool(std::make_unique<SearchThreadPool>()),
+      m_timer(std::make_unique<SearchTimer>(&m_stop)) { }
+
+Searcher::Searcher(TranspositionTable&& tt)
+    : m_tt(std::move(tt)),
+      m_pool(std::make_unique<SearchThreadPool>()),
+      m_timer(std::make_unique<SearchTimer>(&m_stop)) { }
+
+Searcher::~Searcher() = default;
+
 void Searcher::stop() {
-    m_stop.store(true, std::memory_order_relaxed);
+    {
+        std::unique_lock lock(m_ponder_mutex);
+        m_stop.store(true, std::memory_order_relaxed);
+    }
+    m_ponder_cv.notify_all();
+}
+
+void Searcher::ponder_hit() {
+    {
+        std::unique_lock lock(m_ponder_mutex);
+        m_pondering.store(false, std::memory_order_relaxed);
+    }
+    m_ponder_cv.notify_all();
+}
+
+void Searcher::clear_histories() {
+    m_pool->clear_histories();
+}
+
+TranspositionTableStats Searcher::tt_stats() const {
+    return m_pool->tt_stats();
+}
+
+void Searcher::reset_tt_stats() {
+    m_pool->reset_tt_stats();
+}
+
+EvalCacheStats Searcher::eval_cache_stats() const {
+    return m_pool->eval_cache_stats();
 }
 
 TranspositionTable& Searcher::tt() {
     return m_tt;
 }
 
+const TranspositionTable& Searcher::tt() const {
+    return m_tt;
+}
+
 // Some tracing related macros to prevent cumbersome 'if constexprs'
 
 #define TRACE_PUSH(move)                  \
@@ -276,6 +736,43 @@ do {                                      \
     }                                     \
 } while (false)
 
+static void start_time_manager(TimeManager& tm,
+                               SearchTimer& timer,
+                               const SearchSettings& settings,
+                               Color us) {
+    tm.set_move_overhead(ui64(std::max(i64(0), settings.move_overhead)));
+
+    if (settings.move_time.has_value()) {
+        // 'movetime'
+        tm.start_movetime(settings.move_time.value());
+    }
+    else if (settings.white_time.has_value() || settings.black_time.has_value()) {
+        // 'wtime/winc/btime/binc'
+        const std::optional<i64>& our_time   = us == CL_WHITE ? settings.white_time : settings.black_time;
+        const std::optional<i64>& our_inc    = us == CL_WHITE ? settings.white_inc  : settings.black_inc;
+        const std::optional<i64>& their_time = us == CL_WHITE ? settings.black_time : settings.white_time;
+        const std::optional<i64>& their_inc  = us == CL_WHITE ? settings.black_inc  : settings.white_inc;
+
+        // GUIs might send negative times when a player is low on time.
+        auto to_ms = [](const std::optional<i64>& ms, ui64 default_ms) {
+            return ms.has_value() ? ui64(std::max(i64(0), *ms)) : default_ms;
+        };
+
+        tm.start_tourney_time(to_ms(our_time, UINT64_MAX),
+                              to_ms(our_inc, 0),
+                              to_ms(their_time, UINT64_MAX),
+                              to_ms(their_inc, 0),
+                              settings.moves_to_go.value_or(0));
+    }
+    else {
+        // 'infinite'
+        tm.stop();
+        return;
+    }
+
+    timer.arm(tm.hard_deadline());
+}
+
 SearchResults Searcher::search(const Board& board,
                                const SearchSettings& settings) {
     // Create root info data.
@@ -313,51 +810,50 @@ SearchResults Searcher::search(const Board& board,
         results.total_nodes = 1;
         return results;
     }
+
+    // With few enough pieces, only search the moves that preserve
+    // the outcome of the root according to the tablebases.
+    if (   int(popcount(board.occupancy())) <= std::min(settings.syzygy_probe_limit, syzygy_max_pieces())
+        && syzygy_filter_root_moves(board, root_info.moves) != TBR_FAILED) {
+        root_info.tb_hits = 1;
+    }
     results.best_move = root_info.moves[0];
 
     // Create search context.
-    std::vector<std::unique_ptr<SearchWorker>> secondary_workers;
     m_stop.store(false, std::memory_order::memory_order_seq_cst);
+    m_pondering.store(settings.ponder, std::memory_order::memory_order_seq_cst);
     m_tt.new_search();
-    SearchContext context(&m_tt, &m_stop, &m_listeners, &root_info, &secondary_workers, &m_tm);
-
-    // Create main worker.
-    SearchWorker main_worker(true, board, &context, &settings);
 
-    // Kickstart our time manager.
-    ui64 our_time = UINT64_MAX;
-    if (settings.move_time.has_value()) {
-        // 'movetime'
-        our_time = settings.move_time.value();
-        m_tm.start_movetime(our_time);
+    // Spread search threads across NUMA nodes. The main worker runs
+    // on the calling thread, which is bound to the first node.
+    int n_helper_threads = std::max(1, settings.n_threads) - 1;
+    bool numa_aware = settings.numa_aware && n_helper_threads > 0 && numa_node_count() > 1;
+    if (numa_aware) {
+        bind_thread_to_numa_node(numa_node_for_thread(0));
     }
-    else if (settings.white_time.has_value() || settings.black_time.has_value()) {
-        // 'wtime/winc/btime/binc'
-        our_time = board.color_to_move() == CL_WHITE
-                   ? settings.white_time.value_or(UINT64_MAX)
-                   : settings.black_time.value_or(UINT64_MAX);
 
-        m_tm.start_tourney_time(our_time, 0, 0, 0);
+    // Make sure the pool has the number of helper threads we need.
+    // This is a no-op unless the number of threads changed.
+    m_pool->set_helper_count(n_helper_threads, numa_aware);
+
+    SearchContext context(&m_tt, &m_stop, &m_pondering, &m_listeners, &root_info, &m_pool->helper_workers(), &m_tm, m_timer.get());
+
+    // Prepare main worker.
+    SearchWorker& main_worker = m_pool->main_worker();
+    main_worker.prepare(board, &context, &settings);
+
+    // Kickstart our time manager. When pondering, our clock only starts
+    // running once the GUI tells us that the opponent played the
+    // expected move. Until then, search as if we had infinite time.
+    if (settings.ponder) {
+        m_tm.stop();
     }
     else {
-        // 'infinite'
-        m_tm.stop();
+        start_time_manager(m_tm, *m_timer, settings, root_info.color);
     }
 
-    // Determine the number of helper threads to be used.
-    int n_helper_threads = std::max(1, settings.n_threads) - 1;
-
-    // Fire secondary threads.
-    secondary_workers.clear();
-    std::vector<std::thread> helper_threads;
-    secondary_workers.resize(n_helper_threads);
-    for (int i = 0; i < n_helper_threads; ++i) {
-        helper_threads.emplace_back([&secondary_workers, &board, &context, &settings, i]() {
-            auto worker = std::make_unique<SearchWorker>(false, board, &context, &settings);
-            worker->iterative_deepening();
-            secondary_workers[i] = std::move(worker);
-        });
-    }
+    // Wake up helper threads.
+    m_pool->start_helpers(board, &context, &settings);
 
     // Initialize tracer search.
     if (settings.tracer != nullptr) {
@@ -366,6 +862,15 @@ SearchResults Searcher::search(const Board& board,
 
     main_worker.iterative_deepening();
 
+    // The GUI doesn't expect a best move while we're pondering. If the
+    // search finished before 'ponderhit' or 'stop', wait for one of them.
+    {
+        std::unique_lock lock(m_ponder_mutex);
+        m_ponder_cv.wait(lock, [this]() {
+            return !m_pondering.load(std::memory_order_relaxed) || m_stop.load(std::memory_order_relaxed);
+        });
+    }
+
     // Force search to be stopped.
     context.stop_search();
 
@@ -374,13 +879,14 @@ SearchResults Searcher::search(const Board& board,
         settings.tracer->finish_search();
     }
 
-    // Wait for secondary threads to stop.
-    for (std::thread& thread: helper_threads) {
-        if (thread.joinable()) {
-            thread.join();
-        }
+    // Wait for helper threads to go back to sleep.
+    m_pool->wait_helpers();
+
+    // Measure how long it took us to wind down since the hard bound.
+    std::optional<TimePoint> deadline = m_timer->disarm();
+    if (deadline.has_value()) {
+        results.stop_latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now() - *deadline).count();
     }
-    helper_threads.clear();
 
     // Fill in the search results object to be returned.
     // We assume that the best move is the one at MultiPV 1.
@@ -388,7 +894,7 @@ SearchResults Searcher::search(const Board& board,
     // to focus our efforts in improving MultiPV mode since
     // it is already not the one used for playing.
     results.score = main_worker.score();
-    results.total_nodes = main_worker.nodes();
+    results.total_nodes = main_worker.total_nodes();
 
     // Only accept non-null best moves.
     Move best_move = main_worker.best_move();
@@ -414,59 +920,43 @@ void SearchWorker::iterative_deepening() {
             m_context->stop_search();
         }
 
-        // Check if we need to interrupt the search.
-        if (should_stop()) {
+        // Check if we need to interrupt the search. If there are
+        // no moves to search, abort.
+        if (should_stop() || m_root_moves.empty()) {
             break;
         }
 
-        // Make sure this thread's search moves list is full once
-        // each new iteration starts.
-        m_search_moves = m_context->root_info().moves;
-
-        int n_pvs = std::clamp(m_settings->n_pvs, 1, MAX_PVS);
-        for (m_curr_pv_idx = 0; m_curr_pv_idx < n_pvs; ++m_curr_pv_idx) {
-            // If there are no moves to search, abort.
-            if (m_search_moves.empty()) {
-                break;
-            }
-
-            // Make sure we set a valid move as the best move so that
-            // we can return it if our search is interrupted early.
-            if (m_best_move == MOVE_NULL) {
-                m_best_move = m_search_moves[0];
-            }
+        for (RootMove& root_move: m_root_moves) {
+            root_move.prev_score = root_move.score;
+            root_move.score      = -MAX_SCORE;
+        }
 
-            check_limits();
-            aspiration_windows();
-            check_limits();
+        // Make sure we set a valid move as the best move so that
+        // we can return it if our search is interrupted early.
+        if (m_best_move == MOVE_NULL) {
+            m_best_move = m_root_moves[0].move;
+        }
 
-            // If we finished soft, we don't want to start a new iteration.
-            if (   m_main
-                && m_root_depth > 2
-                && m_context->time_manager().finished_soft()) {
-                m_context->stop_search();
-            }
+        check_limits();
+        aspiration_windows();
+        check_limits();
 
-            // Check if we need to interrupt the search.
-            if (should_stop()) {
-                break;
-            }
+        if (m_n_pvs > 1) {
+            finish_multi_pv_iteration(should_stop());
+        }
 
-            // When using MultiPV, erase the best searched move and look for a new
-            // pv without it.
-            Move pv_move = best_move();
-            auto best_move_it = std::find(m_search_moves.begin(), m_search_moves.end(), pv_move);
-            if (best_move_it != m_search_moves.end()) {
-                m_search_moves.erase(best_move_it);
-            }
+        // If we finished soft, we don't want to start a new iteration.
+        if (   m_main
+            && m_root_depth > 2
+            && m_context->time_manager().finished_soft()) {
+            m_context->stop_search();
         }
-        m_curr_pv_idx = 0;
     }
 }
 
 void SearchWorker::aspiration_windows() {
     // Prepare the search stack.
-    constexpr size_t STACK_SIZE = MAX_DEPTH + 64;
+    constexpr size_t STACK_SIZE = MAX_PLY + 1;
     SearchNode search_stack[STACK_SIZE];
     for (Depth ply = 0; ply < Depth(STACK_SIZE); ++ply) {
         SearchNode& node = search_stack[ply];
@@ -481,8 +971,9 @@ void SearchWorker::aspiration_windows() {
     Depth depth      = m_root_depth;
 
     // Don't use aspiration windows in lower depths since
-    // their results is still too unstable.
-    if (depth >= ASP_WIN_MIN_DEPTH) {
+    // their results is still too unstable. When searching multiple
+    // PVs, the root already narrows its window to the worst line.
+    if (depth >= ASP_WIN_MIN_DEPTH && m_n_pvs == 1) {
         alpha = std::max(-MAX_SCORE, prev_score - window);
         beta  = std::min(MAX_SCORE,  prev_score + window);
     }
@@ -498,7 +989,7 @@ void SearchWorker::aspiration_windows() {
         if (tracing()) {
             SearchTracer* tracer = m_settings->tracer;
             tracer->new_tree(m_root_depth,
-                             m_curr_pv_idx + 1,
+                             1,
                              alpha, beta);
             if (!m_settings->shallow_search_hint) {
                 score = negamax<TRACED, PVS, NO_SEARCH_FLAGS, SKIP_NMP, ROOT>(effective_depth, alpha, beta, &search_stack[0], false);
@@ -598,7 +1089,7 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
 
     // Make sure we count the root node.
     if constexpr (ROOT_NODE) {
-        m_nodes++;
+        m_nodes.increment();
     }
 
     // Check if we must stop our search.
@@ -616,6 +1107,11 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
         return draw_score();
     }
 
+    // Don't go any deeper than our ply-indexed stacks.
+    if (stack_node->ply >= MAX_PLY) {
+        return evaluate();
+    }
+
     // Setup some important values.
     TranspositionTable& tt = m_context->tt();
     ui64 board_key         = m_board.hash_key();
@@ -631,17 +1127,23 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
     // to use information gathered in other searches (or transpositions)
     // to improve the current search.
     TranspositionTableEntry tt_entry {};
-    bool found_in_tt = tt.probe(board_key, tt_entry, stack_node->ply);
+    bool found_in_tt = tt.probe(board_key, tt_entry, stack_node->ply, &m_tt_stats);
+    Move tt_move     = found_in_tt ? tt_entry.move(m_board) : MOVE_NULL;
 
+    // Entries torn by concurrent writes are rejected by the TT itself, but
+    // different positions might still share a key. Make sure the move can
+    // be played here. Full legality is checked by the move picker, except
+    // for check evasions.
     if (   found_in_tt
-        && tt_entry.move() != MOVE_NULL
-        && (   !m_board.is_move_pseudo_legal(tt_entry.move())
-            || !m_board.is_move_legal(tt_entry.move()))) {
+        && tt_move != MOVE_NULL
+        && (   !m_board.is_move_pseudo_legal(tt_move)
+            || (m_board.in_check() && !m_board.is_move_legal(tt_move)))) {
+        TT_STATS_INC(&m_tt_stats, key_collisions);
         found_in_tt = false;
     }
 
     if (found_in_tt) {
-        hash_move = tt_entry.move();
+        hash_move = tt_move;
 
         TRACE_SET(Traceable::FOUND_IN_TT, true);
         TRACE_SET(Traceable::TT_MOVE, hash_move);
@@ -664,8 +1166,70 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
         }
     }
 
+    // When searching multiple PVs, the root isn't stored in the TT.
+    // Start with the best line of the previous iteration instead.
+    if (ROOT_NODE && m_n_pvs > 1 && m_root_depth > 1) {
+        hash_move = m_root_moves[0].move;
+    }
+
     bool ttpv = PV_NODE || (found_in_tt && tt_entry.ttpv());
 
+    // Tablebase probing.
+    // WDL tables can only be probed right after captures and pawn moves,
+    // which is also when the material on the board changes.
+    Score tb_min_score = -MAX_SCORE;
+    Score tb_max_score = MAX_SCORE;
+    if (   !ROOT_NODE
+        && stack_node->skip_move == MOVE_NULL
+        && m_board.rule50() == 0
+        && int(popcount(m_board.occupancy())) <= m_tb_max_pieces
+        && depth >= m_settings->syzygy_probe_depth) {
+        TBResult tb_result = syzygy_probe_wdl(m_board);
+
+        if (tb_result != TBR_FAILED) {
+            m_tb_hits.increment();
+
+            // Cursed wins and blessed losses are draws under the 50 move rule.
+            Score tb_score     = 0;
+            BoundType tb_bound = BT_EXACT;
+            if (tb_result == TBR_WIN) {
+                tb_score = TB_WIN_SCORE - ply;
+                tb_bound = BT_LOWERBOUND;
+            }
+            else if (tb_result == TBR_LOSS) {
+                tb_score = -TB_WIN_SCORE + ply;
+                tb_bound = BT_UPPERBOUND;
+            }
+
+            if (   tb_bound == BT_EXACT
+                || (tb_bound == BT_LOWERBOUND && tb_score >= beta)
+                || (tb_bound == BT_UPPERBOUND && tb_score <= alpha)) {
+                // Tablebase scores won't change with deeper searches,
+                // keep them over most entries of this position. Pass the
+                // move we already had, or the entry would be kept instead.
+                Score tb_raw_eval = 0;
+                if (!in_check) {
+                    tb_raw_eval = found_in_tt ? tt_entry.static_eval() : evaluate();
+                }
+                Depth tb_depth = std::min(MAX_DEPTH, Depth(depth + 6));
+                tt.try_store(board_key, ply, hash_move, tb_score, tb_depth, tb_raw_eval, tb_bound, ttpv, &m_tt_stats);
+                return tb_score;
+            }
+
+            // PV nodes keep searching for the exact score, which can't
+            // fall outside of the tablebase bound.
+            if constexpr (PV_NODE) {
+                if (tb_bound == BT_LOWERBOUND) {
+                    tb_min_score = tb_score;
+                    alpha        = std::max(alpha, tb_score);
+                }
+                else {
+                    tb_max_score = tb_score;
+                }
+            }
+        }
+    }
+
     // Check extensions.
     // Extend positions in check.
     depth += in_check;
@@ -735,7 +1299,7 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
         m_board.undo_null_move();
 
         if (score >= beta) {
-            tt.try_store(board_key, ply, MOVE_NULL, score, depth, static_eval, BT_LOWERBOUND, ttpv);
+            tt.try_store(board_key, ply, MOVE_NULL, score, depth, static_eval, BT_LOWERBOUND, ttpv, &m_tt_stats);
             return score;
         }
     }
@@ -776,7 +1340,7 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
             }
             m_board.undo_move();
             if (pc_score >= pc_beta) {
-                tt.try_store(m_board.hash_key(), ply, move, pc_score, pc_depth, static_eval, BT_LOWERBOUND, ttpv);
+                tt.try_store(m_board.hash_key(), ply, move, pc_score, pc_depth, static_eval, BT_LOWERBOUND, ttpv, &m_tt_stats);
                 return pc_score;
             }
             pc_searched_moves++;
@@ -801,14 +1365,42 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
     StaticList<Move, MAX_GENERATED_MOVES> played_captures;
 
     int move_idx = -1;
+    int n_pv_lines = 0;
 
     auto threats = all_attacked_squares(m_board, opposite_color(m_board.color_to_move()));
     MovePicker move_picker(m_board, ply, m_hist, threats, hash_move);
     SearchMove move {};
-    Move best_move = found_in_tt ? tt_entry.move() : MOVE_NULL;
+    Move best_move = hash_move;
     bool has_legal_moves = false;
     Score best_score = -MAX_SCORE;
-    while ((move = move_picker.next()) != MOVE_NULL) {
+
+    // When searching multiple PVs, start with the lines found by the
+    // previous iteration, so that alpha quickly reaches the worst of them.
+    int n_seeded_lines = 0;
+    auto next_move = [&]() -> SearchMove {
+        if constexpr (ROOT_NODE) {
+            if (m_n_pvs > 1 && m_root_depth > 1) {
+                if (n_seeded_lines < m_n_pvs) {
+                    return m_root_moves[n_seeded_lines++].move;
+                }
+
+                auto seeded_end = m_root_moves.begin() + m_n_pvs;
+                SearchMove next;
+                while ((next = move_picker.next()) != MOVE_NULL) {
+                    bool seeded = std::any_of(m_root_moves.begin(), seeded_end, [&next](const RootMove& rm) {
+                        return rm.move == next;
+                    });
+                    if (!seeded) {
+                        break;
+                    }
+                }
+                return next;
+            }
+        }
+        return move_picker.next();
+    };
+
+    while ((move = next_move()) != MOVE_NULL) {
         has_legal_moves = true;
         if (move == stack_node->skip_move) {
             continue;
@@ -817,8 +1409,7 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
         move_idx++;
 
         // Skip unrequested moves.
-        if (ROOT_NODE
-            && std::find(m_search_moves.begin(), m_search_moves.end(), move) == m_search_moves.end()) {
+        if (ROOT_NODE && !is_root_move(move)) {
             continue;
         }
 
@@ -931,6 +1522,7 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
                 bit_is_set(threats, move.destination()));
         }
 
+        ui64 nodes_before = ROOT_NODE ? m_nodes.load() : 0;
         m_board.make_move(move);
         TRACE_SET(Traceable::LAST_MOVE_SCORE, move.value());
 
@@ -964,8 +1556,12 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
 
         Depth reductions = std::clamp(r / 1024, 0, depth);
 
+        // When searching multiple PVs, the first n_pvs moves all
+        // start new lines, so they get a full window right away.
+        bool full_window = n_searched_moves == 0 || (ROOT_NODE && m_n_pvs > 1 && n_pv_lines < m_n_pvs);
+
         Score score;
-        if (n_searched_moves == 0) {
+        if (full_window) {
             // Perform PVS. First move of the list is always PVS.
             score = -negamax<TRACE_MODE, SEARCH_TYPE, FLAGS>(depth - 1 + extensions, -beta, -alpha, stack_node + 1, false);
             TRACE_SET(Traceable::SCORE, -score);
@@ -994,6 +1590,10 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
 
         m_board.undo_move();
 
+        if constexpr (ROOT_NODE) {
+            root_move(move).nodes += m_nodes.load() - nodes_before;
+        }
+
         if (move.is_quiet()) {
             played_quiets.push_back(move);
         }
@@ -1043,6 +1643,28 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
             }
             break;
         }
+        if (ROOT_NODE && m_n_pvs > 1 && score > alpha) {
+            // This move makes it into our PV lines. Only moves that can beat
+            // the worst line from now on need an exact score.
+            RootMove& rm = root_move(move);
+            rm.score     = score;
+            rm.sel_depth = m_sel_depth;
+            rm.pv.assign(1, move);
+            for (Move pv_move: (stack_node + 1)->pv) {
+                if (pv_move == MOVE_NULL) {
+                    break;
+                }
+                rm.pv.push_back(pv_move);
+            }
+
+            if (++n_pv_lines >= m_n_pvs) {
+                alpha = worst_pv_line_score();
+            }
+            if (score == best_score) {
+                best_move = move;
+            }
+            continue;
+        }
         if (score > alpha) {
             // We've got a new best move.
             alpha     = score;
@@ -1083,10 +1705,13 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
     }
 
     best_score = n_searched_moves > 0 ? best_score : alpha;
+    best_score = std::clamp(best_score, tb_min_score, tb_max_score);
 
     // Store in transposition table.
-    // Don't store in singular searches.
-    if (stack_node->skip_move == MOVE_NULL) {
+    // Don't store in singular searches, nor in the root when searching
+    // multiple PVs, where alpha is the score of the worst line.
+    if (   stack_node->skip_move == MOVE_NULL
+        && !(ROOT_NODE && m_n_pvs > 1)) {
         if (alpha >= beta) {
             // Beta-Cutoff, lowerbound score.
             tt.try_store(board_key,
@@ -1094,7 +1719,8 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
                          best_score,
                          depth, raw_eval,
                          BT_LOWERBOUND,
-                         ttpv);
+                         ttpv,
+                         &m_tt_stats);
 
             // Update corrhist.
             if (   !in_check
@@ -1109,7 +1735,8 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
                          best_score,
                          depth, raw_eval,
                          BT_UPPERBOUND,
-                         ttpv);
+                         ttpv,
+                         &m_tt_stats);
 
             // Update corrhist.
             if (   !in_check
@@ -1124,7 +1751,8 @@ Score SearchWorker::negamax(Depth depth, Score alpha, Score beta, SearchNode* st
                          best_score,
                          depth, raw_eval,
                          BT_EXACT,
-                         ttpv);
+                         ttpv,
+                         &m_tt_stats);
 
             // Update corrhist.
             if (   !in_check
@@ -1153,40 +1781,31 @@ Score SearchWorker::quiescence_search(Depth ply, Score alpha, Score beta) {
     TRACE_SET(Traceable::DEPTH, 0);
     TRACE_SET(Traceable::IN_CHECK, m_board.in_check());
 
+    if (ply >= MAX_PLY) {
+        return evaluate();
+    }
+
     Score original_alpha = alpha;
 
     TranspositionTable& tt = m_context->tt();
     TranspositionTableEntry tt_entry;
     Move tt_move = MOVE_NULL;
-    bool found_in_tt = tt.probe(m_board.hash_key(), tt_entry);
-    if (found_in_tt
-        && tt_entry.move() != MOVE_NULL) {
-        // On multithreaded searches, race conditions might make it so
-        // that the TT move is invalid. The following check loses elo
-        // on single threaded searches (~-2), so we only do it if we're
-        // running SMP.
-        if ((!m_board.is_move_pseudo_legal(tt_entry.move())
-             || !m_board.is_move_legal(tt_entry.move()))) {
-            found_in_tt = false;
-        }
-        else {
-            // We're in qsearch, never search non capture moves.
-            tt_move = tt_entry.move().is_capture()
-                      ? tt_entry.move()
-                      : MOVE_NULL;
-        }
-    }
+    bool found_in_tt = tt.probe(m_board.hash_key(), tt_entry, 0, &m_tt_stats);
+    Move tt_entry_move = found_in_tt ? tt_entry.move(m_board) : MOVE_NULL;
 
+    // Same as in the main search, make sure the move is playable
+    // in case of a key collision.
     if (   found_in_tt
-        && tt_entry.move() != MOVE_NULL
-        && (   !m_board.is_move_pseudo_legal(tt_entry.move())
-                  || !m_board.is_move_legal(tt_entry.move()))) {
+        && tt_entry_move != MOVE_NULL
+        && (   !m_board.is_move_pseudo_legal(tt_entry_move)
+            || (m_board.in_check() && !m_board.is_move_legal(tt_entry_move)))) {
+        TT_STATS_INC(&m_tt_stats, key_collisions);
         found_in_tt = false;
     }
-    else {
-        tt_move = found_in_tt && tt_entry.move().is_capture()
-                  ? tt_entry.move()
-                  : MOVE_NULL;
+
+    // We're in qsearch, never search non capture moves.
+    if (found_in_tt && tt_entry_move.is_capture()) {
+        tt_move = tt_entry_move;
     }
 
     m_sel_depth = std::max(m_sel_depth, ply);
@@ -1254,7 +1873,8 @@ Score SearchWorker::quiescence_search(Depth ply, Score alpha, Score beta) {
                      best_score,
                      0, raw_eval,
                      BT_UPPERBOUND,
-                     false);
+                     false,
+                     &m_tt_stats);
     }
     else if (best_score >= beta) {
         tt.try_store(m_board.hash_key(),
@@ -1262,7 +1882,8 @@ Score SearchWorker::quiescence_search(Depth ply, Score alpha, Score beta) {
                      best_score,
                      0, raw_eval,
                      BT_LOWERBOUND,
-                     false);
+                     false,
+                     &m_tt_stats);
     }
     else {
         tt.try_store(m_board.hash_key(),
@@ -1270,24 +1891,29 @@ Score SearchWorker::quiescence_search(Depth ply, Score alpha, Score beta) {
                      best_score,
                      0, raw_eval,
                      BT_EXACT,
-                     false);
+                     false,
+                     &m_tt_stats);
     }
 
     return best_score;
 }
 
 Score SearchWorker::evaluate() {
-    // Check if we're in a known endgame.
-    Endgame eg = identify_endgame(m_board);
-
-    // We're on a known endgame. Use its evaluation.
-    if (eg.type != EG_UNKNOWN) {
-        return eg.evaluation;
+    // Positions evaluated recently are likely to still be cached. The
+    // cache stores evaluations before any randomness is applied, since
+    // the random seed can change between searches.
+    Score score;
+    if (!m_eval_cache.probe(m_board.hash_key(), score)) {
+        // Check if we're in a known endgame. If we are, use its
+        // evaluation. Otherwise, use our regular static evaluation
+        // function.
+        Endgame eg = identify_endgame(m_board);
+        score = eg.type != EG_UNKNOWN
+                ? Score(eg.evaluation)
+                : m_eval.compute(m_board);
+        m_eval_cache.store(m_board.hash_key(), score);
     }
 
-    // If we're not in a known endgame, use our regular
-    // static evaluation function.
-    Score score = m_eval.compute(m_board);
     if (m_eval_random_margin != 0) {
         // User has requested evaluation randomness, apply the noise.
         i32 seed   = Score((m_eval_random_seed * m_board.hash_key()) & BITMASK(15));
@@ -1307,6 +1933,12 @@ void SearchWorker::update_pv_results(const SearchNode* search_stack,
         return;
     }
 
+    // With multiple PVs, lines are only reported once the iteration
+    // finishes, see finish_multi_pv_iteration.
+    if (m_n_pvs > 1) {
+        return;
+    }
+
     Score score  = this->score();
     BoundType bt = score >= beta
                    ? BT_LOWERBOUND
@@ -1314,33 +1946,35 @@ void SearchWorker::update_pv_results(const SearchNode* search_stack,
                      ? BT_UPPERBOUND
                      : BT_EXACT;
 
-    PVResults pv_results;
-    pv_results.pv_idx     = m_curr_pv_idx;
-    pv_results.depth      = m_root_depth;
-    pv_results.sel_depth  = m_sel_depth;
-    pv_results.score      = score;
-    pv_results.time       = m_context->elapsed();
-    pv_results.bound_type = bt;
-
-    ui64 total_nodes = nodes();
-    for (const std::unique_ptr<SearchWorker>& worker: m_context->helper_workers()) {
-        if (worker == nullptr) {
-            continue;
-        }
-
-        total_nodes += worker->nodes();
-    }
-    pv_results.nodes = total_nodes;
-
     // Extract the PV line.
-    pv_results.line.clear();
+    std::vector<Move> line;
     for (Move pv_move: search_stack->pv) {
         if (pv_move == MOVE_NULL) {
             break;
         }
-        pv_results.line.push_back(pv_move);
+        line.push_back(pv_move);
     }
 
+    report_pv_line(0, score, bt, m_sel_depth, std::move(line), notify_tm);
+}
+
+void SearchWorker::report_pv_line(int pv_idx,
+                                  Score score,
+                                  BoundType bound_type,
+                                  Depth sel_depth,
+                                  std::vector<Move> line,
+                                  bool notify_tm) {
+    PVResults pv_results;
+    pv_results.pv_idx     = pv_idx;
+    pv_results.depth      = m_root_depth;
+    pv_results.sel_depth  = sel_depth;
+    pv_results.score      = score;
+    pv_results.time       = m_context->elapsed();
+    pv_results.bound_type = bound_type;
+    pv_results.nodes      = total_nodes();
+    pv_results.tb_hits    = total_tb_hits();
+    pv_results.line       = std::move(line);
+
     // The best move for a PV result is the first move of the line.
     // To not be confused with the SearchWorker's best move, as this
     // would be the best move of the entire search.
@@ -1352,7 +1986,14 @@ void SearchWorker::update_pv_results(const SearchNode* search_stack,
     if (notify_tm) {
         m_context->time_manager().on_new_pv(pv_results.depth,
                                             pv_results.best_move,
-                                            pv_results.score);
+                                            pv_results.score,
+                                            root_move_node_fraction(pv_results.best_move));
+
+        // The time manager might have decided that we can't afford
+        // another iteration.
+        if (m_context->time_manager().finished_hard()) {
+            m_context->stop_search();
+        }
     }
 
     // Notify whoever else needs to know about it.
@@ -1364,8 +2005,13 @@ void SearchWorker::check_limits() {
         return;
     }
 
+    // When searching alone, the node limit can be checked exactly.
+    // Otherwise, summing every worker's counter is too expensive to be
+    // done on every node, so we might overshoot the limit by a few
+    // nodes per helper.
     ui64 nodes = this->nodes();
-    if (nodes >= m_settings->max_nodes) {
+    bool single_thread = m_context->helper_workers().empty();
+    if (single_thread && nodes >= m_settings->max_nodes) {
         m_context->stop_search();
         return;
     }
@@ -1374,8 +2020,84 @@ void SearchWorker::check_limits() {
         return;
     }
 
-    if (m_context->time_manager().finished_hard()) {
+    // The opponent played the move we were pondering on, our clock
+    // is running from now on. Everything searched so far is kept.
+    if (m_waiting_ponder_hit && !m_context->pondering()) {
+        m_waiting_ponder_hit = false;
+        start_time_manager(m_context->time_manager(), m_context->timer(), *m_settings, m_context->root_info().color);
+    }
+
+    if (!single_thread && total_nodes() >= m_settings->max_nodes) {
         m_context->stop_search();
+        return;
+    }
+}
+
+RootMove& SearchWorker::root_move(Move move) {
+    return *std::find_if(m_root_moves.begin(), m_root_moves.end(), [move](const RootMove& rm) {
+        return rm.move == move;
+    });
+}
+
+bool SearchWorker::is_root_move(Move move) const {
+    return std::any_of(m_root_moves.begin(), m_root_moves.end(), [move](const RootMove& rm) {
+        return rm.move == move;
+    });
+}
+
+double SearchWorker::root_move_node_fraction(Move move) const {
+    ui64 total      = 0;
+    ui64 move_nodes = 0;
+    for (const RootMove& rm: m_root_moves) {
+        total += rm.nodes;
+        if (rm.move == move) {
+            move_nodes = rm.nodes;
+        }
+    }
+    return total > 0 ? double(move_nodes) / double(total) : 1.0;
+}
+
+Score SearchWorker::worst_pv_line_score() const {
+    StaticList<Score, MAX_GENERATED_MOVES> scores;
+    for (const RootMove& rm: m_root_moves) {
+        if (rm.score != -MAX_SCORE) {
+            scores.push_back(rm.score);
+        }
+    }
+    std::nth_element(scores.begin(), scores.begin() + (m_n_pvs - 1), scores.end(), std::greater<>());
+    return scores[m_n_pvs - 1];
+}
+
+void SearchWorker::finish_multi_pv_iteration(bool interrupted) {
+    if (interrupted) {
+        // Lines of an interrupted iteration aren't reliable,
+        // stick to the ones of the previous iteration.
+        for (RootMove& rm: m_root_moves) {
+            rm.score = rm.prev_score;
+        }
+    }
+    else {
+        std::stable_sort(m_root_moves.begin(), m_root_moves.end(), [](const RootMove& a, const RootMove& b) {
+            return a.score > b.score;
+        });
+    }
+
+    const RootMove& best_line = m_root_moves[0];
+    m_best_move = best_line.move;
+    if (best_line.score != -MAX_SCORE) {
+        m_score = best_line.score;
+    }
+    if (best_line.pv.size() > 1) {
+        m_ponder_move = best_line.pv[1];
+    }
+
+    if (!m_main || interrupted) {
+        return;
+    }
+
+    for (int i = 0; i < m_n_pvs; ++i) {
+        const RootMove& rm = m_root_moves[i];
+        report_pv_line(i, rm.score, BT_EXACT, rm.sel_depth, rm.pv, i == 0);
     }
 }
 
@@ -1388,7 +2110,7 @@ Score SearchWorker::draw_score() const {
 template <bool TRACING>
 void SearchWorker::on_make_move(const illumina::Board& board, illumina::Move move) {
     TRACE_PUSH();
-    m_nodes++;
+    m_nodes.increment();
     m_context->tt().prefetch(board.estimate_hash_key_after(move));
     m_eval.on_make_move(board, move);
 }
@@ -1402,7 +2124,7 @@ void SearchWorker::on_undo_move(const illumina::Board& board, illumina::Move mov
 template <bool TRACING>
 void SearchWorker::on_make_null_move(const illumina::Board& board) {
     TRACE_PUSH();
-    m_nodes++;
+    m_nodes.increment();
     m_eval.on_make_null_move(board);
 
     TRACE_SET(Traceable::LAST_MOVE, MOVE_NULL);
@@ -1424,7 +2146,23 @@ Score SearchWorker::score() const {
 }
 
 ui64 SearchWorker::nodes() const {
-    return m_nodes;
+    return m_nodes.load();
+}
+
+ui64 SearchWorker::total_nodes() const {
+    ui64 total = nodes();
+    for (const std::unique_ptr<SearchWorker>& worker: m_context->helper_workers()) {
+        total += worker->nodes();
+    }
+    return total;
+}
+
+ui64 SearchWorker::total_tb_hits() const {
+    ui64 total = m_context->root_info().tb_hits + m_tb_hits.load();
+    for (const std::unique_ptr<SearchWorker>& worker: m_context->helper_workers()) {
+        total += worker->m_tb_hits.load();
+    }
+    return total;
 }
 
 Move SearchWorker::best_move() const {
@@ -1435,21 +2173,40 @@ Move SearchWorker::ponder_move() const {
     return m_ponder_move;
 }
 
-SearchWorker::SearchWorker(bool main,
-                           const Board& board,
-                           SearchContext* context,
-                           const SearchSettings* settings)
-        : m_settings(settings),
-          m_context(context),
-          m_main(main),
-          m_eval_random_margin(settings->eval_random_margin),
-          m_eval_random_seed(settings->eval_rand_seed),
-          m_board(board) {
+SearchWorker::SearchWorker(bool main)
+        : m_main(main) { }
+
+void SearchWorker::prepare(const Board& board,
+                           const SearchContext* context,
+                           const SearchSettings* settings) {
+    m_settings           = settings;
+    m_context            = context;
+    m_eval_random_margin = settings->eval_random_margin;
+    m_eval_random_seed   = settings->eval_rand_seed;
+    m_root_depth         = 1;
+    m_curr_move          = MOVE_NULL;
+    m_curr_move_number   = 0;
+    m_sel_depth          = 0;
+    m_score              = 0;
+    m_nodes.reset();
+    m_tb_hits.reset();
+    m_tb_max_pieces      = std::min(settings->syzygy_probe_limit, syzygy_max_pieces());
+    m_waiting_ponder_hit = settings->ponder;
+    m_best_move          = MOVE_NULL;
+    m_ponder_move        = MOVE_NULL;
+    m_root_moves.clear();
+    for (Move move: context->root_info().moves) {
+        m_root_moves.emplace_back(move);
+    }
+    m_n_pvs = std::clamp(settings->n_pvs, 1, std::max(1, int(m_root_moves.size())));
+    m_hist.new_search();
+
+    m_board = board;
     m_eval.on_new_board(m_board);
 
     // Dispatch board callbacks to Worker's methods.
     BoardListener board_listener {};
-    if (!main || settings->tracer == nullptr) {
+    if (!m_main || settings->tracer == nullptr) {
         board_listener.on_make_null_move = [this](const Board& b) { on_make_null_move<false>(b); };
         board_listener.on_undo_null_move = [this](const Board& b) { on_undo_null_move<false>(b); };
         board_listener.on_make_move = [this](const Board& b, Move m) { on_make_move<false>(b, m); };
@@ -1464,6 +2221,18 @@ SearchWorker::SearchWorker(bool main,
     m_board.set_listener(board_listener);
 }
 
+void SearchWorker::clear_history() {
+    m_hist.reset();
+}
+
+TranspositionTableStats& SearchWorker::tt_stats() {
+    return m_tt_stats;
+}
+
+const EvalCacheStats& SearchWorker::eval_cache_stats() const {
+    return m_eval_cache.stats();
+}
+
 bool SearchWorker::tracing() const {
     return m_main && m_settings->tracer != nullptr;
 }
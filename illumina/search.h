@@ -5,8 +5,11 @@
 #include <optional>
 #include <memory>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #include "board.h"
+#include "evalcache.h"
 #include "timemanager.h"
 #include "tracing.h"
 #include "types.h"
@@ -14,6 +17,9 @@
 
 namespace illumina {
 
+class SearchThreadPool;
+class SearchTimer;
+
 struct PVResults {
     Depth depth;
     int pv_idx;
@@ -21,6 +27,7 @@ struct PVResults {
     Move  best_move;
     Score score;
     ui64  nodes;
+    ui64  tb_hits;
     ui64  time;
     BoundType bound_type;
     std::vector<Move> line;
@@ -39,9 +46,36 @@ struct SearchSettings {
     std::optional<i64>   black_time;
     std::optional<i64>   black_inc;
     std::optional<i64>   move_time;
+    std::optional<int>   moves_to_go;
+
+    /**
+     * Milliseconds we expect to lose to communication lag on every move.
+     */
+    i64 move_overhead = LAG_MARGIN;
+
+    /**
+     * Search on the opponent's time. Time limits only apply
+     * once Searcher::ponder_hit is called.
+     */
+    bool ponder = false;
     std::optional<std::vector<Move>> search_moves;
     SearchTracer* tracer = nullptr;
     bool shallow_search_hint = false;
+
+    /**
+     * On machines with several NUMA nodes, bind search threads to
+     * alternating nodes. The thread calling Searcher::search is bound
+     * to the first node for good.
+     */
+    bool numa_aware = false;
+
+    /**
+     * Positions with at most this many pieces are probed in Syzygy
+     * tablebases, if loaded. Nodes with less than syzygy_probe_depth
+     * plies left aren't probed.
+     */
+    int   syzygy_probe_limit = 7;
+    Depth syzygy_probe_depth = 1;
 };
 
 struct SearchResults {
@@ -49,6 +83,12 @@ struct SearchResults {
     Move  ponder_move;
     Score score;
     ui64 total_nodes = 0;
+
+    /**
+     * Microseconds between reaching the hard time bound and the search
+     * returning. Zero if the search didn't stop at the hard bound.
+     */
+    ui64 stop_latency_us = 0;
 };
 
 class Searcher {
@@ -60,27 +100,71 @@ public:
     using CurrentMoveListener = std::function<void(Depth depth, Move move, int move_num)>;
 
     TranspositionTable& tt();
+    const TranspositionTable& tt() const;
 
     SearchResults search(const Board& board,
                          const SearchSettings& settings);
     void stop();
 
+    /**
+     * The opponent played the move we've been pondering on. The running
+     * search continues, now under the time limits of its settings.
+     */
+    void ponder_hit();
+
+    /**
+     * Forgets the move histories learned by every search worker.
+     * Histories are otherwise kept between searches, so this should
+     * be called whenever a new game starts. Doesn't touch the
+     * transposition table.
+     */
+    void clear_histories();
+
+    /**
+     * Transposition table counters summed over every search worker.
+     * Only collected in builds with TT_STATS defined. Counters of
+     * helper workers are lost when the number of threads changes.
+     * Must not be called while searching.
+     */
+    TranspositionTableStats tt_stats() const;
+    void reset_tt_stats();
+
+    /**
+     * Static evaluation cache counters summed over every search worker.
+     * Must not be called while searching.
+     */
+    EvalCacheStats eval_cache_stats() const;
+
     void set_pv_finish_listener(const PVFinishListener& listener);
     void set_currmove_listener(const CurrentMoveListener& listener);
 
-    Searcher() = default;
+    Searcher();
     Searcher(const Searcher& other) = delete;
     explicit Searcher(TranspositionTable&& tt);
-    ~Searcher() = default;
+    ~Searcher();
 
 private:
     std::atomic_bool m_searching = false;
 
     std::atomic_bool m_stop = false;
+    std::atomic_bool m_pondering = false;
+    std::mutex m_ponder_mutex;
+    std::condition_variable m_ponder_cv;
     TranspositionTable m_tt;
 
     TimeManager m_tm;
 
+    /**
+     * Search workers and their threads are kept alive between
+     * searches, sleeping until the next search starts.
+     */
+    std::unique_ptr<SearchThreadPool> m_pool;
+
+    /**
+     * Raises m_stop at the hard time bound.
+     */
+    std::unique_ptr<SearchTimer> m_timer;
+
     struct Listeners {
         PVFinishListener    pv_finish = [](PVResults&) {};
         CurrentMoveListener curr_move_listener = [](Depth,Move,int) {};
@@ -95,9 +179,6 @@ inline void Searcher::set_currmove_listener(const CurrentMoveListener& listener)
     m_listeners.curr_move_listener = listener;
 }
 
-inline Searcher::Searcher(TranspositionTable&& tt)
-    : m_tt(std::move(tt)) { }
-
 void recompute_search_constants();
 
 } // illumina
@@ -19,6 +19,13 @@ using Depth = int;
 
 constexpr Depth MAX_DEPTH = 128;
 
+/**
+ * Deepest ply the search can reach, extensions and quiescence search
+ * included. Nodes at this ply return their static evaluation, so that
+ * stacks indexed by ply never need more than MAX_PLY + 1 entries.
+ */
+constexpr Depth MAX_PLY = MAX_DEPTH + 64;
+
 /**
  * Maximum number of multi negamax (as set by the MultiPV option).
  */
@@ -33,16 +40,29 @@ constexpr Score MATE_SCORE       = MAX_SCORE - 1;
 constexpr Score MATE_THRESHOLD   = MATE_SCORE - 1024;
 constexpr Score KNOWN_WIN        = 10000;
 
+/**
+ * Score of positions known to be won from endgame tablebases. Sits
+ * below every mate score, so that found mates are still preferred.
+ */
+constexpr Score TB_WIN_SCORE     = MATE_THRESHOLD - MAX_DEPTH - 1;
+
+/**
+ * Lowest score of a known win, either a mate or a tablebase win found
+ * at any ply. Scores past it are relative to the ply they were found at.
+ */
+constexpr Score TB_WIN_THRESHOLD = TB_WIN_SCORE - MAX_PLY;
+
 static_assert(MAX_SCORE        <= INT16_MAX);
 static_assert(MATE_SCORE       < MAX_SCORE);
 static_assert(MATE_THRESHOLD   < MATE_SCORE);
+static_assert(KNOWN_WIN        < TB_WIN_THRESHOLD);
 
 constexpr Score is_mate_score(Score score) {
     return score >= MATE_THRESHOLD || score <= -MATE_THRESHOLD;
 }
 
 constexpr int plies_to_mate(Score score) {
-    return std::abs(MATE_SCORE - score);
+    return MATE_SCORE - std::abs(score);
 }
 
 constexpr int moves_to_mate(Score score) {
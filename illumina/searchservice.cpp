@@ -0,0 +1,348 @@
+#include "searchservice.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "clock.h"
+
+namespace illumina {
+
+struct SearchService::Session {
+    SessionId id;
+    Board board = Board::standard_startpos();
+    TranspositionTable tt;
+    ui64 budget_left;
+
+    /** Whether the session has an analysis queued or running. */
+    bool analyzing = false;
+
+    /** Whether a worker is currently searching the session. */
+    bool running = false;
+    bool closing = false;
+
+    /**
+     * Read by the worker searching the session, which only checks it
+     * between iterations.
+     */
+    std::atomic_bool stop_requested = false;
+    Searcher* searcher = nullptr;
+
+    // Current analysis. Only touched by the worker searching the session.
+    AnalysisLimits limits;
+    TimePoint      analysis_start;
+    ui64           analysis_nodes = 0;
+    Depth          reported_depth = 0;
+    PVResults      best_pv {};
+
+    Session(SessionId id, const SessionSettings& settings)
+        : id(id),
+          tt(settings.hash_size_mb * 1024 * 1024),
+          budget_left(settings.node_budget) { }
+};
+
+struct SearchService::Worker {
+    // The worker's own table is never used, session tables are swapped in.
+    Searcher    searcher { TranspositionTable(sizeof(TranspositionTableCluster)) };
+    SessionId   last_session = 0;
+    std::thread thread;
+};
+
+SearchService::SearchService(size_t n_workers, ui64 slice_nodes)
+    : m_slice_nodes(std::max(slice_nodes, ui64(1))) {
+    n_workers = std::max(n_workers, size_t(1));
+    for (size_t i = 0; i < n_workers; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (std::unique_ptr<Worker>& worker: m_workers) {
+        worker->thread = std::thread([this, &worker]() { worker_loop(*worker); });
+    }
+}
+
+SearchService::~SearchService() {
+    {
+        std::unique_lock lock(m_mutex);
+        m_quit = true;
+        for (auto& [id, session]: m_sessions) {
+            session->stop_requested = true;
+            if (session->searcher != nullptr) {
+                session->searcher->stop();
+            }
+        }
+    }
+    m_work_cv.notify_all();
+
+    for (std::unique_ptr<Worker>& worker: m_workers) {
+        worker->thread.join();
+    }
+}
+
+SessionId SearchService::open_session(const SessionSettings& settings) {
+    // Allocate the table before locking, it might take a while.
+    SessionId id;
+    {
+        std::unique_lock lock(m_mutex);
+        id = m_next_session_id++;
+    }
+    auto session = std::make_unique<Session>(id, settings);
+
+    std::unique_lock lock(m_mutex);
+    m_sessions[id] = std::move(session);
+    return id;
+}
+
+bool SearchService::close_session(SessionId session_id) {
+    std::unique_lock lock(m_mutex);
+    Session* session = find_session(session_id);
+    if (session == nullptr || session->closing) {
+        return false;
+    }
+
+    if (session->running) {
+        // The worker searching the session erases it once it's done.
+        session->closing        = true;
+        session->stop_requested = true;
+        session->searcher->stop();
+        return true;
+    }
+
+    m_ready.erase(std::remove(m_ready.begin(), m_ready.end(), session_id), m_ready.end());
+    m_sessions.erase(session_id);
+    return true;
+}
+
+bool SearchService::set_position(SessionId session_id, const Board& board) {
+    std::unique_lock lock(m_mutex);
+    Session* session = find_session(session_id);
+    if (session == nullptr || session->closing || session->analyzing) {
+        return false;
+    }
+
+    session->board = board;
+    return true;
+}
+
+bool SearchService::analyze(SessionId session_id, const AnalysisLimits& limits) {
+    std::unique_lock lock(m_mutex);
+    Session* session = find_session(session_id);
+    if (   session == nullptr
+        || session->closing
+        || session->analyzing
+        || session->budget_left == 0) {
+        return false;
+    }
+
+    session->analyzing      = true;
+    session->stop_requested = false;
+    session->limits         = limits;
+    session->analysis_start = Clock::now();
+    session->analysis_nodes = 0;
+    session->reported_depth = 0;
+    session->best_pv        = {};
+
+    m_ready.push_back(session_id);
+    m_work_cv.notify_one();
+    return true;
+}
+
+bool SearchService::stop(SessionId session_id) {
+    std::unique_lock lock(m_mutex);
+    Session* session = find_session(session_id);
+    if (session == nullptr || session->closing) {
+        return false;
+    }
+    if (!session->analyzing) {
+        return true;
+    }
+
+    session->stop_requested = true;
+    if (session->running) {
+        session->searcher->stop();
+        return true;
+    }
+
+    // The session is waiting for a worker. Finish the analysis with
+    // whatever its previous slices found.
+    m_ready.erase(std::remove(m_ready.begin(), m_ready.end(), session_id), m_ready.end());
+    session->analyzing = false;
+
+    AnalysisResults results;
+    results.best_move   = session->best_pv.best_move;
+    results.score       = session->best_pv.score;
+    results.depth       = session->best_pv.depth;
+    results.nodes       = session->analysis_nodes;
+    results.budget_left = session->budget_left;
+    results.budget_exhausted = session->budget_left == 0;
+
+    lock.unlock();
+    notify_finish(session_id, results);
+    return true;
+}
+
+std::optional<ui64> SearchService::budget_left(SessionId session_id) const {
+    std::unique_lock lock(m_mutex);
+    Session* session = find_session(session_id);
+    if (session == nullptr) {
+        return std::nullopt;
+    }
+    return session->budget_left;
+}
+
+size_t SearchService::n_sessions() const {
+    std::unique_lock lock(m_mutex);
+    return m_sessions.size();
+}
+
+size_t SearchService::n_workers() const {
+    return m_workers.size();
+}
+
+void SearchService::set_pv_listener(const PVListener& listener) {
+    std::unique_lock lock(m_listeners_mutex);
+    m_pv_listener = listener;
+}
+
+void SearchService::set_finish_listener(const FinishListener& listener) {
+    std::unique_lock lock(m_listeners_mutex);
+    m_finish_listener = listener;
+}
+
+void SearchService::notify_pv(SessionId session, const PVResults& pv_results) {
+    std::unique_lock lock(m_listeners_mutex);
+    m_pv_listener(session, pv_results);
+}
+
+void SearchService::notify_finish(SessionId session, const AnalysisResults& results) {
+    std::unique_lock lock(m_listeners_mutex);
+    m_finish_listener(session, results);
+}
+
+SearchService::Session* SearchService::find_session(SessionId session_id) const {
+    auto it = m_sessions.find(session_id);
+    return it == m_sessions.end() ? nullptr : it->second.get();
+}
+
+void SearchService::worker_loop(Worker& worker) {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_work_cv.wait(lock, [this]() { return m_quit || !m_ready.empty(); });
+        if (m_quit) {
+            return;
+        }
+
+        SessionId session_id = m_ready.front();
+        m_ready.pop_front();
+
+        Session* session = find_session(session_id);
+        if (session != nullptr) {
+            search_slice(worker, *session, lock);
+        }
+    }
+}
+
+void SearchService::search_slice(Worker& worker,
+                                 Session& session,
+                                 std::unique_lock<std::mutex>& lock) {
+    const AnalysisLimits& limits = session.limits;
+
+    SearchSettings settings;
+    settings.max_depth     = limits.max_depth;
+    settings.move_overhead = 0;
+
+    ui64 slice_nodes = std::min({ m_slice_nodes,
+                                  limits.max_nodes - session.analysis_nodes,
+                                  session.budget_left });
+    settings.max_nodes = slice_nodes;
+
+    bool out_of_time = false;
+    if (limits.move_time.has_value()) {
+        i64 time_left = *limits.move_time - delta_ms(Clock::now(), session.analysis_start);
+        settings.move_time = time_left;
+        out_of_time        = time_left <= 0;
+    }
+
+    // Histories learned from other sessions would make results
+    // depend on the scheduling.
+    Searcher& searcher = worker.searcher;
+    if (worker.last_session != session.id) {
+        searcher.clear_histories();
+        worker.last_session = session.id;
+    }
+
+    SearchResults search_results {};
+    if (!out_of_time && !session.stop_requested) {
+        session.running  = true;
+        session.searcher = &searcher;
+        std::swap(searcher.tt(), session.tt);
+
+        // Later slices search the same depths again, mostly from the
+        // transposition table. Only report lines deeper than before.
+        ui64 nodes_before = session.analysis_nodes;
+        searcher.set_pv_finish_listener([this, &session, &searcher, nodes_before](PVResults& pv_results) {
+            if (session.stop_requested) {
+                searcher.stop();
+            }
+            // Searches interrupted at the slice's node limit
+            // report their unfinished iteration without a line.
+            if (   pv_results.pv_idx != 0
+                || pv_results.line.empty()
+                || pv_results.depth < session.reported_depth) {
+                return;
+            }
+
+            session.reported_depth = pv_results.depth;
+            session.best_pv        = pv_results;
+            session.best_pv.nodes += nodes_before;
+            session.best_pv.time   = delta_ms(Clock::now(), session.analysis_start);
+            notify_pv(session.id, session.best_pv);
+        });
+
+        Board board = session.board;
+        lock.unlock();
+        search_results = searcher.search(board, settings);
+        lock.lock();
+
+        std::swap(searcher.tt(), session.tt);
+        session.running  = false;
+        session.searcher = nullptr;
+
+        session.analysis_nodes += search_results.total_nodes;
+        if (session.budget_left != UINT64_MAX) {
+            session.budget_left -= std::min(session.budget_left, search_results.total_nodes);
+        }
+    }
+
+    if (session.closing) {
+        m_sessions.erase(session.id);
+        return;
+    }
+
+    // A slice ending before its node limit means the search finished
+    // on its own (or was stopped), otherwise there's more to search.
+    bool finished = out_of_time
+                 || m_quit
+                 || session.stop_requested
+                 || search_results.total_nodes < slice_nodes
+                 || session.analysis_nodes >= limits.max_nodes
+                 || session.budget_left == 0;
+    if (!finished) {
+        m_ready.push_back(session.id);
+        m_work_cv.notify_one();
+        return;
+    }
+
+    AnalysisResults results;
+    results.best_move        = session.best_pv.depth > 0 ? session.best_pv.best_move : search_results.best_move;
+    results.score            = session.best_pv.depth > 0 ? session.best_pv.score : search_results.score;
+    results.depth            = session.best_pv.depth;
+    results.nodes            = session.analysis_nodes;
+    results.budget_left      = session.budget_left;
+    results.budget_exhausted = session.budget_left == 0;
+    session.analyzing = false;
+
+    SessionId session_id = session.id;
+    lock.unlock();
+    notify_finish(session_id, results);
+    lock.lock();
+}
+
+} // illumina
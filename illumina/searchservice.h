@@ -0,0 +1,144 @@
+#ifndef ILLUMINA_SEARCHSERVICE_H
+#define ILLUMINA_SEARCHSERVICE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+#include "transpositiontable.h"
+
+namespace illumina {
+
+using SessionId = ui64;
+
+static constexpr size_t DEFAULT_SESSION_HASH_SIZE_MB = 16;
+
+/**
+ * Sessions are searched in slices of at most this many nodes, so that
+ * long analyses don't keep other sessions waiting for a worker.
+ */
+static constexpr ui64 DEFAULT_SERVICE_SLICE_NODES = 2000000;
+
+struct SessionSettings {
+    size_t hash_size_mb = DEFAULT_SESSION_HASH_SIZE_MB;
+
+    /**
+     * Nodes this session may search over its whole lifetime.
+     * UINT64_MAX means unlimited.
+     */
+    ui64 node_budget = UINT64_MAX;
+};
+
+struct AnalysisLimits {
+    std::optional<Depth> max_depth;
+    std::optional<i64>   move_time;
+    ui64 max_nodes = UINT64_MAX;
+};
+
+struct AnalysisResults {
+    Move  best_move;
+    Score score {};
+    Depth depth {};
+    ui64  nodes {};
+    ui64  budget_left {};
+    bool  budget_exhausted = false;
+};
+
+/**
+ * Hosts many independent analysis sessions in a single process. Each
+ * session has its own board, transposition table and node budget, while
+ * searches run on a fixed pool of workers, each owning a Searcher.
+ *
+ * Analyses are split into slices of a bounded number of nodes. Sessions
+ * with pending work take turns on the workers in round-robin order, and
+ * each slice keeps the transposition table of the previous ones, so that
+ * resuming a sliced analysis mostly costs a few table lookups.
+ *
+ * Every method is thread safe. Listeners are called from the workers, and
+ * must not call back into the service. Calls are serialized, so listeners
+ * must return quickly and never block on I/O. Replacing a listener waits
+ * for running calls to the previous one to return.
+ */
+class SearchService {
+public:
+    using PVListener     = std::function<void(SessionId session, const PVResults& pv_results)>;
+    using FinishListener = std::function<void(SessionId session, const AnalysisResults& results)>;
+
+    SessionId open_session(const SessionSettings& settings = {});
+
+    /**
+     * Closes a session, stopping its analysis. Returns false if
+     * there is no such session.
+     */
+    bool close_session(SessionId session);
+
+    /**
+     * Returns false if there is no such session or it is analyzing.
+     */
+    bool set_position(SessionId session, const Board& board);
+
+    /**
+     * Starts analyzing the session's position. Results are reported
+     * through the listeners. Returns false if there is no such session,
+     * it is already analyzing or its node budget is exhausted.
+     */
+    bool analyze(SessionId session, const AnalysisLimits& limits);
+
+    /**
+     * Stops the session's analysis. The finish listener is still called.
+     */
+    bool stop(SessionId session);
+
+    std::optional<ui64> budget_left(SessionId session) const;
+    size_t n_sessions() const;
+    size_t n_workers() const;
+
+    void set_pv_listener(const PVListener& listener);
+    void set_finish_listener(const FinishListener& listener);
+
+    explicit SearchService(size_t n_workers = 1, ui64 slice_nodes = DEFAULT_SERVICE_SLICE_NODES);
+    ~SearchService();
+    SearchService(const SearchService& rhs) = delete;
+    SearchService& operator=(const SearchService& rhs) = delete;
+
+private:
+    struct Session;
+    struct Worker;
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_work_cv;
+    bool m_quit = false;
+
+    SessionId m_next_session_id = 1;
+    std::unordered_map<SessionId, std::unique_ptr<Session>> m_sessions;
+
+    /**
+     * Sessions waiting for a worker, in the order they will be served.
+     */
+    std::deque<SessionId> m_ready;
+
+    ui64 m_slice_nodes;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex     m_listeners_mutex;
+    PVListener     m_pv_listener     = [](SessionId, const PVResults&) {};
+    FinishListener m_finish_listener = [](SessionId, const AnalysisResults&) {};
+
+    void worker_loop(Worker& worker);
+    void search_slice(Worker& worker, Session& session, std::unique_lock<std::mutex>& lock);
+    Session* find_session(SessionId session) const;
+    void notify_pv(SessionId session, const PVResults& pv_results);
+    void notify_finish(SessionId session, const AnalysisResults& results);
+};
+
+} // illumina
+
+#endif // ILLUMINA_SEARCHSERVICE_H
@@ -0,0 +1,444 @@
+#include "serviceserver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace illumina {
+
+//
+// Connections
+//
+
+ServiceConnection::ServiceConnection(ServiceServer& server, Writer writer)
+    : m_server(server), m_writer(std::move(writer)) {
+    m_writer_thread = std::thread([this]() { writer_loop(); });
+}
+
+ServiceConnection::~ServiceConnection() {
+    // Once unregistered, sessions can't report to us anymore.
+    for (SessionId session: m_sessions) {
+        m_server.unregister_session(session);
+        m_server.service().close_session(session);
+    }
+
+    {
+        std::unique_lock lock(m_queue_mutex);
+        m_closing = true;
+    }
+    m_queue_cv.notify_all();
+    m_writer_thread.join();
+}
+
+void ServiceConnection::write(const std::string& line, bool droppable) {
+    std::unique_lock lock(m_queue_mutex);
+    if (droppable && m_queue.size() >= SERVICE_MAX_QUEUED_LINES) {
+        return;
+    }
+    m_queue.push_back(line);
+    m_queue_cv.notify_all();
+}
+
+void ServiceConnection::flush() {
+    std::unique_lock lock(m_queue_mutex);
+    m_queue_cv.wait(lock, [this]() { return m_queue.empty() && !m_writing; });
+}
+
+void ServiceConnection::writer_loop() {
+    std::unique_lock lock(m_queue_mutex);
+    while (true) {
+        m_queue_cv.wait(lock, [this]() { return m_closing || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            return;
+        }
+
+        std::string line = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_writing = true;
+
+        lock.unlock();
+        m_writer(line);
+        lock.lock();
+
+        m_writing = false;
+        m_queue_cv.notify_all();
+    }
+}
+
+static std::string budget_json(ui64 budget) {
+    return budget == UINT64_MAX ? "null" : std::to_string(budget);
+}
+
+static std::string score_json(Score score) {
+    if (!is_mate_score(score)) {
+        return "{\"cp\":" + std::to_string(score) + "}";
+    }
+    int n_moves = moves_to_mate(score);
+    return "{\"mate\":" + std::to_string(score > 0 ? n_moves : -n_moves) + "}";
+}
+
+void ServiceConnection::report_pv(SessionId session, const PVResults& pv_results) {
+    std::stringstream stream;
+    stream << "{\"event\":\"info\",\"session\":" << session
+           << ",\"depth\":" << pv_results.depth
+           << ",\"seldepth\":" << pv_results.sel_depth
+           << ",\"score\":" << score_json(pv_results.score)
+           << ",\"nodes\":" << pv_results.nodes
+           << ",\"time\":" << pv_results.time
+           << ",\"pv\":[";
+    for (size_t i = 0; i < pv_results.line.size(); ++i) {
+        stream << (i > 0 ? "," : "") << json_quote(pv_results.line[i].to_uci());
+    }
+    stream << "]}";
+    write(stream.str(), true);
+}
+
+void ServiceConnection::report_finish(SessionId session, const AnalysisResults& results) {
+    std::stringstream stream;
+    stream << "{\"event\":\"bestmove\",\"session\":" << session
+           << ",\"move\":" << json_quote(results.best_move.to_uci())
+           << ",\"score\":" << score_json(results.score)
+           << ",\"depth\":" << results.depth
+           << ",\"nodes\":" << results.nodes
+           << ",\"budget_left\":" << budget_json(results.budget_left)
+           << ",\"budget_exhausted\":" << (results.budget_exhausted ? "true" : "false")
+           << "}";
+    write(stream.str());
+}
+
+void ServiceConnection::handle_line(std::string_view line) {
+    if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+        return;
+    }
+
+    std::string id_member;
+    try {
+        JSONValue request = JSONValue::parse(line);
+        if (request.type() != JSON_OBJECT) {
+            throw std::invalid_argument("Requests must be JSON objects");
+        }
+
+        // Echo the request id back, whatever its type.
+        if (const JSONValue* id = request.find("id"); id != nullptr) {
+            if (id->type() == JSON_STRING) {
+                id_member = ",\"id\":" + json_quote(id->as_string());
+            }
+            else if (id->type() == JSON_NUMBER) {
+                id_member = ",\"id\":" + std::to_string(id->as_int());
+            }
+        }
+
+        handle_request(request, id_member);
+    }
+    catch (const std::exception& e) {
+        write("{\"event\":\"error\"" + id_member + ",\"message\":" + json_quote(e.what()) + "}");
+    }
+}
+
+SessionId ServiceConnection::session_of(const JSONValue& request) const {
+    const JSONValue* session = request.find("session");
+    if (session == nullptr) {
+        throw std::invalid_argument("Missing 'session'");
+    }
+
+    // Connections may only use their own sessions.
+    SessionId session_id = SessionId(session->as_int());
+    if (m_sessions.count(session_id) == 0) {
+        throw std::invalid_argument("Unknown session " + std::to_string(session_id));
+    }
+    return session_id;
+}
+
+void ServiceConnection::handle_request(const JSONValue& request, const std::string& id_member) {
+    const JSONValue* cmd_value = request.find("cmd");
+    if (cmd_value == nullptr) {
+        throw std::invalid_argument("Missing 'cmd'");
+    }
+    const std::string& cmd = cmd_value->as_string();
+    SearchService& service = m_server.service();
+
+    if (cmd == "open") {
+        SessionSettings settings;
+        if (const JSONValue* hash = request.find("hash"); hash != nullptr) {
+            settings.hash_size_mb = size_t(std::max(hash->as_int(), i64(1)));
+        }
+        if (const JSONValue* budget = request.find("budget"); budget != nullptr && !budget->is_null()) {
+            settings.node_budget = ui64(std::max(budget->as_int(), i64(0)));
+        }
+
+        SessionId session = service.open_session(settings);
+        m_sessions.insert(session);
+        m_server.register_session(session, this);
+        write("{\"event\":\"opened\"" + id_member + ",\"session\":" + std::to_string(session) + "}");
+        return;
+    }
+
+    if (cmd == "position") {
+        SessionId session = session_of(request);
+
+        Board board = Board::standard_startpos();
+        if (const JSONValue* fen = request.find("fen"); fen != nullptr) {
+            board = Board(fen->as_string());
+        }
+        if (const JSONValue* moves = request.find("moves"); moves != nullptr) {
+            for (const JSONValue& move_value: moves->as_array()) {
+                Move move = Move::parse_uci(board, move_value.as_string());
+                if (move == MOVE_NULL || !board.is_move_pseudo_legal(move) || !board.is_move_legal(move)) {
+                    throw std::invalid_argument("Illegal move " + move_value.as_string());
+                }
+                board.make_move(move);
+            }
+        }
+
+        if (!service.set_position(session, board)) {
+            throw std::invalid_argument("Session is analyzing");
+        }
+        write("{\"event\":\"ok\"" + id_member + "}");
+        return;
+    }
+
+    if (cmd == "go") {
+        SessionId session = session_of(request);
+
+        AnalysisLimits limits;
+        if (const JSONValue* depth = request.find("depth"); depth != nullptr) {
+            limits.max_depth = Depth(std::clamp(depth->as_int(), i64(1), i64(MAX_DEPTH)));
+        }
+        if (const JSONValue* nodes = request.find("nodes"); nodes != nullptr) {
+            limits.max_nodes = ui64(std::max(nodes->as_int(), i64(1)));
+        }
+        if (const JSONValue* move_time = request.find("movetime"); move_time != nullptr) {
+            limits.move_time = move_time->as_int();
+        }
+
+        if (!service.analyze(session, limits)) {
+            throw std::invalid_argument("Session is analyzing or out of nodes");
+        }
+        write("{\"event\":\"ok\"" + id_member + "}");
+        return;
+    }
+
+    if (cmd == "stop") {
+        service.stop(session_of(request));
+        write("{\"event\":\"ok\"" + id_member + "}");
+        return;
+    }
+
+    if (cmd == "status") {
+        SessionId session = session_of(request);
+        std::optional<ui64> budget_left = service.budget_left(session);
+        write("{\"event\":\"status\"" + id_member
+              + ",\"session\":" + std::to_string(session)
+              + ",\"budget_left\":" + budget_json(budget_left.value_or(0))
+              + ",\"sessions\":" + std::to_string(service.n_sessions())
+              + ",\"workers\":" + std::to_string(service.n_workers()) + "}");
+        return;
+    }
+
+    if (cmd == "close") {
+        SessionId session = session_of(request);
+        m_sessions.erase(session);
+        m_server.unregister_session(session);
+        service.close_session(session);
+        write("{\"event\":\"ok\"" + id_member + "}");
+        return;
+    }
+
+    if (cmd == "quit") {
+        m_quit = true;
+        write("{\"event\":\"ok\"" + id_member + "}");
+        return;
+    }
+
+    throw std::invalid_argument("Unknown command '" + cmd + "'");
+}
+
+//
+// Server
+//
+
+ServiceServer::ServiceServer(SearchService& service)
+    : m_service(service) {
+    // Listeners are called from the service workers. Reports are made
+    // while holding the connections lock, so that connections can't be
+    // destroyed while being reported to. Reporting only queues a line.
+    m_service.set_pv_listener([this](SessionId session, const PVResults& pv_results) {
+        std::unique_lock lock(m_connections_mutex);
+        if (ServiceConnection* owner = session_owner(session)) {
+            owner->report_pv(session, pv_results);
+        }
+    });
+    m_service.set_finish_listener([this](SessionId session, const AnalysisResults& results) {
+        std::unique_lock lock(m_connections_mutex);
+        if (ServiceConnection* owner = session_owner(session)) {
+            owner->report_finish(session, results);
+        }
+    });
+}
+
+ServiceServer::~ServiceServer() {
+    m_service.set_pv_listener([](SessionId, const PVResults&) {});
+    m_service.set_finish_listener([](SessionId, const AnalysisResults&) {});
+}
+
+void ServiceServer::register_session(SessionId session, ServiceConnection* owner) {
+    std::unique_lock lock(m_connections_mutex);
+    m_session_owners[session] = owner;
+}
+
+void ServiceServer::unregister_session(SessionId session) {
+    std::unique_lock lock(m_connections_mutex);
+    m_session_owners.erase(session);
+}
+
+ServiceConnection* ServiceServer::session_owner(SessionId session) {
+    auto it = m_session_owners.find(session);
+    return it == m_session_owners.end() ? nullptr : it->second;
+}
+
+void ServiceServer::serve_stream(std::istream& in, std::ostream& out) {
+    ServiceConnection connection(*this, [&out](const std::string& line) {
+        out << line << std::endl;
+    });
+
+    std::string line;
+    while (!connection.quit_requested() && std::getline(in, line)) {
+        connection.handle_line(line);
+    }
+}
+
+#if defined(__linux__)
+
+/**
+ * Sends a whole line, ignoring peers that went away.
+ */
+static void send_line(int fd, const std::string& line) {
+    std::string data = line + '\n';
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += size_t(n);
+    }
+}
+
+bool ServiceServer::serve_unix_socket(const std::string& path) {
+    sockaddr_un address {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, path.size());
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Failed to create socket." << std::endl;
+        return false;
+    }
+
+    // Sockets left behind by previous runs would make bind fail.
+    unlink(path.c_str());
+    if (   bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on " << path << std::endl;
+        close(listen_fd);
+        return false;
+    }
+
+    std::mutex clients_mutex;
+    std::vector<int> client_fds;
+    std::vector<std::thread> client_threads;
+    std::atomic_bool quit = false;
+
+    auto serve_client = [&](int fd) {
+        {
+            ServiceConnection connection(*this, [fd](const std::string& line) {
+                send_line(fd, line);
+            });
+
+            std::string buffer;
+            char chunk[4096];
+            while (!connection.quit_requested()) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    break;
+                }
+                buffer.append(chunk, size_t(n));
+
+                size_t line_end;
+                while (!connection.quit_requested() && (line_end = buffer.find('\n')) != std::string::npos) {
+                    connection.handle_line(std::string_view(buffer).substr(0, line_end));
+                    buffer.erase(0, line_end + 1);
+                }
+            }
+
+            if (connection.quit_requested()) {
+                connection.flush();
+
+                // Wake up the accepting thread and every other client.
+                std::unique_lock lock(clients_mutex);
+                quit = true;
+                shutdown(listen_fd, SHUT_RDWR);
+                for (int client_fd: client_fds) {
+                    shutdown(client_fd, SHUT_RDWR);
+                }
+            }
+
+            // Unblocks our writer if the client stopped reading. Lines
+            // still queued can't be delivered anymore.
+            shutdown(fd, SHUT_RDWR);
+        }
+    };
+
+    while (!quit) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0 && errno == EINTR) {
+            continue;
+        }
+        if (fd < 0) {
+            break;
+        }
+
+        std::unique_lock lock(clients_mutex);
+        if (quit) {
+            close(fd);
+            break;
+        }
+        client_fds.push_back(fd);
+        client_threads.emplace_back(serve_client, fd);
+    }
+
+    for (std::thread& thread: client_threads) {
+        thread.join();
+    }
+    for (int fd: client_fds) {
+        close(fd);
+    }
+    close(listen_fd);
+    unlink(path.c_str());
+    return true;
+}
+
+#else
+
+bool ServiceServer::serve_unix_socket(const std::string& path) {
+    std::cerr << "Unix sockets are not supported on this platform." << std::endl;
+    return false;
+}
+
+#endif
+
+} // illumina
@@ -0,0 +1,136 @@
+#ifndef ILLUMINA_SERVICESERVER_H
+#define ILLUMINA_SERVICESERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "json.h"
+#include "searchservice.h"
+
+namespace illumina {
+
+class ServiceServer;
+
+/**
+ * Info events are dropped while a connection has this many lines waiting
+ * to be written, so that clients that stop reading can't exhaust our
+ * memory. Responses and bestmove events are never dropped.
+ */
+static constexpr size_t SERVICE_MAX_QUEUED_LINES = 1024;
+
+/**
+ * One client of a ServiceServer. Clients send one JSON request per line:
+ *
+ *   {"cmd": "open", "hash": 16, "budget": 100000000}
+ *   {"cmd": "position", "session": 1, "fen": "...", "moves": ["e2e4"]}
+ *   {"cmd": "go", "session": 1, "depth": 20, "nodes": 1000000, "movetime": 5000}
+ *   {"cmd": "stop", "session": 1}
+ *   {"cmd": "status", "session": 1}
+ *   {"cmd": "close", "session": 1}
+ *   {"cmd": "quit"}
+ *
+ * Every request is answered with a JSON line, echoing the request's "id"
+ * member if it has one. Analyses additionally report "info" and "bestmove"
+ * events. Sessions are owned by the connection that opened them, and are
+ * closed along with it.
+ *
+ * Lines are queued and written by a thread of the connection's own, so
+ * that a client that is slow to read never blocks the service workers
+ * or other connections. Lines still queued are written before the
+ * connection is destroyed.
+ */
+class ServiceConnection {
+public:
+    using Writer = std::function<void(const std::string& line)>;
+
+    void handle_line(std::string_view line);
+    bool quit_requested() const;
+
+    /**
+     * Waits until every queued line has been written.
+     */
+    void flush();
+
+    void report_pv(SessionId session, const PVResults& pv_results);
+    void report_finish(SessionId session, const AnalysisResults& results);
+
+    ServiceConnection(ServiceServer& server, Writer writer);
+    ~ServiceConnection();
+    ServiceConnection(const ServiceConnection& rhs) = delete;
+    ServiceConnection& operator=(const ServiceConnection& rhs) = delete;
+
+private:
+    ServiceServer&      m_server;
+    Writer              m_writer;
+    std::set<SessionId> m_sessions;
+    bool                m_quit = false;
+
+    std::mutex              m_queue_mutex;
+    std::condition_variable m_queue_cv;
+    std::deque<std::string> m_queue;
+    bool                    m_writing = false;
+    bool                    m_closing = false;
+    std::thread             m_writer_thread;
+
+    void write(const std::string& line, bool droppable = false);
+    void writer_loop();
+    void handle_request(const JSONValue& request, const std::string& id_member);
+    SessionId session_of(const JSONValue& request) const;
+};
+
+/**
+ * Serves a SearchService through a line delimited JSON protocol,
+ * routing the events of each session to the connection that owns it.
+ */
+class ServiceServer {
+public:
+    SearchService& service();
+
+    /**
+     * Serves a single connection reading requests from the given stream,
+     * until it ends or a 'quit' request is received.
+     */
+    void serve_stream(std::istream& in, std::ostream& out);
+
+    /**
+     * Accepts connections on a Unix domain socket at the given path,
+     * serving each one in its own thread, until any of them sends a
+     * 'quit' request. Returns false if the socket couldn't be created.
+     * Only supported on Linux.
+     */
+    bool serve_unix_socket(const std::string& path);
+
+    explicit ServiceServer(SearchService& service);
+    ~ServiceServer();
+
+private:
+    friend class ServiceConnection;
+
+    SearchService& m_service;
+    std::mutex     m_connections_mutex;
+    std::unordered_map<SessionId, ServiceConnection*> m_session_owners;
+
+    void register_session(SessionId session, ServiceConnection* owner);
+    void unregister_session(SessionId session);
+    ServiceConnection* session_owner(SessionId session);
+};
+
+inline SearchService& ServiceServer::service() {
+    return m_service;
+}
+
+inline bool ServiceConnection::quit_requested() const {
+    return m_quit;
+}
+
+} // illumina
+
+#endif // ILLUMINA_SERVICESERVER_H
@@ -31,6 +31,12 @@ public:
     static SimdVecI16 clamp(SimdVecI16 v, SimdVecI16 lo, SimdVecI16 hi);
     static SimdVecI32 madd(SimdVecI16 a, SimdVecI16 b);
 
+    /**
+     * Same as sum + madd(a, b). Fused into a single instruction
+     * on CPUs with VNNI support.
+     */
+    static SimdVecI32 madd_add(SimdVecI32 sum, SimdVecI16 a, SimdVecI16 b);
+
 private:
 #ifdef HAS_AVX512
     __m512i m_v;
@@ -173,6 +179,14 @@ inline SimdVecI32 SimdVecI16::madd(SimdVecI16 a, SimdVecI16 b) {
     return SimdVecI32(_mm512_madd_epi16(a.m_v, b.m_v));
 }
 
+inline SimdVecI32 SimdVecI16::madd_add(SimdVecI32 sum, SimdVecI16 a, SimdVecI16 b) {
+#ifdef HAS_VNNI
+    return SimdVecI32(_mm512_dpwssd_epi32(sum.m_v, a.m_v, b.m_v));
+#else
+    return sum + madd(a, b);
+#endif
+}
+
 #elif defined(HAS_AVX2)
 
 inline SimdVecI16 SimdVecI16::zero() {
@@ -276,6 +290,10 @@ inline SimdVecI32 SimdVecI16::madd(SimdVecI16 a, SimdVecI16 b) {
     return SimdVecI32(_mm256_madd_epi16(a.m_v, b.m_v));
 }
 
+inline SimdVecI32 SimdVecI16::madd_add(SimdVecI32 sum, SimdVecI16 a, SimdVecI16 b) {
+    return sum + madd(a, b);
+}
+
 #else
 
 inline SimdVecI16 SimdVecI16::zero() {
@@ -351,6 +369,10 @@ inline SimdVecI32 SimdVecI16::madd(SimdVecI16 a, SimdVecI16 b) {
     return SimdVecI32(i32(a.m_v) * i32(b.m_v));
 }
 
+inline SimdVecI32 SimdVecI16::madd_add(SimdVecI32 sum, SimdVecI16 a, SimdVecI16 b) {
+    return sum + madd(a, b);
+}
+
 inline SimdVecI32 SimdVecI32::zero() {
     return SimdVecI32(0);
 }
@@ -0,0 +1,108 @@
+#include "tablebase.h"
+
+#include <algorithm>
+
+#include <tbprobe.h>
+
+namespace illumina {
+
+int syzygy_init(const std::string& path) {
+    if (path.empty() || path == "<empty>") {
+        tb_free();
+        return 0;
+    }
+    if (!tb_init(path.c_str())) {
+        return 0;
+    }
+    return int(TB_LARGEST);
+}
+
+int syzygy_max_pieces() {
+    return int(TB_LARGEST);
+}
+
+TBResult syzygy_probe_wdl(const Board& board) {
+    if (board.rule50() != 0 || board.castling_rights() != CR_NONE) {
+        return TBR_FAILED;
+    }
+
+    unsigned result = tb_probe_wdl(board.color_bb(CL_WHITE),
+                                   board.color_bb(CL_BLACK),
+                                   board.piece_type_bb(PT_KING),
+                                   board.piece_type_bb(PT_QUEEN),
+                                   board.piece_type_bb(PT_ROOK),
+                                   board.piece_type_bb(PT_BISHOP),
+                                   board.piece_type_bb(PT_KNIGHT),
+                                   board.piece_type_bb(PT_PAWN),
+                                   0,
+                                   0,
+                                   board.ep_square() == SQ_NULL ? 0 : board.ep_square(),
+                                   board.color_to_move() == CL_WHITE);
+
+    return result == TB_RESULT_FAILED ? TBR_FAILED : TBResult(result);
+}
+
+static PieceType promotion_piece_type(unsigned tb_promotes) {
+    switch (tb_promotes) {
+        case TB_PROMOTES_QUEEN:  return PT_QUEEN;
+        case TB_PROMOTES_ROOK:   return PT_ROOK;
+        case TB_PROMOTES_BISHOP: return PT_BISHOP;
+        case TB_PROMOTES_KNIGHT: return PT_KNIGHT;
+        default:                 return PT_NULL;
+    }
+}
+
+TBResult syzygy_filter_root_moves(const Board& board, std::vector<Move>& moves) {
+    if (moves.empty() || board.castling_rights() != CR_NONE) {
+        return TBR_FAILED;
+    }
+
+    unsigned tb_results[TB_MAX_MOVES];
+    unsigned root_result = tb_probe_root(board.color_bb(CL_WHITE),
+                                         board.color_bb(CL_BLACK),
+                                         board.piece_type_bb(PT_KING),
+                                         board.piece_type_bb(PT_QUEEN),
+                                         board.piece_type_bb(PT_ROOK),
+                                         board.piece_type_bb(PT_BISHOP),
+                                         board.piece_type_bb(PT_KNIGHT),
+                                         board.piece_type_bb(PT_PAWN),
+                                         board.rule50(),
+                                         0,
+                                         board.ep_square() == SQ_NULL ? 0 : board.ep_square(),
+                                         board.color_to_move() == CL_WHITE,
+                                         tb_results);
+    if (   root_result == TB_RESULT_FAILED
+        || root_result == TB_RESULT_CHECKMATE
+        || root_result == TB_RESULT_STALEMATE) {
+        return TBR_FAILED;
+    }
+
+    // Find the outcome of each of our moves.
+    std::vector<TBResult> move_results;
+    for (Move move: moves) {
+        PieceType promotion = move.is_promotion() ? move.promotion_piece_type() : PieceType(PT_NULL);
+        unsigned* it = std::find_if(tb_results, tb_results + TB_MAX_MOVES, [&](unsigned tb_result) {
+            return tb_result == TB_RESULT_FAILED
+                || (   TB_GET_FROM(tb_result) == unsigned(move.source())
+                    && TB_GET_TO(tb_result) == unsigned(move.destination())
+                    && promotion_piece_type(TB_GET_PROMOTES(tb_result)) == promotion);
+        });
+        if (it == tb_results + TB_MAX_MOVES || *it == TB_RESULT_FAILED) {
+            return TBR_FAILED;
+        }
+        move_results.push_back(TBResult(TB_GET_WDL(*it)));
+    }
+
+    TBResult best_result = *std::max_element(move_results.begin(), move_results.end());
+    size_t n_kept = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (move_results[i] == best_result) {
+            moves[n_kept++] = moves[i];
+        }
+    }
+    moves.resize(n_kept);
+
+    return best_result;
+}
+
+} // illumina
@@ -0,0 +1,59 @@
+#ifndef ILLUMINA_TABLEBASE_H
+#define ILLUMINA_TABLEBASE_H
+
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "types.h"
+
+namespace illumina {
+
+/**
+ * Outcome of a position according to Syzygy tablebases, from the
+ * perspective of the side to move. Cursed wins and blessed losses are
+ * wins and losses that the 50 move rule turns into draws.
+ */
+enum TBResult : ui8 {
+    TBR_LOSS,
+    TBR_BLESSED_LOSS,
+    TBR_DRAW,
+    TBR_CURSED_WIN,
+    TBR_WIN,
+    TBR_FAILED
+};
+
+/**
+ * Loads the tablebases found in the given directories, separated by ':'
+ * (';' on Windows), replacing any previously loaded ones. An empty path
+ * or "<empty>" unloads them. Must not be called while searching, probes
+ * being safe to run concurrently otherwise.
+ * Returns the largest number of pieces of the loaded tables, 0 if no
+ * table files were found.
+ */
+int syzygy_init(const std::string& path);
+
+/**
+ * Largest number of pieces of the loaded tables. 0 if none are loaded.
+ */
+int syzygy_max_pieces();
+
+/**
+ * Probes the WDL tables. Only positions without castling rights whose
+ * 50 move counter was just reset can be probed. Returns TBR_FAILED for
+ * any other position, or if the position isn't in the loaded tables.
+ */
+TBResult syzygy_probe_wdl(const Board& board);
+
+/**
+ * Probes the DTZ tables at the root, keeping only the given moves that
+ * preserve the best outcome among them. Outcomes take the 50 move rule
+ * into account, so winning moves left are the ones making progress.
+ * Returns the best outcome, or TBR_FAILED if the root couldn't be
+ * probed, in which case moves are left untouched.
+ */
+TBResult syzygy_filter_root_moves(const Board& board, std::vector<Move>& moves);
+
+} // illumina
+
+#endif // ILLUMINA_TABLEBASE_H
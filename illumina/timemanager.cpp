@@ -1,5 +1,7 @@
 #include "timemanager.h"
 
+#include <algorithm>
+
 namespace illumina {
 
 void TimeManager::setup(bool tourney_time) {
@@ -21,11 +23,12 @@ void TimeManager::set_starting_bounds(ui64 soft, ui64 hard) {
     m_hard_bound = hard;
     m_orig_soft_bound = soft;
     m_orig_hard_bound = hard;
+    m_node_scale = 1.0;
 }
 
 void TimeManager::start_movetime(ui64 movetime_ms) {
     setup(false);
-    ui64 bound = movetime_ms - std::min(movetime_ms, ui64(LAG_MARGIN));
+    ui64 bound = movetime_ms - std::min(movetime_ms, m_move_overhead);
     set_starting_bounds(bound, bound);
 }
 
@@ -34,28 +37,57 @@ void TimeManager::start_tourney_time(ui64 our_time_ms,
                                      ui64 their_time_ms,
                                      ui64 their_inc_ms,
                                      int moves_to_go) {
-    ui64 max_time = our_time_ms - std::min(our_time_ms, ui64(LAG_MARGIN));
-    our_time_ms  += our_inc_ms * 45 - LAG_MARGIN;
     setup(true);
 
-    if (moves_to_go != 1) {
-        set_starting_bounds(std::min(max_time, ui64(double(our_time_ms) * 0.083)),
-                            std::min(max_time, ui64(double(our_time_ms) * 0.333)));
-    }
-    else {
+    // We can never think for longer than what's left on our clock.
+    ui64 max_time = our_time_ms - std::min(our_time_ms, m_move_overhead);
+    if (moves_to_go == 1) {
         set_starting_bounds(max_time, max_time);
+        return;
     }
+
+    // Estimate how much time we'll have for the next few moves, counting
+    // the increments we'll receive and the lag we'll lose meanwhile.
+    // When the next time control is close, our clock will be refilled
+    // soon, so only look that far ahead.
+    ui64 horizon = moves_to_go > 0
+                   ? std::min(ui64(moves_to_go), ui64(TM_INC_HORIZON))
+                   : ui64(TM_INC_HORIZON);
+    double future_gain = double(our_inc_ms) * double(horizon - 1);
+    double future_lag  = double(m_move_overhead) * double(horizon - 1);
+    double available   = std::max(0.0, double(max_time) + future_gain - future_lag);
+
+    // Spread the available time over the moves we have to play.
+    double divisor = moves_to_go > 0
+                     ? double(std::min(moves_to_go, int(TM_SOFT_DIVISOR)))
+                     : double(TM_SOFT_DIVISOR);
+    double soft = available / divisor;
+    double hard = std::min(available, soft * TM_HARD_SOFT_RATIO);
+
+    // Compare before converting, max_time can be as large as UINT64_MAX
+    // when our clock is unknown.
+    auto clamp_bound = [max_time](double bound) {
+        return bound >= double(max_time) ? max_time : ui64(bound);
+    };
+    set_starting_bounds(clamp_bound(soft), clamp_bound(hard));
 }
 
 void TimeManager::on_new_pv(Depth depth,
                             Move best_move,
-                            Score score) {
+                            Score score,
+                            double best_move_node_fraction) {
     // If not on tourney time, new pvs shouldn't affect
     // our thinking time.
     if (!m_tourney_time) {
         return;
     }
 
+    // Scale the soft bound by how much of our effort went into the
+    // best move. Shallow iterations are too noisy for this.
+    if (depth >= TM_NODE_FRACTION_MIN_DEPTH) {
+        m_node_scale = (TM_NODE_FRACTION_BASE - best_move_node_fraction) * TM_NODE_FRACTION_MULT;
+    }
+
     // If we think that our next search won't be finished
     // before the next depth ends, interrupt the search.
     if (depth >= TM_CUTOFF_MIN_DEPTH
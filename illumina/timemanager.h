@@ -1,6 +1,7 @@
 #ifndef ILLUMINA_TIMEMANAGER_H
 #define ILLUMINA_TIMEMANAGER_H
 
+#include <algorithm>
 #include <atomic>
 
 #include "clock.h"
@@ -10,11 +11,24 @@
 
 namespace illumina {
 
+/**
+ * Default time, in milliseconds, that we expect to lose on every move
+ * between the GUI sending 'go' and receiving our 'bestmove'.
+ */
 static constexpr int LAG_MARGIN = 10;
 
 class TimeManager {
 public:
     void start_movetime(ui64 movetime_ms);
+
+    /**
+     * Starts the clock for a move under a regular time control. The
+     * starting bounds consider the time we'll gain from increments and
+     * how many moves we still have to play until the next time control
+     * (or until the game is over, for sudden death time controls, in
+     * which case moves_to_go is 0). Every move is assumed to lose
+     * move_overhead() milliseconds to communication lag.
+     */
     void start_tourney_time(ui64 our_time_ms,
                             ui64 our_inc_ms,
                             ui64 their_time_ms,
@@ -22,13 +36,30 @@ public:
                             int moves_to_go = 0);
     ui64 hard_bound() const;
     ui64 soft_bound() const;
+
+    /**
+     * Point in time at which the hard bound is reached.
+     */
+    TimePoint hard_deadline() const;
     bool finished_soft() const;
     bool finished_hard() const;
     ui64 elapsed() const;
     bool running() const;
     void stop();
 
-    void on_new_pv(Depth depth, Move best_move, Score score);
+    ui64 move_overhead() const;
+    void set_move_overhead(ui64 overhead_ms);
+
+    /**
+     * Adjusts our thinking time after an iteration finished. The node
+     * fraction is the share of root nodes spent on the best move's
+     * subtree: the more effort went into refuting its alternatives,
+     * the less time we spend on this move.
+     */
+    void on_new_pv(Depth depth,
+                   Move best_move,
+                   Score score,
+                   double best_move_node_fraction);
 
     TimeManager();
 
@@ -38,7 +69,9 @@ private:
     ui64 m_orig_hard_bound = 0;
     ui64 m_soft_bound = 0;
     ui64 m_hard_bound = 0;
+    double m_node_scale = 1.0;
     ui64 m_elapsed = 0;
+    ui64 m_move_overhead = LAG_MARGIN;
     bool m_running = false;
     bool m_tourney_time = false;
 
@@ -58,16 +91,30 @@ inline ui64 TimeManager::elapsed() const {
     return m_running ? delta_ms(now(), m_time_start) : m_elapsed;
 }
 
+inline ui64 TimeManager::move_overhead() const {
+    return m_move_overhead;
+}
+
+inline void TimeManager::set_move_overhead(ui64 overhead_ms) {
+    m_move_overhead = overhead_ms;
+}
+
 inline ui64 TimeManager::soft_bound() const {
-    return m_soft_bound;
+    return std::min(m_hard_bound, ui64(double(m_soft_bound) * m_node_scale));
 }
 
 inline ui64 TimeManager::hard_bound() const {
     return m_hard_bound;
 }
 
+inline TimePoint TimeManager::hard_deadline() const {
+    // Keep unlimited bounds from overflowing the clock.
+    constexpr ui64 MAX_DEADLINE_MS = ui64(365) * 24 * 60 * 60 * 1000;
+    return m_time_start + std::chrono::milliseconds(std::min(m_hard_bound, MAX_DEADLINE_MS));
+}
+
 inline bool TimeManager::finished_soft() const {
-    return m_running && ui64(delta_ms(now(), m_time_start)) >= m_soft_bound;
+    return m_running && ui64(delta_ms(now(), m_time_start)) >= soft_bound();
 }
 
 inline bool TimeManager::finished_hard() const {
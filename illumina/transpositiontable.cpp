@@ -1,30 +1,111 @@
 #include "transpositiontable.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "numa.h"
 
 namespace illumina {
 
+/**
+ * How many plies of depth an entry is considered to lose for each
+ * search it survives without being refreshed.
+ */
+static constexpr int TT_REPLACEMENT_AGE_WEIGHT = 8;
+
+/**
+ * Minimum number of clusters cleared by each thread when clearing
+ * the table in parallel (1 MiB worth of clusters).
+ */
+static constexpr size_t TT_MIN_CLEAR_CLUSTERS_PER_THREAD = 1024 * 1024 / sizeof(TranspositionTableCluster);
+
+/**
+ * Header of transposition table files. The cluster data starts right
+ * after it, at TT_FILE_DATA_OFFSET, which keeps clusters aligned when
+ * the file is mapped.
+ */
+struct TranspositionTableFileHeader {
+    char magic[8];
+    ui32 format_version;
+    ui32 entry_size;
+    ui32 cluster_size;
+    ui32 cluster_align;
+    ui64 cluster_count;
+    ui64 size_in_bytes;
+    ui8  generation;
+
+    /**
+     * A reference entry, encoded with the current entry layout. Since
+     * it changes whenever the encoding does, it lets us reject files
+     * written by builds with a different layout.
+     */
+    TranspositionTableEntry layout_sample;
+};
+
+static constexpr char   TT_FILE_MAGIC[8]       = { 'I', 'L', 'L', 'U', 'M', 'T', 'T', '\0' };
+static constexpr ui32   TT_FILE_FORMAT_VERSION = 2;
+static constexpr size_t TT_FILE_DATA_OFFSET    = 4096;
+
+static_assert(sizeof(TranspositionTableFileHeader) <= TT_FILE_DATA_OFFSET);
+static_assert(TT_FILE_DATA_OFFSET % TT_CLUSTER_ALIGN == 0);
+
 static Score search_score_to_tt(Score search_score, Depth ply) {
-    if (search_score >= MATE_THRESHOLD) {
+    if (search_score >= TB_WIN_THRESHOLD) {
         return search_score + ply;
     }
-    if (search_score <= -MATE_THRESHOLD) {
+    if (search_score <= -TB_WIN_THRESHOLD) {
         return search_score - ply;
     }
     return search_score;
 }
 
 static Score tt_score_to_search(Score tt_score, Depth ply) {
-    if (tt_score >= MATE_THRESHOLD) {
+    if (tt_score >= TB_WIN_THRESHOLD) {
         return tt_score - ply;
     }
-    if (tt_score <= -MATE_THRESHOLD) {
+    if (tt_score <= -TB_WIN_THRESHOLD) {
         return tt_score + ply;
     }
     return tt_score;
 }
 
+ui16 compact_move(Move move) {
+    if (move == MOVE_NULL) {
+        return 0;
+    }
+
+    // Castling moves are encoded as 'king takes rook', which
+    // can be told apart from any other king move.
+    Square dst = move.type() == MT_CASTLES
+                 ? move.castles_rook_src_square()
+                 : move.destination();
+
+    return ui16(move.source())
+         | ui16(dst << 6)
+         | ui16(move.promotion_piece_type() << 12);
+}
+
+Move expand_compact_move(const Board& board, ui16 compact) {
+    if (compact == 0) {
+        return MOVE_NULL;
+    }
+
+    Square    src       = compact & BITMASK(6);
+    Square    dst       = (compact >> 6) & BITMASK(6);
+    PieceType prom_type = (compact >> 12) & BITMASK(3);
+    return Move(board, src, dst, prom_type);
+}
+
+Move TranspositionTableEntry::move(const Board& board) const {
+    return expand_compact_move(board, m_move);
+}
+
 void TranspositionTableEntry::replace(ui64 key,
                                       Move move,
                                       Score score,
@@ -33,33 +114,74 @@ void TranspositionTableEntry::replace(ui64 key,
                                       BoundType bound_type,
                                       ui8 generation,
                                       bool ttpv) {
-    m_key_hi  = key >> 32;
-    m_move  = move;
-    m_score = score;
-    m_static_eval = static_eval;
+    TranspositionTableEntry entry;
+    entry.m_move        = compact_move(move);
+    entry.m_score       = i16(score);
+    entry.m_static_eval = static_eval;
+    entry.m_depth       = ui8(std::clamp(depth, Depth(0), Depth(UINT8_MAX - 1)) + 1);
+    entry.m_gen_bound   = ui8(  (ttpv & BITMASK(1))
+                              | ((bound_type & BITMASK(2)) << 1)
+                              | ((generation & TT_GENERATION_MASK) << 3));
+    entry.m_key_check   = ui16(key) ^ entry.key_check();
+
+    // Write the whole entry at once.
+    *this = entry;
+}
+
+void TranspositionTableEntry::set_score(Score score) {
+    ui16 key    = key16();
+    m_score     = i16(score);
+    m_key_check = key ^ key_check();
+}
 
-    m_info = 1; // Start with 1 for 'valid' bit.
-    m_info |= (bound_type & BITMASK(2)) << 1;
-    m_info |= (generation & BITMASK(8)) << 3;
-    m_info |= (depth      & BITMASK(8)) << 11;
-    m_info |= (ttpv       & BITMASK(1)) << 19;
+TranspositionTableStats& TranspositionTableStats::operator+=(const TranspositionTableStats& rhs) {
+    probes                  += rhs.probes;
+    hits                    += rhs.hits;
+    key_collisions          += rhs.key_collisions;
+    stores                  += rhs.stores;
+    stored_in_empty         += rhs.stored_in_empty;
+    replaced_other_position += rhs.replaced_other_position;
+    replaced_missing_move   += rhs.replaced_missing_move;
+    replaced_older_search   += rhs.replaced_older_search;
+    replaced_deeper         += rhs.replaced_deeper;
+    replaced_better_bound   += rhs.replaced_better_bound;
+    kept_entry_with_move    += rhs.kept_entry_with_move;
+    kept_existing           += rhs.kept_existing;
+    return *this;
 }
 
 void TranspositionTable::new_search() {
-    m_gen++;
+    m_gen = (m_gen + 1) & TT_GENERATION_MASK;
 }
 
-bool TranspositionTable::probe(ui64 key, TranspositionTableEntry& entry, Depth ply) {
-    entry = entry_ref(key);
-    if (entry.key_hi() != (key >> 32)) {
-        return false;
-    }
-    if (!entry.valid()) {
-        return false;
+bool TranspositionTable::probe(ui64 key, TranspositionTableEntry& entry, Depth ply,
+                               TranspositionTableStats* stats) {
+    const TranspositionTableCluster& cluster = cluster_ref(key);
+    ui16 key16 = ui16(key);
+    TT_STATS_INC(stats, probes);
+
+    for (const TranspositionTableEntry& shared_entry: cluster.entries) {
+        // Validate a local copy, since other threads might
+        // overwrite the entry while we're reading it.
+        TranspositionTableEntry candidate = shared_entry;
+        if (!candidate.valid() || candidate.key16() != key16) {
+            continue;
+        }
+
+        // We've got a valid entry, fix its score.
+        TT_STATS_INC(stats, hits);
+        entry = candidate;
+        entry.set_score(tt_score_to_search(entry.score(), ply));
+        return true;
     }
-    // We've got a valid entry, fix its score.
-    entry.m_score = tt_score_to_search(entry.score(), ply);
-    return true;
+    return false;
+}
+
+int TranspositionTable::replacement_value(const TranspositionTableEntry& entry) const {
+    // Deeper entries are worth more, but entries from older searches
+    // lose value the older they get.
+    ui8 age = (m_gen - entry.generation()) & TT_GENERATION_MASK;
+    return entry.depth() - TT_REPLACEMENT_AGE_WEIGHT * age;
 }
 
 void TranspositionTable::try_store(ui64 key,
@@ -69,34 +191,67 @@ void TranspositionTable::try_store(ui64 key,
                                    Depth depth,
                                    Score static_eval,
                                    BoundType bound_type,
-                                   bool ttpv) {
-    TranspositionTableEntry& entry = entry_ref(key);
+                                   bool ttpv,
+                                   TranspositionTableStats* stats) {
+    TranspositionTableCluster& cluster = cluster_ref(key);
+    ui16 key16 = ui16(key);
+    TT_STATS_INC(stats, stores);
+
+    // Look for an entry of this same position in the cluster. While doing
+    // so, keep track of the least valuable entry, which is the one to be
+    // replaced if our position is not in the cluster yet.
+    TranspositionTableEntry* replaced = &cluster.entries[0];
+    for (TranspositionTableEntry& entry: cluster.entries) {
+        // Entries are filled in order. An empty one means our position
+        // is not in the cluster, so take it.
+        if (!entry.valid()) {
+            TT_STATS_INC(stats, stored_in_empty);
+            entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
+            return;
+        }
+
+        if (entry.key16() == key16) {
+            replaced = &entry;
+            break;
+        }
+
+        if (replacement_value(entry) < replacement_value(*replaced)) {
+            replaced = &entry;
+        }
+    }
 
-    // Always add when no existing entry is found.
-    if (!entry.valid()) {
+    TranspositionTableEntry& entry = *replaced;
+
+    // Always replace entries of other positions.
+    if (entry.key16() != key16) {
+        TT_STATS_INC(stats, replaced_other_position);
         entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
         return;
     }
 
     // Always replace when current entry has no stored move.
-    if (entry.move() == MOVE_NULL && move != MOVE_NULL) {
+    if (!entry.has_move() && move != MOVE_NULL) {
+        TT_STATS_INC(stats, replaced_missing_move);
         entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
         return;
     }
 
     // Never replace a tt entry with a move for another without a move.
-    if (entry.move() != MOVE_NULL && move == MOVE_NULL) {
+    if (entry.has_move() && move == MOVE_NULL) {
+        TT_STATS_INC(stats, kept_entry_with_move);
         return;
     }
 
     // Always replace older generations.
     if (entry.generation() != m_gen) {
+        TT_STATS_INC(stats, replaced_older_search);
         entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
         return;
     }
 
     // Always replace when we get a higher depth (with a move assigned).
     if (depth > entry.depth()) {
+        TT_STATS_INC(stats, replaced_deeper);
         entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
         return;
     }
@@ -105,49 +260,254 @@ void TranspositionTable::try_store(ui64 key,
     if (depth == entry.depth()
         && ((bound_type == BT_EXACT      && entry.bound_type() != BT_EXACT)
         ||  (bound_type != BT_UPPERBOUND && entry.bound_type() == BT_UPPERBOUND))) {
+        TT_STATS_INC(stats, replaced_better_bound);
         entry.replace(key, move, search_score_to_tt(score, ply), depth, static_eval, bound_type, m_gen, ttpv);
         return;
     }
+
+    TT_STATS_INC(stats, kept_existing);
 }
 
-void TranspositionTable::clear() {
-    std::memset(m_buf.get(), 0, m_max_entry_count * sizeof(TranspositionTableEntry));
+void TranspositionTable::clear(size_t n_threads) {
+    size_t n_nodes = numa_node_count();
+    bool numa_interleave = m_numa_interleave && n_nodes > 1;
+    if (numa_interleave) {
+        // Every node must get at least one thread.
+        n_threads = std::max(n_threads, n_nodes);
+    }
+
+    // Don't bother creating threads for slices that are too small.
+    size_t max_threads = std::max(size_t(1), m_cluster_count / TT_MIN_CLEAR_CLUSTERS_PER_THREAD);
+    n_threads = std::clamp(n_threads, size_t(1), max_threads);
+
+    size_t slice_size = m_cluster_count / n_threads;
+    auto clear_slice = [this, slice_size, n_threads](size_t slice_idx) {
+        size_t begin = slice_idx * slice_size;
+        size_t end   = slice_idx == n_threads - 1 ? m_cluster_count : begin + slice_size;
+        std::memset(m_buf + begin, 0, (end - begin) * sizeof(TranspositionTableCluster));
+    };
+
+    // Thread i clears stripes i, i + n_threads, i + 2 * n_threads...
+    constexpr size_t STRIPE_CLUSTERS = HUGE_PAGE_SIZE / sizeof(TranspositionTableCluster);
+    auto clear_stripes = [this, n_threads](size_t thread_idx) {
+        bind_thread_to_numa_node(numa_node_for_thread(thread_idx));
+        for (size_t begin = thread_idx * STRIPE_CLUSTERS; begin < m_cluster_count; begin += n_threads * STRIPE_CLUSTERS) {
+            size_t end = std::min(begin + STRIPE_CLUSTERS, m_cluster_count);
+            std::memset(m_buf + begin, 0, (end - begin) * sizeof(TranspositionTableCluster));
+        }
+    };
+
+    if (numa_interleave) {
+        // Binding a thread to a node is permanent, so leave the calling
+        // thread alone and clear every stripe from helper threads.
+        std::vector<std::thread> helpers;
+        helpers.reserve(n_threads);
+        for (size_t i = 0; i < n_threads; ++i) {
+            helpers.emplace_back(clear_stripes, i);
+        }
+        for (std::thread& helper: helpers) {
+            helper.join();
+        }
+        return;
+    }
+
+    // The calling thread clears the first slice, helpers clear the rest.
+    std::vector<std::thread> helpers;
+    helpers.reserve(n_threads - 1);
+    for (size_t i = 1; i < n_threads; ++i) {
+        helpers.emplace_back(clear_slice, i);
+    }
+    clear_slice(0);
+
+    for (std::thread& helper: helpers) {
+        helper.join();
+    }
 }
 
-inline TranspositionTableEntry& TranspositionTable::entry_ref(ui64 key) {
-    return m_buf[key % m_max_entry_count];
+inline TranspositionTableCluster& TranspositionTable::cluster_ref(ui64 key) {
+    return m_buf[cluster_index(key)];
 }
 
-void TranspositionTable::resize(size_t new_size) {
+bool TranspositionTable::reallocate(size_t new_size, bool large_pages) {
     try {
-        if (new_size == m_size_in_bytes && m_buf != nullptr) {
-            return;
-        }
+        size_t new_n_clusters = std::max(size_t(1), new_size / sizeof(TranspositionTableCluster));
+
+        // Allocate the new region before releasing the current one, so
+        // that we keep a working table if we run out of memory.
+        MemoryRegion new_mem;
+        new_mem.allocate(new_n_clusters * sizeof(TranspositionTableCluster), large_pages);
 
-        size_t new_n_entries = new_size / sizeof(TranspositionTableEntry);
-        auto new_buf         = std::make_unique<TranspositionTableEntry[]>(new_n_entries);
-        m_buf                = std::move(new_buf);
-        m_max_entry_count    = new_n_entries;
+        m_mem           = std::move(new_mem);
+        m_buf           = static_cast<TranspositionTableCluster*>(m_mem.data());
+        m_cluster_count = new_n_clusters;
+        m_size_in_bytes = new_size;
+        m_large_pages   = large_pages;
+        return true;
     }
     catch (const std::bad_alloc& bad_alloc) {
         std::cerr << "Failed to resize transposition table, not enough memory." << std::endl;
+        return false;
+    }
+}
+
+bool TranspositionTable::resize(size_t new_size) {
+    if (new_size == m_size_in_bytes && m_buf != nullptr) {
+        return false;
+    }
+    return reallocate(new_size, m_large_pages);
+}
+
+bool TranspositionTable::set_large_pages(bool large_pages) {
+    if (large_pages == m_large_pages && m_buf != nullptr) {
+        return false;
+    }
+    return reallocate(m_size_in_bytes, large_pages);
+}
+
+bool TranspositionTable::set_numa_interleave(bool numa_interleave) {
+    if (numa_interleave == m_numa_interleave) {
+        return false;
+    }
+    m_numa_interleave = numa_interleave;
+
+    // Pages are placed when first touched, so the table needs
+    // fresh pages for the new placement to take effect.
+    if (numa_node_count() <= 1) {
+        return false;
     }
+    return reallocate(m_size_in_bytes, m_large_pages);
 }
 
 int TranspositionTable::hash_full() const {
-    constexpr size_t SAMPLE_SIZE = 1000;
+    // Sample clusters evenly spaced over the table, and only count
+    // entries from the current search. Old entries are bound to be
+    // replaced, so counting them would report a full table for the
+    // rest of the game.
+    constexpr size_t SAMPLE_SIZE = 1000 / TT_CLUSTER_SIZE;
+    size_t sample_size = std::min(SAMPLE_SIZE, m_cluster_count);
     int filled = 0;
-    for (size_t i = 0; i < SAMPLE_SIZE; ++i) {
-        TranspositionTableEntry& entry = m_buf[i];
-        if (entry.valid()) {
-            filled += 1000;
+    for (size_t i = 0; i < sample_size; ++i) {
+        const TranspositionTableCluster& cluster = m_buf[i * m_cluster_count / sample_size];
+        for (const TranspositionTableEntry& entry: cluster.entries) {
+            if (entry.valid() && entry.generation() == m_gen) {
+                filled += 1000;
+            }
+        }
+    }
+    return filled / int(sample_size * TT_CLUSTER_SIZE);
+}
+
+TranspositionTableOccupancy TranspositionTable::occupancy() const {
+    TranspositionTableOccupancy occupancy;
+    for (size_t i = 0; i < m_cluster_count; ++i) {
+        for (const TranspositionTableEntry& entry: m_buf[i].entries) {
+            occupancy.n_entries++;
+            if (!entry.valid()) {
+                occupancy.n_empty++;
+                continue;
+            }
+            ui8 age = (m_gen - entry.generation()) & TT_GENERATION_MASK;
+            occupancy.by_age[std::min(size_t(age), TT_AGE_BUCKETS - 1)]++;
         }
     }
-    return filled / SAMPLE_SIZE;
+    return occupancy;
+}
+
+TranspositionTableEntry TranspositionTable::layout_sample() {
+    TranspositionTableEntry entry {};
+    entry.replace(0x0123456789ABCDEF, Move(0x89ABCDEF), -12345, 123, 4321, BT_LOWERBOUND, 77, true);
+    return entry;
+}
+
+static bool same_entry_bits(const TranspositionTableEntry& a, const TranspositionTableEntry& b) {
+    return std::memcmp(&a, &b, sizeof(TranspositionTableEntry)) == 0;
+}
+
+bool TranspositionTable::save(const std::string& path) const {
+    TranspositionTableFileHeader header {};
+    std::memcpy(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC));
+    header.format_version = TT_FILE_FORMAT_VERSION;
+    header.entry_size     = sizeof(TranspositionTableEntry);
+    header.cluster_size   = TT_CLUSTER_SIZE;
+    header.cluster_align  = TT_CLUSTER_ALIGN;
+    header.cluster_count  = m_cluster_count;
+    header.size_in_bytes  = m_size_in_bytes;
+    header.generation     = m_gen;
+    header.layout_sample  = layout_sample();
+
+    std::vector<char> header_block(TT_FILE_DATA_OFFSET, 0);
+    std::memcpy(header_block.data(), &header, sizeof(header));
+
+    // Write to a temporary file first. The file we're replacing might be
+    // the one currently mapped as our table, and truncating a mapped file
+    // would invalidate the pages that haven't been read yet.
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        file.write(header_block.data(), std::streamsize(header_block.size()));
+        file.write(reinterpret_cast<const char*>(m_buf),
+                   std::streamsize(m_cluster_count * sizeof(TranspositionTableCluster)));
+        if (!file.good()) {
+            std::cerr << "Failed to write transposition table to " << tmp_path << "." << std::endl;
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to move transposition table file to " << path << "." << std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TranspositionTable::load(const std::string& path) {
+    MemoryRegion new_mem;
+    if (!new_mem.map_file(path)) {
+        std::cerr << "Failed to open transposition table file " << path << "." << std::endl;
+        return false;
+    }
+
+    if (new_mem.size() < TT_FILE_DATA_OFFSET) {
+        std::cerr << "Transposition table file " << path << " is truncated." << std::endl;
+        return false;
+    }
+
+    TranspositionTableFileHeader header;
+    std::memcpy(&header, new_mem.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC)) != 0) {
+        std::cerr << path << " is not a transposition table file." << std::endl;
+        return false;
+    }
+
+    if (   header.format_version != TT_FILE_FORMAT_VERSION
+        || header.entry_size     != sizeof(TranspositionTableEntry)
+        || header.cluster_size   != TT_CLUSTER_SIZE
+        || header.cluster_align  != TT_CLUSTER_ALIGN
+        || !same_entry_bits(header.layout_sample, layout_sample())) {
+        std::cerr << "Transposition table file " << path
+                  << " was written with an incompatible entry layout." << std::endl;
+        return false;
+    }
+
+    if (   header.cluster_count == 0
+        || new_mem.size() != TT_FILE_DATA_OFFSET + header.cluster_count * sizeof(TranspositionTableCluster)) {
+        std::cerr << "Transposition table file " << path << " has an unexpected size." << std::endl;
+        return false;
+    }
+
+    m_mem           = std::move(new_mem);
+    m_buf           = reinterpret_cast<TranspositionTableCluster*>(static_cast<char*>(m_mem.data()) + TT_FILE_DATA_OFFSET);
+    m_cluster_count = header.cluster_count;
+    m_size_in_bytes = header.size_in_bytes;
+    m_gen           = header.generation & TT_GENERATION_MASK;
+    return true;
 }
 
 TranspositionTable::TranspositionTable(size_t size)
-    : m_size_in_bytes(size), m_max_entry_count(size / sizeof(TranspositionTableEntry)) {
+    : m_size_in_bytes(0), m_cluster_count(0) {
     resize(size);
     clear();
 }
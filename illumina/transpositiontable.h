@@ -1,16 +1,35 @@
 #ifndef ILLUMINA_TRANSPOSITIONTABLE_H
 #define ILLUMINA_TRANSPOSITIONTABLE_H
 
+#include <array>
 #include <memory>
+#include <string>
 
+#include "memoryregion.h"
 #include "searchdefs.h"
 
 namespace illumina {
 
+class Board;
+
+/**
+ * Packs a move into 16 bits: source square, destination square and
+ * promotion piece type. Castling moves store the rook square as their
+ * destination. The remaining move information is recovered from the
+ * board the move is played on.
+ */
+ui16 compact_move(Move move);
+Move expand_compact_move(const Board& board, ui16 compact);
+
 class TranspositionTableEntry {
     friend class TranspositionTable;
 public:
-    Move      move() const;
+    /**
+     * The stored move, decoded against the board of the probed
+     * position. Only meaningful for that board.
+     */
+    Move      move(const Board& board) const;
+    bool      has_move() const;
     BoundType bound_type() const;
     bool      valid() const;
     ui8       generation() const;
@@ -18,22 +37,30 @@ public:
     Depth     depth() const;
     Score     static_eval() const;
     bool      ttpv() const;
-    ui32      key_hi() const;
+    ui16      key16() const;
 
 private:
-    ui32 m_key_hi;
-    Move m_move;
+    // Entries are written and read by several search threads without any
+    // locking, so a reader might see a mix of two concurrent writes. To
+    // detect that, the key is XOR-ed with the rest of the entry before
+    // being stored. An entry torn between two writes fails the key check
+    // (unless the 16 bit check collides, in which case the searcher still
+    // validates the move before using it).
+    ui16 m_key_check;
+    ui16 m_move;
+    i16  m_score;
+    i16  m_static_eval;
+
+    // Depth + 1, so that empty entries have zero depth.
+    ui8  m_depth;
 
-    // m_info  encoding:
-    //  0:     valid
-    //  1-2:   bound_type
-    //  3-10:  generation
-    //  11-18: depth
-    //  19:    ttpv
-    ui32 m_info;
+    // m_gen_bound encoding:
+    //  0:   ttpv
+    //  1-2: bound_type
+    //  3-7: generation
+    ui8  m_gen_bound;
 
-    i16 m_score;
-    i16 m_static_eval;
+    ui16 key_check() const;
 
     void replace(ui64 key, Move move,
                  Score score, Depth depth,
@@ -41,17 +68,116 @@ private:
                  BoundType bound_type,
                  ui8 generation,
                  bool ttpv);
+
+    void set_score(Score score);
 };
 
+static_assert(sizeof(TranspositionTableEntry) == 10);
+
+/**
+ * Counters of transposition table activity. Only updated in builds with
+ * TT_STATS defined. Each search worker keeps its own counters, which are
+ * summed when reported.
+ */
+struct TranspositionTableStats {
+    ui64 probes = 0;
+    ui64 hits   = 0;
+
+    /** Hits whose move couldn't be played, i.e. different positions sharing a key. */
+    ui64 key_collisions = 0;
+
+    // Outcomes of try_store, one counter per replacement policy branch.
+    ui64 stores                   = 0;
+    ui64 stored_in_empty          = 0;
+    ui64 replaced_other_position  = 0;
+    ui64 replaced_missing_move    = 0;
+    ui64 replaced_older_search    = 0;
+    ui64 replaced_deeper          = 0;
+    ui64 replaced_better_bound    = 0;
+    ui64 kept_entry_with_move     = 0;
+    ui64 kept_existing            = 0;
+
+    TranspositionTableStats& operator+=(const TranspositionTableStats& rhs);
+};
+
+#ifdef TT_STATS
+#define TT_STATS_INC(stats, counter) \
+    if ((stats) != nullptr) {        \
+        (stats)->counter++;          \
+    }
+#else
+#define TT_STATS_INC(stats, counter)
+#endif
+
+constexpr size_t TT_AGE_BUCKETS = 8;
+
+/**
+ * How full the table is, and how old its entries are. An entry's age is
+ * the number of searches since it was last written.
+ */
+struct TranspositionTableOccupancy {
+    ui64 n_entries = 0;
+    ui64 n_empty   = 0;
+
+    /** Valid entries by age. The last bucket holds every older entry. */
+    std::array<ui64, TT_AGE_BUCKETS> by_age {};
+};
+
+/**
+ * Entries are grouped in clusters that never straddle a cache line. A position
+ * may be stored in any entry of the cluster its key maps to, so that a single
+ * memory access (and a single prefetch) covers every candidate entry.
+ */
+constexpr size_t TT_CLUSTER_SIZE    = 3;
+constexpr size_t TT_CLUSTER_ALIGN   = 32;
 constexpr size_t TT_DEFAULT_SIZE_MB = 32;
 
+/**
+ * Generations are stored in 5 bits and wrap around.
+ */
+constexpr ui8 TT_GENERATION_MASK = BITMASK(5);
+
+struct alignas(TT_CLUSTER_ALIGN) TranspositionTableCluster {
+    std::array<TranspositionTableEntry, TT_CLUSTER_SIZE> entries;
+};
+
+static_assert(sizeof(TranspositionTableCluster) == TT_CLUSTER_ALIGN);
+
 class TranspositionTable {
 public:
-    void clear();
+    /**
+     * Zeroes the table, splitting the work across n_threads threads.
+     * Each thread is the first to touch its own slice of the table,
+     * which also spreads its pages across the threads' memory nodes.
+     */
+    void clear(size_t n_threads = 1);
     size_t size() const;
-    void resize(size_t new_size_bytes);
+    MemoryBacking backing() const;
+
+    /**
+     * Resizes the table, discarding its contents.
+     * Returns whether the table had to be reallocated.
+     */
+    bool resize(size_t new_size_bytes);
+
+    /**
+     * Sets whether the table should try to be backed by huge pages.
+     * Returns whether the table had to be reallocated.
+     */
+    bool set_large_pages(bool large_pages);
+
+    /**
+     * Sets whether the table pages should be interleaved between NUMA
+     * nodes. When set on a machine with several nodes, the clearing
+     * threads are bound to alternating nodes and clear the table in
+     * huge page sized stripes, so that freshly allocated pages end up
+     * evenly spread between the nodes.
+     * Returns whether the table had to be reallocated.
+     */
+    bool set_numa_interleave(bool numa_interleave);
     void new_search();
-    bool probe(ui64 key, TranspositionTableEntry& entry, Depth ply = 0);
+    bool probe(ui64 key, TranspositionTableEntry& entry, Depth ply = 0,
+               TranspositionTableStats* stats = nullptr);
     void try_store(ui64 key,
                    Depth ply,
                    Move move,
@@ -59,52 +185,93 @@ public:
                    Depth depth,
                    Score static_eval,
                    BoundType bound_type,
-                   bool ttpv);
+                   bool ttpv,
+                   TranspositionTableStats* stats = nullptr);
+
+    /**
+     * Estimates, in permill, how much of the table is filled with entries
+     * written by the current search. Samples clusters spread over the
+     * whole table.
+     */
     int hash_full() const;
+
+    /**
+     * Scans the whole table. Too slow to be called during searches.
+     */
+    TranspositionTableOccupancy occupancy() const;
     void prefetch(ui64 zob) const;
 
+    /**
+     * Dumps the table contents to a file, preceded by a header that
+     * describes the entry layout, the table size and its generation.
+     * Returns false if the file couldn't be written.
+     */
+    bool save(const std::string& path) const;
+
+    /**
+     * Replaces the table with the contents of a file created by save().
+     * The file is mapped instead of read, so entries are only paged in
+     * once probed. Files with a different entry layout are rejected.
+     * Returns false (keeping the current table) if the file couldn't be
+     * loaded.
+     */
+    bool load(const std::string& path);
+
     explicit TranspositionTable(size_t size_bytes = TT_DEFAULT_SIZE_MB * 1024 * 1024);
     ~TranspositionTable() = default;
     TranspositionTable(TranspositionTable&& rhs) = default;
     TranspositionTable(const TranspositionTable& rhs) = delete;
+    TranspositionTable& operator=(TranspositionTable&& rhs) = default;
     TranspositionTable& operator=(const TranspositionTable& rhs) = delete;
 
 private:
-    std::unique_ptr<TranspositionTableEntry[]> m_buf = nullptr;
+    MemoryRegion m_mem;
+    TranspositionTableCluster* m_buf = nullptr;
     size_t m_size_in_bytes;
-    size_t m_max_entry_count;
+    size_t m_cluster_count;
+    bool m_large_pages = true;
+    bool m_numa_interleave = false;
     ui8 m_gen = 0;
 
-    TranspositionTableEntry& entry_ref(ui64 key);
-    const TranspositionTableEntry& entry_ref(ui64 key) const;
+    bool reallocate(size_t new_size_bytes, bool large_pages);
+
+    size_t cluster_index(ui64 key) const;
+    TranspositionTableCluster& cluster_ref(ui64 key);
+    const TranspositionTableCluster& cluster_ref(ui64 key) const;
+    int replacement_value(const TranspositionTableEntry& entry) const;
+    static TranspositionTableEntry layout_sample();
 };
 
-inline ui32 TranspositionTableEntry::key_hi() const {
-    return m_key_hi;
+inline ui16 TranspositionTableEntry::key_check() const {
+    return m_move ^ ui16(m_score) ^ ui16(m_static_eval) ^ ((ui16(m_depth) << 8) | m_gen_bound);
+}
+
+inline ui16 TranspositionTableEntry::key16() const {
+    return m_key_check ^ key_check();
 }
 
-inline Move TranspositionTableEntry::move() const {
-    return m_move;
+inline bool TranspositionTableEntry::has_move() const {
+    return m_move != 0;
 }
 
 inline bool TranspositionTableEntry::valid() const {
-    return m_info & 1;
+    return m_depth != 0;
 }
 
 inline BoundType TranspositionTableEntry::bound_type() const {
-    return BoundType((m_info >> 1) & BITMASK(2));
+    return BoundType((m_gen_bound >> 1) & BITMASK(2));
 }
 
 inline ui8 TranspositionTableEntry::generation() const {
-    return (m_info >> 3) & BITMASK(8);
+    return m_gen_bound >> 3;
 }
 
 inline Depth TranspositionTableEntry::depth() const {
-    return (m_info >> 11) & BITMASK(8);
+    return Depth(m_depth) - 1;
 }
 
 inline bool TranspositionTableEntry::ttpv() const {
-    return (m_info >> 19) & BITMASK(1);
+    return m_gen_bound & 1;
 }
 
 inline Score TranspositionTableEntry::score() const {
@@ -119,12 +286,23 @@ inline size_t TranspositionTable::size() const {
     return m_size_in_bytes;
 }
 
-inline const TranspositionTableEntry& TranspositionTable::entry_ref(ui64 key) const {
-    return m_buf[key % m_max_entry_count];
+inline MemoryBacking TranspositionTable::backing() const {
+    return m_mem.backing();
+}
+
+inline size_t TranspositionTable::cluster_index(ui64 key) const {
+    // Use the upper bits of the key to index the table. This avoids a costly
+    // 64-bit modulo while still allowing any cluster count. The lower bits are
+    // left for validating entries.
+    return mul_hi64(key, m_cluster_count);
+}
+
+inline const TranspositionTableCluster& TranspositionTable::cluster_ref(ui64 key) const {
+    return m_buf[cluster_index(key)];
 }
 
 inline void TranspositionTable::prefetch(ui64 zob) const {
-    __builtin_prefetch(&entry_ref(zob));
+    __builtin_prefetch(&cluster_ref(zob));
 }
 
 } // illumina
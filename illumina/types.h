@@ -107,6 +107,27 @@ constexpr ui64 flip_bits_vert(ui64 x) {
     return x;
 }
 
+/**
+ * Returns the upper 64 bits of the 128-bit product between a and b.
+ * Useful for mapping a uniformly distributed 64-bit value into the
+ * range [0, b) without having to perform a division.
+ */
+inline ui64 mul_hi64(ui64 a, ui64 b) {
+#ifdef __SIZEOF_INT128__
+    return ui64((unsigned __int128)(a) * b >> 64);
+#elif defined(_MSC_VER)
+    return __umulh(a, b);
+#else
+    ui64 a_lo = a & BITMASK(32), a_hi = a >> 32;
+    ui64 b_lo = b & BITMASK(32), b_hi = b >> 32;
+    ui64 lo_lo = a_lo * b_lo;
+    ui64 hi_lo = a_hi * b_lo;
+    ui64 lo_hi = a_lo * b_hi;
+    ui64 cross = (lo_lo >> 32) + (hi_lo & BITMASK(32)) + lo_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
 inline ui64 popcount(ui64 x) {
 #ifdef __GNUC__
     return __builtin_popcountll(x);
@@ -0,0 +1,69 @@
+#include <doctest/doctest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "epdanalysis.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("EPDAnalysis");
+
+TEST_CASE("EPD and FEN lines are parsed") {
+    EPDEntry epd = parse_epd_entry("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - bm Rd8#; id \"back; rank\";");
+    REQUIRE_EQ(epd.board.hash_key(), Board("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - -").hash_key());
+    REQUIRE_EQ(epd.id, "back; rank");
+
+    EPDEntry fen = parse_epd_entry("r7/1p3p1k/2p5/p5Q1/8/5B2/q3bKP1/8 w - - 2 34");
+    REQUIRE_EQ(fen.board.hash_key(), Board("r7/1p3p1k/2p5/p5Q1/8/5B2/q3bKP1/8 w - -").hash_key());
+    REQUIRE_EQ(fen.board.rule50(), 2);
+    REQUIRE(fen.id.empty());
+
+    REQUIRE_THROWS_AS(parse_epd_entry("8/8/8 w"), std::invalid_argument);
+}
+
+TEST_CASE("Analysis results don't depend on the number of threads") {
+    std::vector<EPDEntry> entries = {
+        parse_epd_entry("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - id \"startpos\";"),
+        parse_epd_entry("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - id \"mate\";"),
+        parse_epd_entry("r7/1p3p1k/2p5/p5Q1/8/5B2/q3bKP1/8 w - - 2 34"),
+        parse_epd_entry("8/8/8/R4pk1/1r6/5K2/8/8 b - - 9 57"),
+    };
+
+    EPDAnalysisSettings settings;
+    settings.max_depth    = 6;
+    settings.hash_size_mb = 1;
+
+    settings.n_threads = 1;
+    EPDAnalysisResults single = analyze_epd(entries, settings);
+    settings.n_threads = 3;
+    EPDAnalysisResults multi  = analyze_epd(entries, settings);
+
+    REQUIRE_EQ(single.results.size(), entries.size());
+    REQUIRE_EQ(single.total_nodes, multi.total_nodes);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        REQUIRE_EQ(format_epd_result(entries[i], single.results[i]),
+                   format_epd_result(entries[i], multi.results[i]));
+    }
+
+    REQUIRE_EQ(format_epd_result(entries[1], single.results[1]),
+               "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - acd 6; acn " + std::to_string(single.results[1].nodes)
+               + "; ce " + std::to_string(single.results[1].score) + "; dm 1; pv d1d8; id \"mate\";");
+}
+
+TEST_CASE("Positions getting mated report a negative dm") {
+    EPDEntry entry = parse_epd_entry("k7/8/1K6/8/8/8/8/7R b - - id \"mated\";");
+
+    EPDAnalysisSettings settings;
+    settings.max_depth    = 8;
+    settings.hash_size_mb = 1;
+    EPDAnalysisResults results = analyze_epd({ entry }, settings);
+
+    REQUIRE_EQ(results.results[0].score, -MATE_SCORE + 2);
+    REQUIRE_EQ(format_epd_result(entry, results.results[0]),
+               "k7/8/1K6/8/8/8/8/7R b - - acd 8; acn " + std::to_string(results.results[0].nodes)
+               + "; ce " + std::to_string(-MATE_SCORE + 2) + "; dm -1; pv a8b8 h1h8; id \"mated\";");
+}
+
+TEST_SUITE_END;
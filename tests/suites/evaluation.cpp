@@ -0,0 +1,156 @@
+#include <doctest/doctest.h>
+
+#include <random>
+#include <vector>
+
+#include "evalcache.h"
+#include "evaluation.h"
+#include "movegen.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("Evaluation");
+
+static Score fresh_evaluation(const Board& board) {
+    Evaluation eval;
+    eval.on_new_board(board);
+    return eval.compute(board);
+}
+
+static void check_incremental_updates(const std::string& fen, int n_plies, ui32 seed) {
+    Board board(fen);
+    Evaluation eval;
+    eval.on_new_board(board);
+
+    BoardListener listener {};
+    listener.on_make_move = [&eval](const Board& b, Move m) { eval.on_make_move(b, m); };
+    listener.on_undo_move = [&eval](const Board& b, Move m) { eval.on_undo_move(b, m); };
+    listener.on_make_null_move = [&eval](const Board& b) { eval.on_make_null_move(b); };
+    listener.on_undo_null_move = [&eval](const Board& b) { eval.on_undo_null_move(b); };
+    board.set_listener(listener);
+
+    std::mt19937 rng(seed);
+    std::vector<Score> scores;
+    std::vector<bool> null_moves;
+    for (int ply = 0; ply < n_plies; ++ply) {
+        Move moves[MAX_GENERATED_MOVES];
+        Move* end = generate_moves(board, moves);
+        if (end == moves) {
+            break;
+        }
+
+        // Sometimes skip evaluating a position, so that updates
+        // pile up lazily before being applied.
+        if (rng() % 3 != 0) {
+            Score expected = fresh_evaluation(board);
+            REQUIRE(eval.compute(board) == expected);
+        }
+
+        bool null_move = !board.in_check() && rng() % 8 == 0;
+        if (null_move) {
+            board.make_null_move();
+        }
+        else {
+            board.make_move(moves[rng() % (end - moves)]);
+        }
+        null_moves.push_back(null_move);
+    }
+
+    while (!null_moves.empty()) {
+        if (null_moves.back()) {
+            board.undo_null_move();
+        }
+        else {
+            board.undo_move();
+        }
+        null_moves.pop_back();
+
+        if (rng() % 2 == 0) {
+            REQUIRE(eval.compute(board) == fresh_evaluation(board));
+        }
+    }
+
+    REQUIRE(eval.compute(board) == fresh_evaluation(board));
+}
+
+TEST_CASE("Incremental evaluation matches full refresh") {
+    check_incremental_updates("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 120, 1);
+    check_incremental_updates("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 120, 2);
+    check_incremental_updates("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 120, 3);
+    check_incremental_updates("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 120, 4);
+}
+
+TEST_CASE("Accumulators are kept up to the maximum search ply") {
+    Board board = Board::standard_startpos();
+    Evaluation eval;
+    eval.on_new_board(board);
+
+    BoardListener listener {};
+    listener.on_make_move = [&eval](const Board& b, Move m) { eval.on_make_move(b, m); };
+    listener.on_undo_move = [&eval](const Board& b, Move m) { eval.on_undo_move(b, m); };
+    board.set_listener(listener);
+
+    // Develop a few pieces, then walk the kings back and forth
+    // until the line is as deep as a search can get.
+    const char* moves[] = { "g1f3", "g8f6", "f3g1", "f6g8", "e2e3", "e7e6", "e1e2", "e8e7", "e2e1", "e7e8" };
+    for (Depth ply = 0; ply < MAX_PLY; ++ply) {
+        const char* uci = ply < 8 ? moves[ply] : moves[6 + (ply - 6) % 4];
+        board.make_move(Move::parse_uci(board, uci));
+        if (ply % 16 == 0 || ply == MAX_PLY - 1) {
+            REQUIRE(eval.compute(board) == fresh_evaluation(board));
+        }
+    }
+
+    for (Depth ply = 0; ply < MAX_PLY; ++ply) {
+        board.undo_move();
+    }
+    REQUIRE(eval.compute(board) == fresh_evaluation(board));
+}
+
+TEST_CASE("Refreshing a reused evaluation matches full refresh") {
+    // Evaluations are reused by search workers, and refreshes start
+    // from previously cached accumulators.
+    const std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "8/8/8/8/8/8/8/K6k w - - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    };
+
+    Evaluation eval;
+    for (const std::string& fen: fens) {
+        Board board(fen);
+        eval.on_new_board(board);
+        REQUIRE(eval.compute(board) == fresh_evaluation(board));
+    }
+}
+
+TEST_CASE("Eval cache returns stored evaluations") {
+    EvalCache cache;
+    Score score = 0;
+
+    constexpr ui64 KEY       = 0xDEADBEEFCAFEBABE;
+    constexpr ui64 SAME_SLOT = KEY ^ 0xFFFF000000000000;
+    REQUIRE(!cache.probe(KEY, score));
+
+    cache.store(KEY, -123);
+    REQUIRE(cache.probe(KEY, score));
+    REQUIRE_EQ(score, -123);
+
+    // Keys mapping to the same entry must not be mixed up.
+    REQUIRE(!cache.probe(SAME_SLOT, score));
+    cache.store(SAME_SLOT, 456);
+    REQUIRE(cache.probe(SAME_SLOT, score));
+    REQUIRE_EQ(score, 456);
+    REQUIRE(!cache.probe(KEY, score));
+
+    REQUIRE_EQ(cache.stats().probes, 5);
+    REQUIRE_EQ(cache.stats().hits, 2);
+
+    cache.clear();
+    REQUIRE(!cache.probe(SAME_SLOT, score));
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,44 @@
+#include <doctest/doctest.h>
+
+#include <stdexcept>
+
+#include "json.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("JSON");
+
+TEST_CASE("JSON documents are parsed") {
+    JSONValue value = JSONValue::parse(R"( {"cmd": "go", "depth": 12, "ratio": -1.5e1,
+                                            "moves": ["e2e4", "e7e5"], "ponder": false,
+                                            "nested": {"x": null}, "text": "a\"b\\c\u00e9"} )");
+
+    REQUIRE_EQ(value.type(), JSON_OBJECT);
+    REQUIRE_EQ(value.find("cmd")->as_string(), "go");
+    REQUIRE_EQ(value.find("depth")->as_int(), 12);
+    REQUIRE_EQ(value.find("ratio")->as_number(), -15.0);
+    REQUIRE_EQ(value.find("moves")->as_array().size(), 2);
+    REQUIRE_EQ(value.find("moves")->as_array()[1].as_string(), "e7e5");
+    REQUIRE_EQ(value.find("ponder")->as_bool(), false);
+    REQUIRE(value.find("nested")->find("x")->is_null());
+    REQUIRE_EQ(value.find("text")->as_string(), "a\"b\\c\xC3\xA9");
+    REQUIRE(value.find("missing") == nullptr);
+
+    REQUIRE_THROWS_AS(value.find("cmd")->as_int(), std::invalid_argument);
+}
+
+TEST_CASE("Malformed JSON documents are rejected") {
+    const char* documents[] = {
+        "", "{", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "\"abc", "tru", "{} {}", "1.2.3", "\"\\q\"",
+    };
+    for (const char* document: documents) {
+        REQUIRE_THROWS_AS(JSONValue::parse(document), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Quoted strings round trip") {
+    std::string str = "line\nbreak \"quoted\" \\ tab\t \x01";
+    REQUIRE_EQ(JSONValue::parse(json_quote(str)).as_string(), str);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,32 @@
+#include <doctest/doctest.h>
+
+#include "numa.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("Numa");
+
+TEST_CASE("Parse CPU lists") {
+    REQUIRE(parse_cpu_list("0") == std::vector<int> { 0 });
+    REQUIRE((parse_cpu_list("0-3") == std::vector<int> { 0, 1, 2, 3 }));
+    REQUIRE((parse_cpu_list("0-1,4,6-7\n") == std::vector<int> { 0, 1, 4, 6, 7 }));
+    REQUIRE(parse_cpu_list("").empty());
+    REQUIRE(parse_cpu_list("3-1").empty());
+    REQUIRE(parse_cpu_list("0-x").empty());
+}
+
+TEST_CASE("Threads are spread across NUMA nodes") {
+    size_t n_nodes = numa_node_count();
+    REQUIRE_GE(n_nodes, 1);
+
+    for (size_t i = 0; i < 4 * n_nodes; ++i) {
+        REQUIRE_EQ(numa_node_for_thread(i), i % n_nodes);
+    }
+
+    // Single node machines never bind threads.
+    if (n_nodes == 1) {
+        REQUIRE(!bind_thread_to_numa_node(0));
+    }
+}
+
+TEST_SUITE_END;
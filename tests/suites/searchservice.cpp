@@ -0,0 +1,236 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "movegen.h"
+#include "searchservice.h"
+#include "serviceserver.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("SearchService");
+
+/**
+ * Collects the events reported by a service.
+ */
+struct ServiceEvents {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<SessionId> pv_sessions;
+    std::map<SessionId, AnalysisResults> finished;
+
+    explicit ServiceEvents(SearchService& service) {
+        service.set_pv_listener([this](SessionId session, const PVResults&) {
+            std::unique_lock lock(mutex);
+            pv_sessions.push_back(session);
+        });
+        service.set_finish_listener([this](SessionId session, const AnalysisResults& results) {
+            std::unique_lock lock(mutex);
+            finished[session] = results;
+            cv.notify_all();
+        });
+    }
+
+    bool wait_finished(size_t n_sessions) {
+        std::unique_lock lock(mutex);
+        return cv.wait_for(lock, std::chrono::seconds(60), [&]() { return finished.size() >= n_sessions; });
+    }
+};
+
+static bool is_legal(const Board& board, Move move) {
+    Move moves[MAX_GENERATED_MOVES];
+    Move* end = generate_moves(board, moves);
+    return std::find(moves, end, move) != end;
+}
+
+TEST_CASE("Sessions share workers in turns and respect their node budgets") {
+    constexpr ui64 SLICE_NODES = 20000;
+    constexpr ui64 BUDGET      = 8 * SLICE_NODES;
+
+    SearchService service(1, SLICE_NODES);
+    ServiceEvents events(service);
+
+    Board boards[] = {
+        Board::standard_startpos(),
+        Board("r1b1kb1r/1p3pp1/p1p2n1p/8/3qp1P1/PPN1P2P/3P1PB1/R2QK1NR b KQkq - 0 13"),
+    };
+    SessionId sessions[2];
+    for (int i = 0; i < 2; ++i) {
+        SessionSettings settings;
+        settings.hash_size_mb = 1;
+        settings.node_budget  = BUDGET;
+        sessions[i] = service.open_session(settings);
+        REQUIRE(service.set_position(sessions[i], boards[i]));
+    }
+
+    // Both analyses are unbounded, only the budgets stop them.
+    REQUIRE(service.analyze(sessions[0], {}));
+    REQUIRE(service.analyze(sessions[1], {}));
+    REQUIRE(!service.analyze(sessions[0], {}));
+    REQUIRE(!service.set_position(sessions[0], boards[1]));
+    REQUIRE(events.wait_finished(2));
+
+    for (int i = 0; i < 2; ++i) {
+        const AnalysisResults& results = events.finished[sessions[i]];
+        REQUIRE(results.budget_exhausted);
+        REQUIRE_EQ(results.budget_left, 0);
+        REQUIRE_GE(results.nodes, BUDGET);
+        REQUIRE_LT(results.nodes, BUDGET + SLICE_NODES);
+        REQUIRE(is_legal(boards[i], results.best_move));
+        REQUIRE_EQ(service.budget_left(sessions[i]), 0);
+    }
+
+    // With a single worker, sessions must have been searched in turns.
+    const std::vector<SessionId>& pv_sessions = events.pv_sessions;
+    auto first_of_second = std::find(pv_sessions.begin(), pv_sessions.end(), sessions[1]);
+    auto last_of_first   = std::find(pv_sessions.rbegin(), pv_sessions.rend(), sessions[0]);
+    REQUIRE(first_of_second != pv_sessions.end());
+    REQUIRE(last_of_first != pv_sessions.rend());
+    REQUIRE_LT(first_of_second - pv_sessions.begin(), pv_sessions.rend() - last_of_first - 1);
+
+    // Out of budget.
+    REQUIRE(!service.analyze(sessions[0], {}));
+
+    REQUIRE(service.close_session(sessions[0]));
+    REQUIRE(!service.close_session(sessions[0]));
+    REQUIRE_EQ(service.n_sessions(), 1);
+}
+
+TEST_CASE("Stopped and closed sessions finish their analyses") {
+    SearchService service(1, 10000);
+    ServiceEvents events(service);
+
+    SessionSettings settings;
+    settings.hash_size_mb = 1;
+    SessionId running = service.open_session(settings);
+    SessionId queued  = service.open_session(settings);
+    SessionId closed  = service.open_session(settings);
+
+    REQUIRE(service.analyze(running, {}));
+    REQUIRE(service.analyze(queued, {}));
+    REQUIRE(service.analyze(closed, {}));
+
+    REQUIRE(service.close_session(closed));
+    REQUIRE(service.stop(queued));
+    REQUIRE(service.stop(running));
+    REQUIRE(events.wait_finished(2));
+
+    REQUIRE_EQ(events.finished.count(closed), 0);
+    REQUIRE(!events.finished[running].budget_exhausted);
+
+    // Sessions can analyze again once finished.
+    events.finished.clear();
+    AnalysisLimits limits;
+    limits.max_depth = 4;
+    REQUIRE(service.analyze(running, limits));
+    REQUIRE(events.wait_finished(1));
+    REQUIRE_EQ(events.finished[running].depth, 4);
+}
+
+TEST_CASE("Service protocol drives sessions through JSON requests") {
+    SearchService service(2);
+    ServiceServer server(service);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::string> lines;
+    {
+        ServiceConnection connection(server, [&](const std::string& line) {
+            std::unique_lock lock(mutex);
+            lines.push_back(line);
+            cv.notify_all();
+        });
+
+        connection.handle_line(R"({"id": 1, "cmd": "open", "hash": 1, "budget": 1000000})");
+        connection.handle_line(R"({"id": 2, "cmd": "position", "session": 1, "moves": ["e2e4", "e7e5"]})");
+        connection.handle_line(R"({"id": 3, "cmd": "position", "session": 1, "moves": ["e2e5"]})");
+        connection.handle_line(R"({"id": 4, "cmd": "go", "session": 2})");
+        connection.handle_line(R"({"id": "x", "cmd": "go", "session": 1, "depth": 5})");
+        connection.handle_line("{not json");
+
+        std::unique_lock lock(mutex);
+        REQUIRE(cv.wait_for(lock, std::chrono::seconds(60), [&]() {
+            return std::any_of(lines.begin(), lines.end(), [](const std::string& line) {
+                return line.find("bestmove") != std::string::npos;
+            });
+        }));
+    }
+
+    REQUIRE_EQ(lines[0], R"({"event":"opened","id":1,"session":1})");
+    REQUIRE_EQ(lines[1], R"({"event":"ok","id":2})");
+    REQUIRE_EQ(JSONValue::parse(lines[2]).find("event")->as_string(), "error");
+    REQUIRE_EQ(JSONValue::parse(lines[3]).find("message")->as_string(), "Unknown session 2");
+
+    // The rest of the events come in any order.
+    int n_infos = 0;
+    for (size_t i = 4; i < lines.size(); ++i) {
+        JSONValue event = JSONValue::parse(lines[i]);
+        const std::string& type = event.find("event")->as_string();
+        if (type == "info") {
+            n_infos++;
+            REQUIRE_EQ(event.find("session")->as_int(), 1);
+        }
+        else if (type == "bestmove") {
+            REQUIRE_EQ(event.find("depth")->as_int(), 5);
+            REQUIRE_EQ(event.find("budget_left")->as_int() + event.find("nodes")->as_int(), 1000000);
+        }
+    }
+    REQUIRE_GE(n_infos, 5);
+
+    // Sessions are closed along with their connection.
+    REQUIRE_EQ(service.n_sessions(), 0);
+}
+
+TEST_CASE("Connections that stop reading don't stall other sessions") {
+    SearchService service(1, 10000);
+    ServiceServer server(service);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool released = false;
+    std::vector<std::string> lines;
+    {
+        // Never returns from writing until released, like a
+        // socket client that doesn't read its events.
+        ServiceConnection stalled(server, [&](const std::string&) {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&]() { return released; });
+        });
+        ServiceConnection reading(server, [&](const std::string& line) {
+            std::unique_lock lock(mutex);
+            lines.push_back(line);
+            cv.notify_all();
+        });
+
+        stalled.handle_line(R"({"cmd": "open", "hash": 1})");
+        stalled.handle_line(R"({"cmd": "go", "session": 1, "depth": 8})");
+        reading.handle_line(R"({"cmd": "open", "hash": 1})");
+        reading.handle_line(R"({"cmd": "go", "session": 2, "depth": 8})");
+        reading.handle_line(R"({"cmd": "status", "session": 2})");
+
+        std::unique_lock lock(mutex);
+        bool finished = cv.wait_for(lock, std::chrono::seconds(60), [&]() {
+            return std::any_of(lines.begin(), lines.end(), [](const std::string& line) {
+                return line.find("bestmove") != std::string::npos;
+            });
+        });
+
+        // Let the stalled connection go before anything can throw.
+        released = true;
+        cv.notify_all();
+        lock.unlock();
+        REQUIRE(finished);
+    }
+
+    REQUIRE_EQ(lines[0], R"({"event":"opened","session":2})");
+    REQUIRE_EQ(lines[1], R"({"event":"ok"})");
+}
+
+TEST_SUITE_END;
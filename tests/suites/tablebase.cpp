@@ -0,0 +1,179 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "movegen.h"
+#include "search.h"
+#include "tablebase.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("Tablebase");
+
+TEST_CASE("Positions can't be probed without loaded tablebases") {
+    REQUIRE_EQ(syzygy_init(""), 0);
+    REQUIRE_EQ(syzygy_max_pieces(), 0);
+
+    Board board("8/8/8/4k3/8/8/3QK3/8 w - - 0 1");
+    REQUIRE_EQ(syzygy_probe_wdl(board), TBR_FAILED);
+
+    Move moves[MAX_GENERATED_MOVES];
+    Move* end = generate_moves(board, moves);
+    std::vector<Move> root_moves(moves, end);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, root_moves), TBR_FAILED);
+    REQUIRE_EQ(root_moves.size(), size_t(end - moves));
+
+    // Searches don't report hits either.
+    Searcher searcher(TranspositionTable(1024 * 1024));
+    ui64 tb_hits = UINT64_MAX;
+    searcher.set_pv_finish_listener([&tb_hits](const PVResults& pv_results) {
+        tb_hits = pv_results.tb_hits;
+    });
+
+    SearchSettings settings;
+    settings.max_depth = 5;
+    searcher.search(board, settings);
+    REQUIRE_EQ(tb_hits, 0);
+}
+
+TEST_CASE("Paths without table files load nothing") {
+    REQUIRE_EQ(syzygy_init("/nonexistent/dir"), 0);
+    REQUIRE_EQ(syzygy_max_pieces(), 0);
+
+    // The tests' own sources hold no tables.
+    REQUIRE_EQ(syzygy_init(SYZYGY_TEST_PATH "/../suites"), 0);
+    REQUIRE_EQ(syzygy_max_pieces(), 0);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/8 w - - 0 1")), TBR_FAILED);
+
+    REQUIRE_EQ(syzygy_init(""), 0);
+}
+
+static std::vector<Move> legal_moves(const Board& board) {
+    Move moves[MAX_GENERATED_MOVES];
+    Move* end = generate_moves(board, moves);
+    return std::vector<Move>(moves, end);
+}
+
+static bool contains(const std::vector<Move>& moves, const Board& board, std::string_view uci) {
+    return std::find(moves.begin(), moves.end(), Move::parse_uci(board, uci)) != moves.end();
+}
+
+TEST_CASE("Table files are probed for WDL") {
+    REQUIRE_EQ(syzygy_init(SYZYGY_TEST_PATH), 4);
+    REQUIRE_EQ(syzygy_max_pieces(), 4);
+
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/8 w - - 0 1")), TBR_WIN);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/8 b - - 0 1")), TBR_LOSS);
+
+    // Black holding the extra piece.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/3qk3/8/8/8/8/8/4K3 b - - 0 1")), TBR_WIN);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/3qk3/8/8/8/8/8/4K3 w - - 0 1")), TBR_LOSS);
+
+    // The queen can be taken.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("7K/8/8/8/8/8/3Qk3/8 b - - 0 1")), TBR_DRAW);
+
+    // Pawns have to promote first.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1")), TBR_LOSS);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("k7/8/8/8/8/8/P7/K7 w - - 0 1")), TBR_DRAW);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3BK3/8 w - - 0 1")), TBR_DRAW);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3NK3/8 b - - 0 1")), TBR_DRAW);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3RK3/8 b - - 0 1")), TBR_LOSS);
+
+    // The rook skewers the queen, for either side.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("1r6/7k/8/8/K7/8/8/Q7 b - - 0 1")), TBR_WIN);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("q7/8/8/k7/8/8/7K/1R6 w - - 0 1")), TBR_WIN);
+
+    // The rook hangs next to the king.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("4k3/8/8/8/8/8/4r3/3QK3 w - - 0 1")), TBR_WIN);
+
+    // Only positions just reset by the 50 move rule can be probed, and
+    // only endings whose tables were found.
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/8 w - - 3 10")), TBR_FAILED);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/7R w - - 0 1")), TBR_FAILED);
+    REQUIRE_EQ(syzygy_probe_wdl(Board("8/8/8/4k3/8/8/3QK3/6RR w - - 0 1")), TBR_FAILED);
+
+    REQUIRE_EQ(syzygy_init(""), 0);
+}
+
+TEST_CASE("Table files filter root moves by DTZ") {
+    REQUIRE_EQ(syzygy_init(SYZYGY_TEST_PATH), 4);
+
+    // Checks next to the king hang the queen unless they're defended.
+    Board board("8/8/8/8/8/4k3/8/3QK3 w - - 0 1");
+    std::vector<Move> moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE(!contains(moves, board, "d1d3"));
+    REQUIRE(!contains(moves, board, "d1f3"));
+    REQUIRE(contains(moves, board, "d1d2"));
+    for (Move move: moves) {
+        CAPTURE(move);
+        Board child = board;
+        child.make_move(move);
+        std::vector<Move> child_moves = legal_moves(child);
+        REQUIRE_EQ(syzygy_filter_root_moves(child, child_moves), TBR_LOSS);
+    }
+
+    // Pawns are pushed only when the win allows it.
+    board = Board("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1");
+    moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE_EQ(moves.size(), size_t(2));
+    REQUIRE(contains(moves, board, "e6d6"));
+    REQUIRE(contains(moves, board, "e6f6"));
+
+    // Promotions are told apart: minor pieces can't win.
+    board = Board("8/4P1k1/8/8/8/8/8/4K3 w - - 0 1");
+    moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE(contains(moves, board, "e7e8q"));
+    REQUIRE(contains(moves, board, "e7e8r"));
+    REQUIRE(!contains(moves, board, "e7e8b"));
+    REQUIRE(!contains(moves, board, "e7e8n"));
+
+    // With a single move left before the 50 move rule, only the mate
+    // still wins. Any other winning move is a cursed win.
+    board = Board("k7/8/1K6/8/8/8/8/6Q1 w - - 99 80");
+    moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE_EQ(moves.size(), size_t(1));
+    REQUIRE(contains(moves, board, "g1g8"));
+
+    board = Board("k7/8/1K6/8/8/8/8/6Q1 w - - 0 80");
+    moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE_GT(moves.size(), size_t(1));
+
+    // Only the skewer wins the queen.
+    board = Board("1r6/7k/8/8/K7/8/8/Q7 b - - 0 1");
+    moves = legal_moves(board);
+    REQUIRE_EQ(syzygy_filter_root_moves(board, moves), TBR_WIN);
+    REQUIRE_EQ(moves.size(), size_t(1));
+    REQUIRE(contains(moves, board, "b8a8"));
+
+    REQUIRE_EQ(syzygy_init(""), 0);
+}
+
+TEST_CASE("Searches probe table files") {
+    REQUIRE_EQ(syzygy_init(SYZYGY_TEST_PATH), 4);
+    Searcher searcher(TranspositionTable(1024 * 1024));
+    ui64 tb_hits = 0;
+    searcher.set_pv_finish_listener([&tb_hits](const PVResults& pv_results) {
+        tb_hits = pv_results.tb_hits;
+    });
+
+    SearchSettings settings;
+    settings.max_depth = 8;
+    Board board("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1");
+    SearchResults results = searcher.search(board, settings);
+
+    REQUIRE_GT(tb_hits, 0);
+    REQUIRE_GE(results.score, TB_WIN_THRESHOLD);
+    REQUIRE((   results.best_move == Move::parse_uci(board, "e6d6")
+             || results.best_move == Move::parse_uci(board, "e6f6")));
+
+    REQUIRE_EQ(syzygy_init(""), 0);
+}
+
+
+TEST_SUITE_END;
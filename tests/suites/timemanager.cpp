@@ -0,0 +1,135 @@
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "timemanager.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("TimeManager");
+
+TEST_CASE("Move overhead is deducted from our time") {
+    TimeManager tm;
+    tm.set_move_overhead(50);
+
+    tm.start_movetime(1000);
+    REQUIRE_EQ(tm.soft_bound(), 950);
+    REQUIRE_EQ(tm.hard_bound(), 950);
+
+    tm.start_movetime(30);
+    REQUIRE_EQ(tm.hard_bound(), 0);
+
+    // On the last move before the time control, use everything we have.
+    tm.start_tourney_time(5000, 0, 5000, 0, 1);
+    REQUIRE_EQ(tm.soft_bound(), 4950);
+    REQUIRE_EQ(tm.hard_bound(), 4950);
+}
+
+TEST_CASE("Tourney time bounds scale with increment and moves to go") {
+    TimeManager tm;
+
+    tm.start_tourney_time(60000, 0, 60000, 0);
+    ui64 soft_no_inc = tm.soft_bound();
+    ui64 hard_no_inc = tm.hard_bound();
+    REQUIRE_GT(soft_no_inc, 0);
+    REQUIRE_LT(soft_no_inc, hard_no_inc);
+    REQUIRE_LT(hard_no_inc, 60000);
+
+    tm.start_tourney_time(60000, 1000, 60000, 1000);
+    REQUIRE_GT(tm.soft_bound(), soft_no_inc);
+    REQUIRE_GT(tm.hard_bound(), hard_no_inc);
+
+    // The closer the next time control, the more we can spend now.
+    tm.start_tourney_time(60000, 0, 60000, 0, 40);
+    ui64 soft_40_moves = tm.soft_bound();
+    tm.start_tourney_time(60000, 0, 60000, 0, 5);
+    REQUIRE_GT(tm.soft_bound(), soft_40_moves);
+    tm.start_tourney_time(60000, 0, 60000, 0, 2);
+    REQUIRE_LT(tm.soft_bound(), tm.hard_bound());
+    REQUIRE_LT(tm.hard_bound(), 60000);
+
+    // Unknown clocks must not overflow.
+    tm.start_tourney_time(UINT64_MAX, 1000, UINT64_MAX, 1000, 2);
+    REQUIRE_GT(tm.soft_bound(), 0);
+    REQUIRE_GE(tm.hard_bound(), tm.soft_bound());
+}
+
+struct TimeControl {
+    i64  base_ms;
+    i64  inc_ms;
+    int  moves_per_control; // 0 for sudden death.
+    ui64 overhead_ms;
+};
+
+/**
+ * Replays a whole game against the time manager bounds and returns the
+ * lowest clock reading we had after a move. Searches are simulated from
+ * their iteration timings: a search stops after the first iteration that
+ * ends past the soft bound, or at the hard bound in the middle of an
+ * iteration. Each move then loses up to overhead_ms to lag.
+ */
+static i64 replay_game(const TimeControl& tc, int n_moves, ui32 seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> branching(1.4, 3.5);
+
+    TimeManager tm;
+    tm.set_move_overhead(tc.overhead_ms);
+
+    i64 clock       = tc.base_ms;
+    i64 lowest      = clock;
+    int moves_to_go = tc.moves_per_control;
+    for (int move = 0; move < n_moves; ++move) {
+        tm.start_tourney_time(ui64(clock), ui64(tc.inc_ms), ui64(clock), ui64(tc.inc_ms), moves_to_go);
+
+        double iteration_end = 0;
+        double iteration_len = 0.05;
+        while (iteration_end < double(tm.soft_bound())) {
+            iteration_len *= branching(rng);
+            iteration_end += iteration_len;
+        }
+        i64 spent = i64(std::min(iteration_end, double(tm.hard_bound())));
+        i64 lag   = i64(rng() % (tc.overhead_ms + 1));
+
+        clock -= spent + lag;
+        lowest = std::min(lowest, clock);
+        if (clock < 0) {
+            break;
+        }
+
+        clock += tc.inc_ms;
+        if (tc.moves_per_control > 0 && --moves_to_go == 0) {
+            clock      += tc.base_ms;
+            moves_to_go = tc.moves_per_control;
+        }
+    }
+
+    return lowest;
+}
+
+TEST_CASE("Replayed games never lose on time") {
+    const TimeControl time_controls[] = {
+        { 10000,   100,  0, 10 },  // 10s+0.1s
+        { 60000,   600,  0, 10 },  // 60s+0.6s
+        { 180000,  0,    0, 10 },  // 3m
+        { 1000,    1000, 0, 50 },  // 1s+1s, slow GUI
+        { 100,     50,   0, 30 },  // Almost flagged
+        { 60000,   0,    40, 10 }, // 40 moves in 60s, repeating
+        { 5000,    0,    10, 100 },
+    };
+
+    // Without increments, every move still costs us some lag, so a long
+    // enough sudden death game always flags. 120 moves is already a lot.
+    for (const TimeControl& tc: time_controls) {
+        for (ui32 seed = 0; seed < 8; ++seed) {
+            CAPTURE(tc.base_ms);
+            CAPTURE(tc.inc_ms);
+            CAPTURE(tc.moves_per_control);
+            CAPTURE(seed);
+            REQUIRE_GE(replay_game(tc, 120, seed), 0);
+        }
+    }
+}
+
+TEST_SUITE_END;
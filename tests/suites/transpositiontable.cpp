@@ -0,0 +1,351 @@
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "transpositiontable.h"
+#include "board.h"
+#include "movegen.h"
+
+using namespace illumina;
+
+TEST_SUITE_BEGIN("TranspositionTable");
+
+// A table with a single cluster, which makes every key collide.
+static constexpr size_t SINGLE_CLUSTER_TT_SIZE = sizeof(TranspositionTableCluster);
+
+TEST_CASE("TTStoreAndProbe") {
+    Board board = Board::standard_startpos();
+    Move move   = Move::parse_uci(board, "e2e4");
+
+    TranspositionTable tt(1024 * 1024);
+    tt.try_store(0xDEADBEEFCAFEBABE, 0, move, 35, 7, 20, BT_EXACT, true);
+
+    TranspositionTableEntry entry {};
+    REQUIRE(tt.probe(0xDEADBEEFCAFEBABE, entry));
+    REQUIRE_EQ(entry.move(board), move);
+    REQUIRE_EQ(entry.score(), 35);
+    REQUIRE_EQ(entry.depth(), 7);
+    REQUIRE_EQ(entry.static_eval(), 20);
+    REQUIRE_EQ(entry.bound_type(), BT_EXACT);
+    REQUIRE_EQ(entry.ttpv(), true);
+
+    REQUIRE(!tt.probe(0x0123456789ABCDEF, entry));
+}
+
+TEST_CASE("TTKnownWinsAreRelativeToPly") {
+    TranspositionTable tt(1024 * 1024);
+
+    // Found 10 plies into the search, probed 4 plies into another.
+    Score scores[] = { MATE_SCORE - 12, -MATE_SCORE + 12, TB_WIN_SCORE - 12, -TB_WIN_SCORE + 12 };
+    ui64 keys[]   = { 0x1111111111111111, 0x5555555555555555, 0x9999999999999999, 0xDDDDDDDDDDDDDDDD };
+    for (ui64 i = 0; i < std::size(scores); ++i) {
+        tt.try_store(keys[i], 10, MOVE_NULL, scores[i], 5, 0, BT_EXACT, false);
+    }
+
+    for (ui64 i = 0; i < std::size(scores); ++i) {
+        TranspositionTableEntry entry {};
+        CAPTURE(i);
+        REQUIRE(tt.probe(keys[i], entry, 4));
+        REQUIRE_EQ(entry.score(), scores[i] > 0 ? scores[i] + 6 : scores[i] - 6);
+    }
+}
+
+TEST_CASE("TTClusterKeepsSeveralPositions") {
+    TranspositionTable tt(SINGLE_CLUSTER_TT_SIZE);
+
+    for (ui64 i = 1; i <= TT_CLUSTER_SIZE; ++i) {
+        tt.try_store(i, 0, MOVE_NULL, Score(i), Depth(i), 0, BT_LOWERBOUND, false);
+    }
+
+    for (ui64 i = 1; i <= TT_CLUSTER_SIZE; ++i) {
+        TranspositionTableEntry entry {};
+        CAPTURE(i);
+        REQUIRE(tt.probe(i, entry));
+        REQUIRE_EQ(entry.score(), Score(i));
+        REQUIRE_EQ(entry.depth(), Depth(i));
+    }
+}
+
+TEST_CASE("TTReplacementKeepsDeepEntries") {
+    TranspositionTable tt(SINGLE_CLUSTER_TT_SIZE);
+
+    constexpr ui64 DEEP_KEY = 0xFFFF;
+    tt.try_store(DEEP_KEY, 0, MOVE_NULL, 100, 30, 0, BT_EXACT, false);
+
+    // Flood the cluster with shallow entries of other positions.
+    for (ui64 i = 1; i <= 4 * TT_CLUSTER_SIZE; ++i) {
+        tt.try_store(i, 0, MOVE_NULL, 0, 1, 0, BT_UPPERBOUND, false);
+    }
+
+    TranspositionTableEntry entry {};
+    REQUIRE(tt.probe(DEEP_KEY, entry));
+    REQUIRE_EQ(entry.depth(), 30);
+}
+
+TEST_CASE("TTReplacementPrefersOldEntries") {
+    TranspositionTable tt(SINGLE_CLUSTER_TT_SIZE);
+
+    constexpr ui64 OLD_KEY = 0xFFFF;
+    tt.try_store(OLD_KEY, 0, MOVE_NULL, 100, 10, 0, BT_EXACT, false);
+
+    // Age the stored entry for a few searches.
+    for (int i = 0; i < 4; ++i) {
+        tt.new_search();
+    }
+
+    for (ui64 i = 1; i <= TT_CLUSTER_SIZE; ++i) {
+        tt.try_store(i, 0, MOVE_NULL, 0, 1, 0, BT_UPPERBOUND, false);
+    }
+
+    TranspositionTableEntry entry {};
+    REQUIRE(!tt.probe(OLD_KEY, entry));
+}
+
+TEST_CASE("TTParallelClear") {
+    TranspositionTable tt(8 * 1024 * 1024);
+
+    constexpr ui64 N_KEYS = 4096;
+    for (ui64 i = 0; i < N_KEYS; ++i) {
+        tt.try_store(i * 0x9E3779B97F4A7C15, 0, MOVE_NULL, 1, 1, 0, BT_EXACT, false);
+    }
+
+    tt.clear(4);
+
+    for (ui64 i = 0; i < N_KEYS; ++i) {
+        TranspositionTableEntry entry {};
+        CAPTURE(i);
+        REQUIRE(!tt.probe(i * 0x9E3779B97F4A7C15, entry));
+    }
+    REQUIRE_EQ(tt.hash_full(), 0);
+}
+
+TEST_CASE("TTCompactMovesRoundTrip") {
+    const std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "1rk3r1/pppppppp/8/8/8/8/PPPPPPPP/1RK3R1 w KQkq - 0 1",
+        "1rk3r1/pppppppp/8/8/8/8/PPPPPPPP/1RK3R1 b KQkq - 0 1",
+    };
+
+    for (const std::string& fen: fens) {
+        Board board(fen);
+        Move moves[MAX_GENERATED_MOVES];
+        Move* end = generate_moves(board, moves);
+        for (Move* it = moves; it != end; ++it) {
+            CAPTURE(fen);
+            CAPTURE(it->to_uci());
+            REQUIRE_EQ(expand_compact_move(board, compact_move(*it)), *it);
+        }
+    }
+
+    Board board = Board::standard_startpos();
+    REQUIRE_EQ(compact_move(MOVE_NULL), 0);
+    REQUIRE_EQ(expand_compact_move(board, 0), MOVE_NULL);
+}
+
+TEST_CASE("TTTornEntryFailsKeyCheck") {
+    // Simulate an entry torn by two concurrent writes, by mixing the
+    // bytes of two different entries at every possible split point.
+    constexpr ui64 KEY_A = 0x1111111122222222;
+    constexpr ui64 KEY_B = 0x3333333344444444;
+    Board board = Board::standard_startpos();
+
+    TranspositionTable tt_a(SINGLE_CLUSTER_TT_SIZE);
+    TranspositionTable tt_b(SINGLE_CLUSTER_TT_SIZE);
+    tt_a.try_store(KEY_A, 0, Move::parse_uci(board, "e2e4"), 35, 7, 20, BT_EXACT, true);
+    tt_b.try_store(KEY_B, 0, Move::parse_uci(board, "g1f3"), -80, 12, -60, BT_LOWERBOUND, false);
+
+    TranspositionTableEntry entry_a {};
+    TranspositionTableEntry entry_b {};
+    REQUIRE(tt_a.probe(KEY_A, entry_a));
+    REQUIRE(tt_b.probe(KEY_B, entry_b));
+
+    for (bool a_first: { true, false }) {
+        const TranspositionTableEntry& first  = a_first ? entry_a : entry_b;
+        const TranspositionTableEntry& second = a_first ? entry_b : entry_a;
+
+        for (size_t split = 1; split < sizeof(TranspositionTableEntry); ++split) {
+            TranspositionTableEntry torn {};
+            std::memcpy(reinterpret_cast<char*>(&torn), &first, split);
+            std::memcpy(reinterpret_cast<char*>(&torn) + split,
+                        reinterpret_cast<const char*>(&second) + split,
+                        sizeof(TranspositionTableEntry) - split);
+
+            CAPTURE(a_first);
+            CAPTURE(split);
+            REQUIRE_NE(torn.key16(), ui16(KEY_A));
+            REQUIRE_NE(torn.key16(), ui16(KEY_B));
+        }
+    }
+}
+
+struct StressEntryData {
+    Move      move;
+    Score     score;
+    Score     static_eval;
+    Depth     depth;
+    BoundType bound_type;
+    bool      ttpv;
+};
+
+// Derives every field from the key, so that readers can tell
+// whether an entry was mixed up with another position's data.
+static StressEntryData stress_entry_data(const Board& board, ui64 key) {
+    Move moves[MAX_GENERATED_MOVES];
+    Move* end = generate_moves(board, moves);
+    return {
+        moves[key % (end - moves)],
+        Score(i16(key * 37)),
+        Score(i16(-i64(key) * 11)),
+        Depth(key % 200 + 1),
+        BoundType(BT_EXACT + key % 3),
+        bool(key & 1)
+    };
+}
+
+TEST_CASE("TTConcurrentAccessNeverReturnsTornEntries") {
+    // Every thread hammers the same cluster with different positions,
+    // so entries are constantly overwritten while being read.
+    TranspositionTable tt(SINGLE_CLUSTER_TT_SIZE);
+
+    constexpr int N_THREADS    = 4;
+    constexpr int N_ITERATIONS = 200000;
+    constexpr ui64 N_KEYS      = 64;
+
+    std::atomic<ui64> n_hits    = 0;
+    std::atomic<ui64> n_corrupt = 0;
+
+    const Board board = Board::standard_startpos();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < N_THREADS; ++t) {
+        threads.emplace_back([&tt, &board, &n_hits, &n_corrupt, t]() {
+            ui64 hits    = 0;
+            ui64 corrupt = 0;
+            for (int i = 0; i < N_ITERATIONS; ++i) {
+                ui64 key = ui64(i * N_THREADS + t) % N_KEYS + 1;
+                StressEntryData data = stress_entry_data(board, key);
+                tt.try_store(key, 0, data.move, data.score, data.depth,
+                             data.static_eval, data.bound_type, data.ttpv);
+
+                ui64 probed_key = ui64(i * 7 + t * 13) % N_KEYS + 1;
+                StressEntryData expected = stress_entry_data(board, probed_key);
+                TranspositionTableEntry entry {};
+                if (!tt.probe(probed_key, entry)) {
+                    continue;
+                }
+
+                hits++;
+                if (   entry.move(board)   != expected.move
+                    || entry.score()       != expected.score
+                    || entry.static_eval() != expected.static_eval
+                    || entry.depth()       != expected.depth
+                    || entry.bound_type()  != expected.bound_type
+                    || entry.ttpv()        != expected.ttpv) {
+                    corrupt++;
+                }
+            }
+            n_hits    += hits;
+            n_corrupt += corrupt;
+        });
+    }
+
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    REQUIRE_GT(n_hits.load(), 0);
+    REQUIRE_EQ(n_corrupt.load(), 0);
+}
+
+TEST_CASE("TTSaveAndLoad") {
+    Board board = Board::standard_startpos();
+    Move move   = Move::parse_uci(board, "g1f3");
+    std::string path = (std::filesystem::temp_directory_path() / "illumina_tt_save_load.tt").string();
+
+    TranspositionTable saved(1024 * 1024);
+    saved.new_search();
+    saved.try_store(0xDEADBEEFCAFEBABE, 0, move, -48, 11, 7, BT_UPPERBOUND, false);
+    REQUIRE(saved.save(path));
+
+    // The loaded table replaces the current one, size included.
+    TranspositionTable loaded(SINGLE_CLUSTER_TT_SIZE);
+    REQUIRE(loaded.load(path));
+    REQUIRE_EQ(loaded.size(), saved.size());
+
+    TranspositionTableEntry entry {};
+    REQUIRE(loaded.probe(0xDEADBEEFCAFEBABE, entry));
+    REQUIRE_EQ(entry.move(board), move);
+    REQUIRE_EQ(entry.score(), -48);
+    REQUIRE_EQ(entry.depth(), 11);
+    REQUIRE_EQ(entry.static_eval(), 7);
+    REQUIRE_EQ(entry.bound_type(), BT_UPPERBOUND);
+    REQUIRE_EQ(entry.ttpv(), false);
+    REQUIRE_EQ(entry.generation(), 1);
+
+    // Entries stored after loading stay in memory and don't reach the file.
+    loaded.try_store(0x0123456789ABCDEF, 0, MOVE_NULL, 5, 3, 5, BT_EXACT, false);
+    REQUIRE(loaded.probe(0x0123456789ABCDEF, entry));
+    TranspositionTable reloaded(SINGLE_CLUSTER_TT_SIZE);
+    REQUIRE(reloaded.load(path));
+    REQUIRE(!reloaded.probe(0x0123456789ABCDEF, entry));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("TTLoadRejectsInvalidFiles") {
+    std::string path = (std::filesystem::temp_directory_path() / "illumina_tt_invalid.tt").string();
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> garbage(8192, 'x');
+        file.write(garbage.data(), std::streamsize(garbage.size()));
+    }
+
+    TranspositionTable tt(SINGLE_CLUSTER_TT_SIZE);
+    tt.try_store(0xDEADBEEFCAFEBABE, 0, MOVE_NULL, 12, 4, 12, BT_EXACT, false);
+    REQUIRE(!tt.load(path));
+    REQUIRE(!tt.load(path + ".missing"));
+
+    // A failed load keeps the current table.
+    TranspositionTableEntry entry {};
+    REQUIRE(tt.probe(0xDEADBEEFCAFEBABE, entry));
+    REQUIRE_EQ(tt.size(), SINGLE_CLUSTER_TT_SIZE);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("TTHashFullOnlyCountsCurrentSearch") {
+    TranspositionTable tt(1024 * 1024);
+    REQUIRE_EQ(tt.hash_full(), 0);
+
+    // Fill every entry of the table.
+    size_t n_entries = tt.size() / sizeof(TranspositionTableCluster) * TT_CLUSTER_SIZE;
+    for (ui64 i = 0; i < n_entries * 8; ++i) {
+        ui64 key = i * 0x9E3779B97F4A7C15ULL;
+        tt.try_store(key, 0, MOVE_NULL, 0, 1, 0, BT_EXACT, false);
+    }
+    REQUIRE_GE(tt.hash_full(), 990);
+
+    TranspositionTableOccupancy occupancy = tt.occupancy();
+    REQUIRE_EQ(occupancy.n_entries, n_entries);
+    REQUIRE_EQ(occupancy.by_age[0], n_entries - occupancy.n_empty);
+
+    // Entries from previous searches are not reported as filled.
+    tt.new_search();
+    REQUIRE_EQ(tt.hash_full(), 0);
+
+    occupancy = tt.occupancy();
+    REQUIRE_EQ(occupancy.by_age[0], 0);
+    REQUIRE_EQ(occupancy.by_age[1], n_entries - occupancy.n_empty);
+}
+
+TEST_SUITE_END;
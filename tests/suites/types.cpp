@@ -422,6 +422,20 @@ TEST_CASE("MsbLsb") {
     }
 }
 
+TEST_CASE("MulHi64") {
+    REQUIRE_EQ(mul_hi64(0, 12345), 0);
+    REQUIRE_EQ(mul_hi64(UINT64_MAX, 1), 0);
+    REQUIRE_EQ(mul_hi64(UINT64_MAX, 2), 1);
+    REQUIRE_EQ(mul_hi64(1ULL << 63, 1000), 500);
+    REQUIRE_EQ(mul_hi64(UINT64_MAX, UINT64_MAX), UINT64_MAX - 1);
+    REQUIRE_EQ(mul_hi64(0x123456789ABCDEF0, 0xFEDCBA9876543210), 0x121FA00AD77D7422);
+
+    // Results must always fall within [0, n).
+    for (ui64 n: { 1ULL, 3ULL, 1000ULL, 524288ULL, 1234567ULL }) {
+        REQUIRE_LT(mul_hi64(UINT64_MAX, n), n);
+    }
+}
+
 TEST_CASE("OppositeColor") {
     REQUIRE_EQ(opposite_color(CL_WHITE), CL_BLACK);
     REQUIRE_EQ(opposite_color(CL_BLACK), CL_WHITE);
@@ -0,0 +1,1607 @@
+/*
+ * Generates the Syzygy tables used by the tablebase tests.
+ *
+ * Endings are solved by retrograde analysis and written in the format of
+ * the Syzygy WDL (.rtbw) and DTZ (.rtbz) files. The written tables are
+ * then read back through the prober, and checked against the solution.
+ *
+ * Usage: illumina-syzygy-generate <directory> <ending>...
+ * The tables of this directory were generated with
+ *     illumina-syzygy-generate tests/syzygy KNvK KBvK KRvK KQvK KPvK KQvKR
+ *
+ * Endings of up to 4 pieces are supported, as long as only one side has
+ * pawns. Endings reached through captures and promotions must be written
+ * too, since they are needed to check the probes.
+ */
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <illumina.h>
+#include <tbprobe.h>
+
+namespace illumina {
+
+static constexpr size_t MAX_PIECES = 4;
+
+// Outcomes from the perspective of the side to move, as in the tables.
+static constexpr i8 WDL_LOSS         = -2;
+static constexpr i8 WDL_BLESSED_LOSS = -1;
+static constexpr i8 WDL_DRAW         = 0;
+static constexpr i8 WDL_CURSED_WIN   = 1;
+static constexpr i8 WDL_WIN          = 2;
+static constexpr i8 WDL_ILLEGAL      = 3;
+static constexpr i8 WDL_UNSOLVED     = 4;
+
+static constexpr i8 NO_ZEROING_MOVE = -3;
+
+//
+// Materials and positions.
+//
+
+// Pieces are coded like in the table files: their type, plus 8 if black.
+using PieceCode = ui8;
+
+static PieceCode piece_code(Color c, PieceType pt) {
+    return PieceCode(c * 8 + pt);
+}
+
+static Color code_color(PieceCode p) {
+    return Color(p >> 3);
+}
+
+static PieceType code_type(PieceCode p) {
+    return PieceType(p & 7);
+}
+
+// White pieces go first, then from kings down to pawns.
+static int code_rank(PieceCode p) {
+    return code_color(p) * 8 + (PT_KING - code_type(p));
+}
+
+struct Material {
+    std::vector<PieceCode> pieces;
+
+    size_t n_pieces() const { return pieces.size(); }
+    size_t n_positions() const { return size_t(2) << (6 * pieces.size()); }
+    bool   has_pawns(Color c) const;
+    std::string name() const;
+
+    static Material parse(const std::string& name);
+    static Material sorted(std::vector<PieceCode> pieces);
+};
+
+bool Material::has_pawns(Color c) const {
+    return std::count(pieces.begin(), pieces.end(), piece_code(c, PT_PAWN)) > 0;
+}
+
+std::string Material::name() const {
+    std::string name;
+    for (PieceCode p: pieces) {
+        if (code_color(p) == CL_BLACK && name.find('v') == std::string::npos) {
+            name += 'v';
+        }
+        name += "PNBRQK"[code_type(p) - PT_PAWN];
+    }
+    return name;
+}
+
+Material Material::parse(const std::string& name) {
+    size_t v = name.find('v');
+    if (v == std::string::npos || name.find('v', v + 1) != std::string::npos) {
+        throw std::invalid_argument("Invalid ending name '" + name + "'.");
+    }
+
+    std::vector<PieceCode> pieces;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (i == v) {
+            continue;
+        }
+        size_t pt = std::string("PNBRQK").find(name[i]);
+        if (pt == std::string::npos) {
+            throw std::invalid_argument("Invalid ending name '" + name + "'.");
+        }
+        pieces.push_back(piece_code(i < v ? CL_WHITE : CL_BLACK, PieceType(pt + PT_PAWN)));
+    }
+
+    Material material = sorted(pieces);
+    if (material.name() != name || name[0] != 'K' || name[v + 1] != 'K'
+        || std::count(name.begin(), name.end(), 'K') != 2) {
+        throw std::invalid_argument("Invalid ending name '" + name + "', expected pieces ordered like KRBvKN.");
+    }
+    return material;
+}
+
+Material Material::sorted(std::vector<PieceCode> pieces) {
+    std::stable_sort(pieces.begin(), pieces.end(), [](PieceCode a, PieceCode b) {
+        return code_rank(a) < code_rank(b);
+    });
+    return Material { pieces };
+}
+
+// Positions are indexed by the side to move and the square of every piece,
+// in the order of their material.
+struct Position {
+    std::array<Square, MAX_PIECES> squares {};
+    Color stm = CL_WHITE;
+};
+
+static size_t position_index(const Position& pos, size_t n_pieces) {
+    size_t index = pos.stm;
+    for (size_t i = 0; i < n_pieces; ++i) {
+        index = index * 64 + pos.squares[i];
+    }
+    return index;
+}
+
+static Position decode_position(size_t index, size_t n_pieces) {
+    Position pos;
+    for (size_t i = n_pieces; i-- > 0;) {
+        pos.squares[i] = Square(index & 63);
+        index >>= 6;
+    }
+    pos.stm = Color(index);
+    return pos;
+}
+
+static Bitboard occupancy(const Material& m, const Position& pos, int skip = -1) {
+    Bitboard occ = 0;
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        if (int(i) != skip) {
+            occ |= BIT(pos.squares[i]);
+        }
+    }
+    return occ;
+}
+
+static int piece_on(const Material& m, const Position& pos, Square s, int skip = -1) {
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        if (int(i) != skip && pos.squares[i] == s) {
+            return int(i);
+        }
+    }
+    return -1;
+}
+
+static Square king_square(const Material& m, const Position& pos, Color c) {
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        if (m.pieces[i] == piece_code(c, PT_KING)) {
+            return pos.squares[i];
+        }
+    }
+    return SQ_NULL;
+}
+
+static bool is_attacked(const Material& m, const Position& pos, Square s, Color by, Bitboard occ, int skip = -1) {
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        PieceCode p = m.pieces[i];
+        if (int(i) != skip && code_color(p) == by
+            && (piece_attacks(Piece(by, code_type(p)), pos.squares[i], occ) & BIT(s))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether pieces are on distinct squares, pawns off the back ranks, and
+// the side not to move out of check.
+static bool is_legal(const Material& m, const Position& pos) {
+    Bitboard occ = 0;
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        Bitboard bb = BIT(pos.squares[i]);
+        if ((occ & bb) || (code_type(m.pieces[i]) == PT_PAWN && (bb & (rank_bb(RNK_1) | rank_bb(RNK_8))))) {
+            return false;
+        }
+        occ |= bb;
+    }
+    Color them = opposite_color(pos.stm);
+    return !is_attacked(m, pos, king_square(m, pos, them), pos.stm, occ);
+}
+
+static bool in_check(const Material& m, const Position& pos) {
+    return is_attacked(m, pos, king_square(m, pos, pos.stm), opposite_color(pos.stm), occupancy(m, pos));
+}
+
+struct TbMove {
+    int       piece;
+    Square    to;
+    int       captured  = -1;
+    PieceType promotion = PT_NULL;
+
+    bool is_zeroing(const Material& m) const {
+        return captured >= 0 || code_type(m.pieces[piece]) == PT_PAWN;
+    }
+};
+
+static void add_pawn_moves(std::vector<TbMove>& moves, int piece, Square to, int captured) {
+    if (BIT(to) & (rank_bb(RNK_1) | rank_bb(RNK_8))) {
+        for (PieceType pt: { PT_QUEEN, PT_ROOK, PT_BISHOP, PT_KNIGHT }) {
+            moves.push_back({ piece, to, captured, pt });
+        }
+    }
+    else {
+        moves.push_back({ piece, to, captured });
+    }
+}
+
+// Generates the legal moves of a position. There are no castling nor en
+// passant moves, since only one side may have pawns.
+static void generate_moves(const Material& m, const Position& pos, std::vector<TbMove>& moves) {
+    moves.clear();
+    Bitboard occ = occupancy(m, pos);
+    Color    us  = pos.stm;
+
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        PieceCode p = m.pieces[i];
+        if (code_color(p) != us) {
+            continue;
+        }
+        Square from = pos.squares[i];
+
+        if (code_type(p) == PT_PAWN) {
+            Square push = pawn_push_destination(from, us);
+            if (!(occ & BIT(push))) {
+                add_pawn_moves(moves, int(i), push, -1);
+                Square double_push = pawn_push_destination(push, us);
+                if (square_rank(from) == (us == CL_WHITE ? RNK_2 : RNK_7) && !(occ & BIT(double_push))) {
+                    moves.push_back({ int(i), double_push });
+                }
+            }
+            Bitboard captures = pawn_attacks(from, us) & occ;
+            while (captures) {
+                Square to = Square(lsb(captures));
+                captures  = unset_lsb(captures);
+                int captured = piece_on(m, pos, to);
+                if (code_color(m.pieces[captured]) != us) {
+                    add_pawn_moves(moves, int(i), to, captured);
+                }
+            }
+            continue;
+        }
+
+        Bitboard targets = piece_attacks(Piece(us, code_type(p)), from, occ);
+        while (targets) {
+            Square to = Square(lsb(targets));
+            targets   = unset_lsb(targets);
+            int captured = piece_on(m, pos, to);
+            if (captured < 0 || code_color(m.pieces[captured]) != us) {
+                moves.push_back({ int(i), to, captured });
+            }
+        }
+    }
+
+    // Drop moves leaving our king in check.
+    moves.erase(std::remove_if(moves.begin(), moves.end(), [&](const TbMove& move) {
+        Position next = pos;
+        next.squares[move.piece] = move.to;
+        Bitboard next_occ = occupancy(m, next, move.captured);
+        return is_attacked(m, next, king_square(m, next, us), opposite_color(us), next_occ, move.captured);
+    }), moves.end());
+}
+
+//
+// Retrograde analysis.
+//
+
+struct Solution {
+    Material material;
+
+    // Outcome of every position, by position index.
+    std::vector<i8> wdl;
+
+    // Plies until a zeroing move or mate, for decisive positions.
+    std::vector<ui16> dtz;
+
+    // Best outcome of a zeroing move, or NO_ZEROING_MOVE if there is none.
+    std::vector<i8> zeroing;
+
+    // Number of legal moves that aren't zeroing.
+    std::vector<ui8> quiet_moves;
+};
+
+// Captures and promotions lead to another ending. Pieces are reordered
+// for it, source[k] holding the index of its k-th piece in ours.
+struct Conversion {
+    const Solution*                 solution = nullptr;
+    std::array<int, MAX_PIECES>     source {};
+};
+
+class Solver {
+public:
+    const Solution& solve(const Material& material);
+
+private:
+    struct Pass {
+        std::vector<i8>   value;
+        std::vector<ui16> level;
+        std::vector<ui8>  moves_left;
+    };
+
+    std::map<std::string, std::unique_ptr<Solution>> m_solutions;
+
+    const Conversion& conversion(const Material& material, const TbMove& move);
+    i8 zeroing_outcome(const Solution& sol, const Position& pos, const TbMove& move);
+    void solve_slice(Solution& sol, const std::vector<ui32>& slice);
+    void run_pass(Solution& sol, const std::vector<ui32>& slice, Pass& pass, bool real);
+
+    std::map<std::tuple<std::string, int, int, int>, Conversion> m_conversions;
+};
+
+const Conversion& Solver::conversion(const Material& m, const TbMove& move) {
+    auto key = std::make_tuple(m.name(), move.piece, move.captured, int(move.promotion));
+    auto it  = m_conversions.find(key);
+    if (it != m_conversions.end()) {
+        return it->second;
+    }
+
+    std::vector<int> source;
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        if (int(i) != move.captured) {
+            source.push_back(int(i));
+        }
+    }
+    auto code_of = [&](int i) {
+        return i == move.piece && move.promotion != PT_NULL
+               ? piece_code(code_color(m.pieces[i]), move.promotion)
+               : m.pieces[i];
+    };
+    std::stable_sort(source.begin(), source.end(), [&](int a, int b) {
+        return code_rank(code_of(a)) < code_rank(code_of(b));
+    });
+
+    Material next;
+    Conversion conv;
+    for (size_t k = 0; k < source.size(); ++k) {
+        next.pieces.push_back(code_of(source[k]));
+        conv.source[k] = source[k];
+    }
+    conv.solution = &solve(next);
+    return m_conversions[key] = conv;
+}
+
+// Outcome of a zeroing move, for the side making it.
+i8 Solver::zeroing_outcome(const Solution& sol, const Position& pos, const TbMove& move) {
+    const Material& m = sol.material;
+    Position next = pos;
+    next.squares[move.piece] = move.to;
+    next.stm = opposite_color(pos.stm);
+
+    const Solution* next_sol = &sol;
+    if (move.captured >= 0 || move.promotion != PT_NULL) {
+        const Conversion& conv = conversion(m, move);
+        Position converted;
+        for (size_t k = 0; k < conv.solution->material.n_pieces(); ++k) {
+            converted.squares[k] = next.squares[conv.source[k]];
+        }
+        converted.stm = next.stm;
+        next_sol = conv.solution;
+        next     = converted;
+    }
+
+    i8 wdl = next_sol->wdl[position_index(next, next_sol->material.n_pieces())];
+    if (wdl < WDL_LOSS || wdl > WDL_WIN) {
+        throw std::logic_error("Zeroing move into an unsolved position of " + next_sol->material.name() + ".");
+    }
+    return i8(-wdl);
+}
+
+const Solution& Solver::solve(const Material& m) {
+    auto it = m_solutions.find(m.name());
+    if (it != m_solutions.end()) {
+        return *it->second;
+    }
+    if (m.n_pieces() > MAX_PIECES) {
+        throw std::invalid_argument("Endings are limited to " + std::to_string(MAX_PIECES) + " pieces.");
+    }
+    if (m.has_pawns(CL_WHITE) && m.has_pawns(CL_BLACK)) {
+        throw std::invalid_argument("Endings with pawns on both sides aren't supported.");
+    }
+
+    // Solve the endings reached through captures and promotions first,
+    // so that conversions don't reenter the solver halfway.
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        for (size_t j = 0; j < m.n_pieces(); ++j) {
+            if (code_color(m.pieces[i]) == code_color(m.pieces[j]) || code_type(m.pieces[j]) == PT_KING) {
+                continue;
+            }
+            conversion(m, { int(i), SQ_A1, int(j) });
+            if (code_type(m.pieces[i]) == PT_PAWN) {
+                for (PieceType pt: { PT_QUEEN, PT_ROOK, PT_BISHOP, PT_KNIGHT }) {
+                    conversion(m, { int(i), SQ_A1, int(j), pt });
+                }
+            }
+        }
+        if (code_type(m.pieces[i]) == PT_PAWN) {
+            for (PieceType pt: { PT_QUEEN, PT_ROOK, PT_BISHOP, PT_KNIGHT }) {
+                conversion(m, { int(i), SQ_A1, -1, pt });
+            }
+        }
+    }
+
+    std::cout << "Solving " << m.name() << "..." << std::endl;
+
+    auto sol = std::make_unique<Solution>();
+    sol->material = m;
+    sol->wdl.assign(m.n_positions(), WDL_ILLEGAL);
+    sol->dtz.assign(m.n_positions(), 0);
+    sol->zeroing.assign(m.n_positions(), NO_ZEROING_MOVE);
+    sol->quiet_moves.assign(m.n_positions(), 0);
+
+    // Positions are split into slices sharing their pawn squares, solved
+    // from the most advanced pawns down, since pawn pushes lead to them.
+    std::vector<size_t> pawns, others;
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        (code_type(m.pieces[i]) == PT_PAWN ? pawns : others).push_back(i);
+    }
+
+    std::vector<std::vector<Square>> pawn_squares(1);
+    for (size_t n = 0; n < pawns.size(); ++n) {
+        std::vector<std::vector<Square>> extended;
+        for (const auto& squares: pawn_squares) {
+            for (Square s = SQ_A2; s <= SQ_H7; ++s) {
+                extended.push_back(squares);
+                extended.back().push_back(s);
+            }
+        }
+        pawn_squares = std::move(extended);
+    }
+    auto progress = [&](const std::vector<Square>& squares) {
+        int total = 0;
+        for (size_t n = 0; n < squares.size(); ++n) {
+            Color c = code_color(m.pieces[pawns[n]]);
+            total += c == CL_WHITE ? square_rank(squares[n]) : RNK_8 - square_rank(squares[n]);
+        }
+        return total;
+    };
+    std::stable_sort(pawn_squares.begin(), pawn_squares.end(), [&](const auto& a, const auto& b) {
+        return progress(a) > progress(b);
+    });
+
+    for (const auto& squares: pawn_squares) {
+        std::vector<ui32> slice;
+        size_t n_others = size_t(1) << (6 * others.size());
+        for (Color stm: COLORS) {
+            for (size_t combination = 0; combination < n_others; ++combination) {
+                Position pos;
+                pos.stm = stm;
+                for (size_t n = 0; n < pawns.size(); ++n) {
+                    pos.squares[pawns[n]] = squares[n];
+                }
+                for (size_t n = 0; n < others.size(); ++n) {
+                    pos.squares[others[n]] = Square((combination >> (6 * n)) & 63);
+                }
+                slice.push_back(ui32(position_index(pos, m.n_pieces())));
+            }
+        }
+        solve_slice(*sol, slice);
+    }
+
+    return *(m_solutions[m.name()] = std::move(sol));
+}
+
+void Solver::solve_slice(Solution& sol, const std::vector<ui32>& slice) {
+    const Material& m = sol.material;
+    std::vector<TbMove> moves;
+
+    for (ui32 index: slice) {
+        Position pos = decode_position(index, m.n_pieces());
+        if (!is_legal(m, pos)) {
+            continue;
+        }
+
+        sol.wdl[index] = WDL_UNSOLVED;
+        generate_moves(m, pos, moves);
+        for (const TbMove& move: moves) {
+            if (move.is_zeroing(m)) {
+                sol.zeroing[index] = std::max(sol.zeroing[index], zeroing_outcome(sol, pos, move));
+            }
+            else {
+                sol.quiet_moves[index]++;
+            }
+        }
+        if (moves.empty()) {
+            sol.wdl[index] = in_check(m, pos) ? WDL_LOSS : WDL_DRAW;
+        }
+    }
+
+    // Wins and losses are first solved ignoring the 50 move rule, then
+    // limited to 100 plies without zeroing moves.
+    Pass general, real;
+    run_pass(sol, slice, general, false);
+    run_pass(sol, slice, real, true);
+
+    for (ui32 index: slice) {
+        if (sol.wdl[index] == WDL_ILLEGAL) {
+            continue;
+        }
+        if (real.value[index] == WDL_WIN) {
+            sol.wdl[index] = WDL_WIN;
+            sol.dtz[index] = real.level[index];
+        }
+        else if (general.value[index] == WDL_WIN) {
+            sol.wdl[index] = WDL_CURSED_WIN;
+            sol.dtz[index] = general.level[index];
+        }
+        else if (real.value[index] == WDL_LOSS) {
+            sol.wdl[index] = WDL_LOSS;
+            sol.dtz[index] = real.level[index];
+        }
+        else if (general.value[index] == WDL_LOSS) {
+            sol.wdl[index] = WDL_BLESSED_LOSS;
+            sol.dtz[index] = general.level[index];
+        }
+        else {
+            sol.wdl[index] = WDL_DRAW;
+        }
+    }
+}
+
+void Solver::run_pass(Solution& sol, const std::vector<ui32>& slice, Pass& pass, bool real) {
+    const Material& m = sol.material;
+    pass.value.assign(m.n_positions(), WDL_DRAW);
+    pass.level.assign(m.n_positions(), 0);
+    pass.moves_left.assign(m.n_positions(), 0);
+
+    // Zeroing moves win if they reach a loss, or a blessed loss unless
+    // the 50 move rule applies.
+    i8 win_threshold = real ? WDL_WIN : WDL_CURSED_WIN;
+    std::vector<std::vector<ui32>> levels(2);
+
+    for (ui32 index: slice) {
+        i8 wdl = sol.wdl[index];
+        if (wdl == WDL_ILLEGAL) {
+            continue;
+        }
+        if (wdl != WDL_UNSOLVED) {
+            // No legal moves.
+            if (wdl == WDL_LOSS) {
+                pass.value[index] = WDL_LOSS;
+                levels[0].push_back(index);
+            }
+            continue;
+        }
+
+        i8 zeroing = sol.zeroing[index];
+        if (zeroing >= win_threshold) {
+            pass.value[index] = WDL_WIN;
+            pass.level[index] = 1;
+            levels[1].push_back(index);
+        }
+        else if (zeroing == NO_ZEROING_MOVE || zeroing <= -win_threshold) {
+            pass.moves_left[index] = sol.quiet_moves[index];
+            if (sol.quiet_moves[index] == 0) {
+                pass.value[index] = WDL_LOSS;
+                pass.level[index] = 1;
+                levels[1].push_back(index);
+            }
+        }
+    }
+
+    for (size_t level = 0; level < levels.size() && (!real || level < 100); ++level) {
+        std::vector<ui32> positions = std::move(levels[level]);
+        for (ui32 index: positions) {
+            Position pos  = decode_position(index, m.n_pieces());
+            Bitboard occ  = occupancy(m, pos);
+            Color    them = opposite_color(pos.stm);
+
+            // Parents are reached by taking back a move that isn't zeroing.
+            for (size_t i = 0; i < m.n_pieces(); ++i) {
+                PieceCode p = m.pieces[i];
+                if (code_color(p) != them || code_type(p) == PT_PAWN) {
+                    continue;
+                }
+                Bitboard sources = piece_attacks(Piece(them, code_type(p)), pos.squares[i], occ) & ~occ;
+                while (sources) {
+                    Position parent = pos;
+                    parent.squares[i] = Square(lsb(sources));
+                    parent.stm        = them;
+                    sources           = unset_lsb(sources);
+
+                    ui32 parent_index = ui32(position_index(parent, m.n_pieces()));
+                    if (sol.wdl[parent_index] == WDL_ILLEGAL || pass.value[parent_index] != WDL_DRAW) {
+                        continue;
+                    }
+                    bool decided = pass.value[index] == WDL_LOSS
+                                || (pass.moves_left[parent_index] > 0 && --pass.moves_left[parent_index] == 0);
+                    if (decided) {
+                        pass.value[parent_index] = pass.value[index] == WDL_LOSS ? WDL_WIN : WDL_LOSS;
+                        pass.level[parent_index] = ui16(level + 1);
+                        if (levels.size() <= level + 1) {
+                            levels.resize(level + 2);
+                        }
+                        levels[level + 1].push_back(parent_index);
+                    }
+                }
+            }
+        }
+        if (levels.size() <= level + 1) {
+            break;
+        }
+    }
+}
+
+//
+// Index encoding, as defined by the Syzygy format.
+//
+
+struct Encoding {
+    int  map_a1d1d4[64];
+    int  map_b1h1h7[64];
+    int  map_kk[10][64];
+    int  map_pawns[64];
+    ui64 binomial[6][64];
+    ui64 lead_pawn_idx[6][64];
+    ui64 lead_pawns_size[6][4];
+
+    Encoding();
+};
+
+static int off_diagonal(Square s) {
+    return int(square_rank(s)) - int(square_file(s));
+}
+
+static Square transpose(Square s) {
+    return Square(((s >> 3) | (s << 3)) & 63);
+}
+
+Encoding::Encoding() {
+    int code = 0;
+    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
+        if (off_diagonal(s) < 0) {
+            map_b1h1h7[s] = code++;
+        }
+    }
+
+    // Squares of the a1-d1-d4 triangle, with the diagonal last.
+    code = 0;
+    for (Square s = SQ_A1; s <= SQ_H8; ++s) {
+        if (off_diagonal(s) < 0 && square_file(s) <= FL_D && square_rank(s) <= RNK_4) {
+            map_a1d1d4[s] = code++;
+        }
+    }
+    for (Square s: { SQ_A1, SQ_B2, SQ_C3, SQ_D4 }) {
+        map_a1d1d4[s] = code++;
+    }
+
+    // Two kings with the first in the triangle, and the second one not
+    // above the diagonal if the first is on it. Both on the diagonal last.
+    std::vector<std::pair<int, Square>> both_on_diagonal;
+    code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (Square s1 = SQ_A1; s1 <= SQ_D4; ++s1) {
+            if (square_file(s1) > FL_D || off_diagonal(s1) > 0 || map_a1d1d4[s1] != idx) {
+                continue;
+            }
+            for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2) {
+                if ((king_attacks(s1) | BIT(s1)) & BIT(s2)) {
+                    continue;
+                }
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) > 0) {
+                    continue;
+                }
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) == 0) {
+                    both_on_diagonal.emplace_back(idx, s2);
+                }
+                else {
+                    map_kk[idx][s2] = code++;
+                }
+            }
+        }
+    }
+    for (const auto& [idx, s2]: both_on_diagonal) {
+        map_kk[idx][s2] = code++;
+    }
+
+    for (int k = 0; k < 6; ++k) {
+        for (int n = 0; n < 64; ++n) {
+            ui64 c = 1;
+            for (int i = 0; i < k; ++i) {
+                c = c * ui64(n - i) / ui64(i + 1);
+            }
+            binomial[k][n] = k > n ? 0 : c;
+        }
+    }
+
+    // Pawns on the edge files, and lower ranks, lead the others.
+    int available = 47;
+    for (Square s: { SQ_A2, SQ_A3, SQ_A4, SQ_A5, SQ_A6, SQ_A7,
+                     SQ_B2, SQ_B3, SQ_B4, SQ_B5, SQ_B6, SQ_B7,
+                     SQ_C2, SQ_C3, SQ_C4, SQ_C5, SQ_C6, SQ_C7,
+                     SQ_D2, SQ_D3, SQ_D4, SQ_D5, SQ_D6, SQ_D7 }) {
+        map_pawns[s]                       = available--;
+        map_pawns[mirror_horizontal(s)]    = available--;
+    }
+    for (int count = 1; count <= 5; ++count) {
+        for (BoardFile f = FL_A; f <= FL_D; ++f) {
+            ui64 idx = 0;
+            for (BoardRank r = RNK_2; r <= RNK_7; ++r) {
+                Square s = make_square(f, r);
+                lead_pawn_idx[count][s] = idx;
+                idx += binomial[count - 1][map_pawns[s]];
+            }
+            lead_pawns_size[count][f] = idx;
+        }
+    }
+}
+
+static const Encoding& encoding() {
+    static const Encoding enc;
+    return enc;
+}
+
+struct TableInfo {
+    Material material;
+    bool     symmetric         = false;
+    bool     has_pawns         = false;
+    bool     has_unique_pieces = false;
+    size_t   lead_pawns        = 0;
+};
+
+static TableInfo table_info(const Material& m) {
+    TableInfo info;
+    info.material = m;
+    std::string name = m.name();
+    size_t v = name.find('v');
+    info.symmetric = name.substr(0, v) == name.substr(v + 1);
+
+    size_t pawns[2] = { 0, 0 };
+    for (PieceCode p: m.pieces) {
+        if (code_type(p) == PT_PAWN) {
+            pawns[code_color(p)]++;
+        }
+        if (code_type(p) != PT_KING && std::count(m.pieces.begin(), m.pieces.end(), p) == 1) {
+            info.has_unique_pieces = true;
+        }
+    }
+    info.has_pawns   = pawns[0] || pawns[1];
+    info.lead_pawns  = pawns[0] ? pawns[0] : pawns[1];
+    return info;
+}
+
+// How the pieces of a table part are encoded: the order in which they
+// are listed, grouped, and where each group goes in the index.
+struct Layout {
+    std::vector<int>  pieces;
+    std::vector<int>  group_len;
+    std::vector<ui64> group_factor;
+    int               lead_order = 0;
+    ui64              size       = 0;
+};
+
+static Layout make_layout(const TableInfo& info, std::vector<int> pieces, int lead_order, BoardFile file) {
+    const Encoding& enc = encoding();
+    const Material& m   = info.material;
+
+    Layout layout;
+    layout.pieces = pieces;
+    size_t first_len = info.has_pawns ? info.lead_pawns : info.has_unique_pieces ? 3 : 2;
+    layout.group_len.push_back(int(first_len));
+    for (size_t i = first_len; i < pieces.size(); ++i) {
+        if (i > first_len && m.pieces[pieces[i]] == m.pieces[pieces[i - 1]]) {
+            layout.group_len.back()++;
+        }
+        else {
+            layout.group_len.push_back(1);
+        }
+    }
+    layout.lead_order = std::min(lead_order, int(layout.group_len.size()) - 1);
+
+    // Groups are laid out in order, with the leading one moved to its place.
+    layout.group_factor.resize(layout.group_len.size());
+    int  free_squares = 64 - int(first_len);
+    ui64 factor       = 1;
+    size_t next       = 1;
+    for (int k = 0; k < int(layout.group_len.size()); ++k) {
+        if (k == layout.lead_order) {
+            layout.group_factor[0] = factor;
+            factor *= info.has_pawns ? enc.lead_pawns_size[first_len][file]
+                    : info.has_unique_pieces ? 31332 : 462;
+        }
+        else {
+            layout.group_factor[next] = factor;
+            factor *= enc.binomial[layout.group_len[next]][free_squares];
+            free_squares -= layout.group_len[next++];
+        }
+    }
+    layout.size = factor;
+    return layout;
+}
+
+// Encodes a position, with squares given in the order of the layout.
+static ui64 encode(const TableInfo& info, const Layout& layout, std::vector<Square> squares) {
+    const Encoding& enc = encoding();
+    size_t n    = squares.size();
+    size_t lead = size_t(layout.group_len[0]);
+    ui64   idx;
+
+    auto transform = [&](Square (*f)(Square), size_t from) {
+        for (size_t i = from; i < n; ++i) {
+            squares[i] = f(squares[i]);
+        }
+    };
+
+    if (info.has_pawns) {
+        // The leading pawn goes first, on files a-d.
+        auto it = std::max_element(squares.begin(), squares.begin() + lead, [&](Square a, Square b) {
+            return enc.map_pawns[a] < enc.map_pawns[b];
+        });
+        std::iter_swap(squares.begin(), it);
+        if (square_file(squares[0]) > FL_D) {
+            transform(mirror_horizontal, 0);
+        }
+        std::sort(squares.begin() + 1, squares.begin() + lead, [&](Square a, Square b) {
+            return enc.map_pawns[a] < enc.map_pawns[b];
+        });
+        idx = enc.lead_pawn_idx[lead][squares[0]];
+        for (size_t i = 1; i < lead; ++i) {
+            idx += enc.binomial[i][enc.map_pawns[squares[i]]];
+        }
+    }
+    else {
+        // The first piece goes into the a1-d1-d4 triangle, and the first
+        // leading piece off the diagonal below it.
+        if (square_file(squares[0]) > FL_D) {
+            transform(mirror_horizontal, 0);
+        }
+        if (square_rank(squares[0]) > RNK_4) {
+            transform(mirror_vertical, 0);
+        }
+        for (size_t i = 0; i < lead; ++i) {
+            if (off_diagonal(squares[i]) > 0) {
+                transform(transpose, i);
+            }
+            if (off_diagonal(squares[i]) != 0) {
+                break;
+            }
+        }
+
+        if (info.has_unique_pieces) {
+            int s0 = squares[0], s1 = squares[1], s2 = squares[2];
+            int a1 = s1 > s0;
+            int a2 = (s2 > s0) + (s2 > s1);
+            if (off_diagonal(Square(s0))) {
+                idx = (ui64(enc.map_a1d1d4[s0]) * 63 + ui64(s1 - a1)) * 62 + ui64(s2 - a2);
+            }
+            else if (off_diagonal(Square(s1))) {
+                idx = (6 * 63 + ui64(square_rank(Square(s0))) * 28 + ui64(enc.map_b1h1h7[s1])) * 62 + ui64(s2 - a2);
+            }
+            else if (off_diagonal(Square(s2))) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62
+                    + ui64(square_rank(Square(s0))) * 7 * 28
+                    + ui64(square_rank(Square(s1)) - a1) * 28
+                    + ui64(enc.map_b1h1h7[s2]);
+            }
+            else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                    + ui64(square_rank(Square(s0))) * 7 * 6
+                    + ui64(square_rank(Square(s1)) - a1) * 6
+                    + ui64(square_rank(Square(s2)) - a2);
+            }
+        }
+        else {
+            idx = ui64(enc.map_kk[enc.map_a1d1d4[squares[0]]][squares[1]]);
+        }
+    }
+
+    idx *= layout.group_factor[0];
+    size_t start = lead;
+    for (size_t g = 1; g < layout.group_len.size(); ++g) {
+        size_t len = size_t(layout.group_len[g]);
+        std::sort(squares.begin() + start, squares.begin() + start + len);
+        ui64 combination = 0;
+        for (size_t i = 0; i < len; ++i) {
+            Square s = squares[start + i];
+            int below = int(std::count_if(squares.begin(), squares.begin() + start, [s](Square t) {
+                return t < s;
+            }));
+            combination += enc.binomial[i + 1][s - below];
+        }
+        idx += combination * layout.group_factor[g];
+        start += len;
+    }
+    return idx;
+}
+
+//
+// Compression.
+//
+
+static constexpr ui8 TBF_STM          = 1;
+static constexpr ui8 TBF_MAPPED       = 2;
+static constexpr ui8 TBF_LOSS_PLIES   = 8;
+static constexpr ui8 TBF_SINGLE_VALUE = 128;
+
+static constexpr size_t MAX_SYMBOLS     = 4095;
+static constexpr size_t MIN_PAIR_COUNT  = 16;
+static constexpr int    MAX_CODE_LENGTH = 32;
+
+struct CompressedPart {
+    std::vector<ui8> sizes;
+    std::vector<ui8> sparse_index;
+    std::vector<ui8> block_lengths;
+    std::vector<ui8> data;
+    size_t           block_size = 0;
+
+    size_t total_size() const {
+        return sizes.size() + sparse_index.size() + block_lengths.size() + data.size();
+    }
+};
+
+static void put_le16(std::vector<ui8>& out, ui64 value) {
+    out.push_back(ui8(value));
+    out.push_back(ui8(value >> 8));
+}
+
+static void put_le32(std::vector<ui8>& out, ui64 value) {
+    put_le16(out, value);
+    put_le16(out, value >> 16);
+}
+
+// Huffman code lengths of symbols, 0 for unused ones.
+static std::vector<int> code_lengths(std::vector<ui64> freq) {
+    for (;;) {
+        using Node = std::pair<ui64, size_t>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<>> queue;
+        std::vector<size_t> parent(freq.size(), 0);
+        for (size_t s = 0; s < freq.size(); ++s) {
+            if (freq[s]) {
+                queue.emplace(freq[s], s);
+            }
+        }
+        while (queue.size() > 1) {
+            auto [w1, n1] = queue.top(); queue.pop();
+            auto [w2, n2] = queue.top(); queue.pop();
+            parent.push_back(0);
+            parent[n1] = parent[n2] = parent.size() - 1;
+            queue.emplace(w1 + w2, parent.size() - 1);
+        }
+
+        std::vector<int> lengths(freq.size(), 0);
+        bool too_long = false;
+        for (size_t s = 0; s < freq.size(); ++s) {
+            if (!freq[s]) {
+                continue;
+            }
+            for (size_t node = s; parent[node]; node = parent[node]) {
+                lengths[s]++;
+            }
+            too_long |= lengths[s] > MAX_CODE_LENGTH;
+        }
+        if (!too_long) {
+            return lengths;
+        }
+        // Flatten the frequencies until codes fit.
+        for (ui64& f: freq) {
+            f = f ? f / 2 + 1 : 0;
+        }
+    }
+}
+
+// Compresses the values of a table part. Negative values don't matter,
+// and are replaced to favor compression.
+static CompressedPart compress(std::vector<int> values, ui8 flags) {
+    CompressedPart part;
+
+    int last = 0;
+    auto first = std::find_if(values.begin(), values.end(), [](int v) { return v >= 0; });
+    if (first != values.end()) {
+        last = *first;
+    }
+    for (int& v: values) {
+        v = v < 0 ? last : (last = v);
+    }
+    if (std::all_of(values.begin(), values.end(), [&](int v) { return v == values[0]; })) {
+        part.sizes = { ui8(flags | TBF_SINGLE_VALUE), ui8(values[0]) };
+        return part;
+    }
+
+    // Values are symbols, and frequent pairs of symbols become new ones.
+    struct Symbol {
+        int    left;
+        int    right;
+        size_t length;
+    };
+    std::vector<Symbol> symbols;
+    std::vector<int>    value_symbols(256, -1);
+    std::vector<ui16>   seq;
+    seq.reserve(values.size());
+    for (int v: values) {
+        if (value_symbols[v] < 0) {
+            value_symbols[v] = int(symbols.size());
+            symbols.push_back({ v, -1, 1 });
+        }
+        seq.push_back(ui16(value_symbols[v]));
+    }
+
+    std::unordered_map<ui32, size_t> counts;
+    while (symbols.size() < MAX_SYMBOLS) {
+        counts.clear();
+        for (size_t i = 0; i + 1 < seq.size(); ++i) {
+            counts[(ui32(seq[i]) << 16) | seq[i + 1]]++;
+        }
+        ui32   best       = 0;
+        size_t best_count = 0;
+        for (const auto& [pair, count]: counts) {
+            if (count > best_count && symbols[pair >> 16].length + symbols[pair & 0xFFFF].length <= 256) {
+                best       = pair;
+                best_count = count;
+            }
+        }
+        if (best_count < MIN_PAIR_COUNT) {
+            break;
+        }
+
+        ui16 left  = ui16(best >> 16);
+        ui16 right = ui16(best & 0xFFFF);
+        ui16 sym   = ui16(symbols.size());
+        symbols.push_back({ left, right, symbols[left].length + symbols[right].length });
+        size_t out = 0;
+        for (size_t i = 0; i < seq.size(); ++i) {
+            if (i + 1 < seq.size() && seq[i] == left && seq[i + 1] == right) {
+                seq[out++] = sym;
+                ++i;
+            }
+            else {
+                seq[out++] = seq[i];
+            }
+        }
+        seq.resize(out);
+    }
+
+    std::vector<ui64> freq(symbols.size(), 0);
+    for (ui16 s: seq) {
+        freq[s]++;
+    }
+    if (std::count_if(freq.begin(), freq.end(), [](ui64 f) { return f > 0; }) == 1) {
+        // A code needs two symbols, give one to an unused symbol.
+        freq[freq[0] ? 1 : 0] = 1;
+    }
+    std::vector<int> lengths = code_lengths(freq);
+
+    // Renumber symbols: unused ones first, then by decreasing code length.
+    std::vector<int> order(symbols.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        int la = lengths[a] ? lengths[a] : MAX_CODE_LENGTH + 1;
+        int lb = lengths[b] ? lengths[b] : MAX_CODE_LENGTH + 1;
+        return la > lb;
+    });
+    std::vector<int> new_id(symbols.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        new_id[order[k]] = int(k);
+    }
+
+    int max_len = 0, min_len = MAX_CODE_LENGTH;
+    for (int len: lengths) {
+        if (len) {
+            max_len = std::max(max_len, len);
+            min_len = std::min(min_len, len);
+        }
+    }
+
+    // Canonical codes: longer codes have lower values, and codes of the
+    // same length follow the symbols.
+    std::vector<ui64> codes(symbols.size(), 0);
+    std::vector<int>  lowest_sym(size_t(max_len + 2), 0);
+    ui64 code = 0;
+    int  sym  = int(std::count(lengths.begin(), lengths.end(), 0));
+    for (int len = max_len; len >= min_len; --len) {
+        lowest_sym[len] = sym;
+        for (int s: order) {
+            if (lengths[s] == len) {
+                codes[s] = code++;
+                sym++;
+            }
+        }
+        if (len > min_len) {
+            if (code & 1) {
+                throw std::logic_error("Incomplete prefix code.");
+            }
+            code /= 2;
+        }
+    }
+    if (code != (ui64(1) << min_len)) {
+        throw std::logic_error("Incomplete prefix code.");
+    }
+
+    // Try a few block sizes, keeping the smallest output.
+    for (int block_log = 5; block_log <= 10; ++block_log) {
+        size_t block_size = size_t(1) << block_log;
+        std::vector<ui8>    data;
+        std::vector<size_t> block_values;
+
+        size_t bits = 0, n_values = 0;
+        ui64   acc  = 0;
+        int    acc_bits = 0;
+        auto flush_block = [&]() {
+            if (acc_bits) {
+                data.push_back(ui8(acc << (8 - acc_bits)));
+                acc_bits = 0;
+                acc = 0;
+            }
+            data.resize(data.size() + block_size - (bits + 7) / 8, 0);
+            block_values.push_back(n_values);
+            bits = n_values = 0;
+        };
+        for (ui16 s: seq) {
+            int    len = lengths[s];
+            size_t n   = symbols[s].length;
+            if (bits + size_t(len) > 8 * block_size || n_values + n > 65536) {
+                flush_block();
+            }
+            for (int b = len - 1; b >= 0; --b) {
+                acc = (acc << 1) | ((codes[s] >> b) & 1);
+                if (++acc_bits == 8) {
+                    data.push_back(ui8(acc));
+                    acc_bits = 0;
+                    acc = 0;
+                }
+            }
+            bits     += size_t(len);
+            n_values += n;
+        }
+        flush_block();
+
+        // Sparse index entries point to values halfway through their span,
+        // blocks being sized so that they are enough to locate any value.
+        size_t avg_values = values.size() / block_values.size();
+        int    span_log   = 0;
+        while ((size_t(1) << span_log) < avg_values && span_log < 16) {
+            span_log++;
+        }
+        size_t span = size_t(1) << span_log;
+
+        CompressedPart candidate;
+        candidate.block_size = block_size;
+        candidate.data       = std::move(data);
+
+        size_t n_entries = (values.size() + span - 1) / span;
+        size_t block = 0, block_start = 0;
+        bool padding = false;
+        for (size_t k = 0; k < n_entries; ++k) {
+            size_t target = k * span + span / 2;
+            while (block < block_values.size() && target >= block_start + block_values[block]) {
+                block_start += block_values[block++];
+            }
+            padding |= block == block_values.size();
+            put_le32(candidate.sparse_index, block);
+            put_le16(candidate.sparse_index, target - block_start);
+        }
+        for (size_t n: block_values) {
+            put_le16(candidate.block_lengths, n - 1);
+        }
+        if (padding) {
+            put_le16(candidate.block_lengths, 65535);
+        }
+
+        std::vector<ui8>& sizes = candidate.sizes;
+        sizes.push_back(flags);
+        sizes.push_back(ui8(block_log));
+        sizes.push_back(ui8(span_log));
+        sizes.push_back(ui8(padding));
+        put_le32(sizes, block_values.size());
+        sizes.push_back(ui8(max_len));
+        sizes.push_back(ui8(min_len));
+        for (int len = min_len; len <= max_len; ++len) {
+            put_le16(sizes, size_t(lowest_sym[len]));
+        }
+        put_le16(sizes, symbols.size());
+        for (int s: order) {
+            int left  = symbols[s].right < 0 ? symbols[s].left : new_id[symbols[s].left];
+            int right = symbols[s].right < 0 ? 0xFFF : new_id[symbols[s].right];
+            sizes.push_back(ui8(left));
+            sizes.push_back(ui8((left >> 8) | (right << 4)));
+            sizes.push_back(ui8(right >> 4));
+        }
+        if (symbols.size() & 1) {
+            sizes.push_back(0);
+        }
+
+        if (part.sizes.empty() || candidate.total_size() < part.total_size()) {
+            part = std::move(candidate);
+        }
+    }
+    return part;
+}
+
+//
+// Table files.
+//
+
+static const ui8 WDL_MAGIC[] = { 0x71, 0xE8, 0x23, 0x5D };
+static const ui8 DTZ_MAGIC[] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+static constexpr ui8 TBH_SPLIT     = 1;
+static constexpr ui8 TBH_HAS_PAWNS = 2;
+
+struct TablePart {
+    Layout         layout;
+    CompressedPart compressed;
+    std::array<std::vector<int>, 4> dtz_maps {};
+};
+
+// Pieces listed with unique pieces first, so that pawnless tables lead
+// with them, and with the leading pawns first in pawn tables.
+static std::vector<int> piece_order(const TableInfo& info, bool reversed) {
+    const Material& m = info.material;
+    std::vector<int> lead, rest;
+    size_t lead_len = info.has_pawns ? info.lead_pawns : info.has_unique_pieces ? 3 : 2;
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        PieceCode p = m.pieces[i];
+        bool leads = info.has_pawns ? code_type(p) == PT_PAWN
+                   : info.has_unique_pieces ? (code_type(p) == PT_KING || std::count(m.pieces.begin(), m.pieces.end(), p) == 1)
+                   : code_type(p) == PT_KING;
+        (leads && lead.size() < lead_len ? lead : rest).push_back(int(i));
+    }
+    if (reversed) {
+        std::reverse(info.has_pawns ? rest.begin() : lead.begin(), info.has_pawns ? rest.end() : lead.end());
+    }
+    lead.insert(lead.end(), rest.begin(), rest.end());
+    return lead;
+}
+
+// Outcome of the best zeroing move, if it is the best move, which the
+// prober finds by searching instead of reading the DTZ table.
+static bool zeroing_is_best(const Solution& sol, size_t index) {
+    i8 wdl     = sol.wdl[index];
+    i8 zeroing = sol.zeroing[index];
+    if (zeroing == NO_ZEROING_MOVE) {
+        return false;
+    }
+    return zeroing >= wdl && (zeroing > WDL_DRAW || sol.quiet_moves[index] == 0);
+}
+
+// Value stored in DTZ tables, in moves unless loss_plies is set.
+static int stored_dtz(i8 wdl, int plies, bool loss_plies) {
+    if (wdl > 0) {
+        return (plies - 1) / 2;
+    }
+    if (plies < 2) {
+        return 0;
+    }
+    return wdl == WDL_LOSS && loss_plies ? plies - 1 : plies / 2 - 1;
+}
+
+static int dtz_bucket(i8 wdl) {
+    static const int WDL_MAP[] = { 1, 3, 0, 2, 0 };
+    return WDL_MAP[wdl + 2];
+}
+
+static void write_file(const std::string& path, const std::vector<ui8>& bytes) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path + ".");
+    }
+}
+
+static void write_table(const std::string& path, const TableInfo& info, bool dtz,
+                        const std::vector<std::array<TablePart*, 2>>& parts) {
+    const Material& m = info.material;
+    size_t sides = !dtz && !info.symmetric ? 2 : 1;
+
+    std::vector<ui8> out(dtz ? DTZ_MAGIC : WDL_MAGIC, (dtz ? DTZ_MAGIC : WDL_MAGIC) + 4);
+    out.push_back(ui8((info.symmetric ? 0 : TBH_SPLIT) | (info.has_pawns ? TBH_HAS_PAWNS : 0)));
+
+    for (const auto& file: parts) {
+        const Layout& l0 = file[0]->layout;
+        const Layout& l1 = file[sides - 1]->layout;
+        out.push_back(ui8(l0.lead_order | (l1.lead_order << 4)));
+        for (size_t k = 0; k < m.n_pieces(); ++k) {
+            out.push_back(ui8(m.pieces[l0.pieces[k]] | (m.pieces[l1.pieces[k]] << 4)));
+        }
+    }
+    out.resize(out.size() + (out.size() & 1), 0);
+
+    for (const auto& file: parts) {
+        for (size_t s = 0; s < sides; ++s) {
+            const auto& sizes = file[s]->compressed.sizes;
+            out.insert(out.end(), sizes.begin(), sizes.end());
+        }
+    }
+    if (dtz) {
+        for (const auto& file: parts) {
+            for (const auto& map: file[0]->dtz_maps) {
+                out.push_back(ui8(map.size()));
+                out.insert(out.end(), map.begin(), map.end());
+            }
+        }
+        out.resize(out.size() + (out.size() & 1), 0);
+    }
+    for (const auto& file: parts) {
+        for (size_t s = 0; s < sides; ++s) {
+            const auto& sparse = file[s]->compressed.sparse_index;
+            out.insert(out.end(), sparse.begin(), sparse.end());
+        }
+    }
+    for (const auto& file: parts) {
+        for (size_t s = 0; s < sides; ++s) {
+            const auto& lengths = file[s]->compressed.block_lengths;
+            out.insert(out.end(), lengths.begin(), lengths.end());
+        }
+    }
+    for (const auto& file: parts) {
+        for (size_t s = 0; s < sides; ++s) {
+            const auto& data = file[s]->compressed.data;
+            out.resize((out.size() + 63) & ~size_t(63), 0);
+            out.insert(out.end(), data.begin(), data.end());
+        }
+    }
+
+    // The decoder reads ahead a few bytes past the blocks.
+    out.resize(out.size() + 8, 0);
+    write_file(path, out);
+}
+
+static void generate_table(const std::string& dir, const Solution& sol) {
+    TableInfo info   = table_info(sol.material);
+    const Material& m = info.material;
+    size_t n_files   = info.has_pawns ? 4 : 1;
+
+    // Tables list positions by file part and side to move. Positions of
+    // symmetric tables are stored with white to move.
+    auto for_each_position = [&](Color stm, const std::vector<Layout>& layouts, auto&& callback) {
+        std::vector<Square> squares(m.n_pieces());
+        for (size_t index = 0; index < m.n_positions(); ++index) {
+            Position pos = decode_position(index, m.n_pieces());
+            i8 wdl = sol.wdl[index];
+            if (pos.stm != stm || wdl == WDL_ILLEGAL) {
+                continue;
+            }
+            BoardFile file = FL_A;
+            if (info.has_pawns) {
+                Square lead = SQ_NULL;
+                for (size_t i = 0; i < m.n_pieces(); ++i) {
+                    if (code_type(m.pieces[i]) == PT_PAWN
+                        && (lead == SQ_NULL || encoding().map_pawns[pos.squares[i]] > encoding().map_pawns[lead])) {
+                        lead = pos.squares[i];
+                    }
+                }
+                file = std::min(square_file(lead), square_file(mirror_horizontal(lead)));
+            }
+            const Layout& layout = layouts[file];
+            for (size_t k = 0; k < m.n_pieces(); ++k) {
+                squares[k] = pos.squares[layout.pieces[k]];
+            }
+            callback(index, file, encode(info, layout, squares));
+        }
+    };
+
+    auto fill = [&](std::vector<std::vector<int>>& values, size_t file, ui64 idx, int value, const char* what) {
+        int& slot = values[file][idx];
+        if (slot >= 0 && value >= 0 && slot != value) {
+            throw std::logic_error(std::string("Inconsistent ") + what + " values in " + m.name() + ".");
+        }
+        if (value >= 0) {
+            slot = value;
+        }
+    };
+
+    auto layouts_for = [&](bool reversed) {
+        std::vector<Layout> layouts;
+        for (size_t f = 0; f < n_files; ++f) {
+            layouts.push_back(make_layout(info, piece_order(info, reversed), reversed ? 1 : 0, BoardFile(f)));
+        }
+        return layouts;
+    };
+
+    // WDL table. Sides use different piece orders.
+    std::array<std::vector<TablePart>, 2> wdl_parts;
+    size_t wdl_sides = info.symmetric ? 1 : 2;
+    for (size_t s = 0; s < wdl_sides; ++s) {
+        std::vector<Layout> layouts = layouts_for(s == 1);
+        std::vector<std::vector<int>> values;
+        for (const Layout& l: layouts) {
+            values.emplace_back(l.size, -1);
+        }
+        for_each_position(Color(s), layouts, [&](size_t index, size_t file, ui64 idx) {
+            fill(values, file, idx, sol.wdl[index] + 2, "WDL");
+        });
+        for (size_t f = 0; f < n_files; ++f) {
+            wdl_parts[s].push_back({ layouts[f], compress(values[f], 0), {} });
+        }
+    }
+
+    // DTZ table, holding the side to move giving the smallest file.
+    bool loss_plies = false;
+    for (size_t index = 0; index < m.n_positions(); ++index) {
+        loss_plies |= sol.wdl[index] == WDL_LOSS && sol.dtz[index] >= 100;
+    }
+
+    std::vector<TablePart> dtz_parts;
+    size_t dtz_sides = info.symmetric ? 1 : 2;
+    std::array<std::vector<TablePart>, 2> candidates;
+    for (size_t s = 0; s < dtz_sides; ++s) {
+        std::vector<Layout> layouts = layouts_for(false);
+        std::vector<std::array<std::vector<int>, 4>> maps(n_files);
+
+        // Values are mapped to their rank among those of their outcome.
+        std::vector<std::array<std::vector<bool>, 4>> used(n_files);
+        for_each_position(Color(s), layouts, [&](size_t index, size_t file, ui64) {
+            i8 wdl = sol.wdl[index];
+            if (wdl != WDL_DRAW && !zeroing_is_best(sol, index)) {
+                auto& u = used[file][dtz_bucket(wdl)];
+                size_t v = size_t(stored_dtz(wdl, sol.dtz[index], loss_plies));
+                if (u.size() <= v) {
+                    u.resize(v + 1, false);
+                }
+                u[v] = true;
+            }
+        });
+        std::vector<std::array<std::vector<int>, 4>> ranks(n_files);
+        for (size_t f = 0; f < n_files; ++f) {
+            for (size_t b = 0; b < 4; ++b) {
+                ranks[f][b].assign(used[f][b].size(), -1);
+                for (size_t v = 0; v < used[f][b].size(); ++v) {
+                    if (used[f][b][v]) {
+                        ranks[f][b][v] = int(maps[f][b].size());
+                        maps[f][b].push_back(int(v));
+                    }
+                }
+                if (maps[f][b].size() > 255) {
+                    throw std::runtime_error("Too many DTZ values in " + m.name() + ".");
+                }
+            }
+        }
+
+        std::vector<std::vector<int>> values;
+        for (const Layout& l: layouts) {
+            values.emplace_back(l.size, -1);
+        }
+        for_each_position(Color(s), layouts, [&](size_t index, size_t file, ui64 idx) {
+            i8 wdl = sol.wdl[index];
+            int value = -1;
+            if (wdl != WDL_DRAW && !zeroing_is_best(sol, index)) {
+                value = ranks[file][dtz_bucket(wdl)][size_t(stored_dtz(wdl, sol.dtz[index], loss_plies))];
+            }
+            fill(values, file, idx, value, "DTZ");
+        });
+
+        ui8 flags = ui8((s ? TBF_STM : 0) | TBF_MAPPED | (loss_plies ? TBF_LOSS_PLIES : 0));
+        for (size_t f = 0; f < n_files; ++f) {
+            candidates[s].push_back({ layouts[f], compress(values[f], flags), maps[f] });
+        }
+    }
+    for (size_t f = 0; f < n_files; ++f) {
+        bool second = dtz_sides == 2
+                   && candidates[1][f].compressed.total_size() < candidates[0][f].compressed.total_size();
+        dtz_parts.push_back(std::move(candidates[second][f]));
+    }
+
+    std::vector<std::array<TablePart*, 2>> wdl_files, dtz_files;
+    for (size_t f = 0; f < n_files; ++f) {
+        wdl_files.push_back({ &wdl_parts[0][f], &wdl_parts[wdl_sides - 1][f] });
+        dtz_files.push_back({ &dtz_parts[f], &dtz_parts[f] });
+    }
+    write_table(dir + "/" + m.name() + ".rtbw", info, false, wdl_files);
+    write_table(dir + "/" + m.name() + ".rtbz", info, true, dtz_files);
+    std::cout << "Wrote " << m.name() << " tables." << std::endl;
+}
+
+//
+// Verification through the prober.
+//
+
+static bool sampled(size_t index, size_t n_pieces) {
+    // Every position of small tables, a fixed sample of larger ones.
+    return n_pieces <= 3 || ((index * 0x9E3779B97F4A7C15ull) >> 60) == 0;
+}
+
+static std::array<Bitboard, 8> probe_bitboards(const Material& m, const Position& pos, bool flip) {
+    // White, black, then kings down to pawns.
+    std::array<Bitboard, 8> bbs {};
+    for (size_t i = 0; i < m.n_pieces(); ++i) {
+        Square   s  = flip ? mirror_vertical(pos.squares[i]) : pos.squares[i];
+        Color    c  = Color(code_color(m.pieces[i]) ^ flip);
+        bbs[c]                                 |= BIT(s);
+        bbs[2 + PT_KING - code_type(m.pieces[i])] |= BIT(s);
+    }
+    return bbs;
+}
+
+static void verify_table(const Solution& sol) {
+    const Material& m = sol.material;
+    std::vector<unsigned> results(TB_MAX_MOVES);
+    size_t n_checked = 0;
+
+    for (size_t index = 0; index < m.n_positions(); ++index) {
+        i8 wdl = sol.wdl[index];
+        if (wdl == WDL_ILLEGAL || !sampled(index, m.n_pieces())) {
+            continue;
+        }
+        Position pos = decode_position(index, m.n_pieces());
+
+        for (bool flip: { false, true }) {
+            auto bbs = probe_bitboards(m, pos, flip);
+            bool white_to_move = (pos.stm == CL_WHITE) != flip;
+            unsigned probed = tb_probe_wdl(bbs[0], bbs[1], bbs[2], bbs[3], bbs[4], bbs[5], bbs[6], bbs[7],
+                                           0, 0, 0, white_to_move);
+            if (probed != unsigned(wdl + 2)) {
+                throw std::runtime_error("WDL mismatch in " + m.name() + " at position " + std::to_string(index)
+                                         + ": expected " + std::to_string(wdl + 2)
+                                         + ", probed " + std::to_string(int(probed)) + ".");
+            }
+        }
+        n_checked++;
+
+        // DTZ is checked on fewer positions, since it probes every move.
+        if (wdl == WDL_DRAW || ((index * 0x2545F4914F6CDD1Dull) >> 58) != 0) {
+            continue;
+        }
+        auto bbs = probe_bitboards(m, pos, false);
+        unsigned root = tb_probe_root(bbs[0], bbs[1], bbs[2], bbs[3], bbs[4], bbs[5], bbs[6], bbs[7],
+                                      0, 0, 0, pos.stm == CL_WHITE, results.data());
+        if (root == TB_RESULT_CHECKMATE && wdl == WDL_LOSS && sol.dtz[index] == 0) {
+            continue;
+        }
+
+        int expected;
+        if (zeroing_is_best(sol, index)) {
+            expected = wdl == WDL_WIN ? 1 : wdl == WDL_CURSED_WIN ? 101 : wdl == WDL_BLESSED_LOSS ? 101 : 1;
+        }
+        else {
+            int plies = sol.dtz[index];
+            expected  = wdl > 0 ? plies : std::max(plies - 1, 1);
+            expected += (wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS) ? 100 : 0;
+        }
+        int  probed   = int(TB_GET_DTZ(root));
+        bool matching = root != TB_RESULT_FAILED
+                     && int(TB_GET_WDL(root)) == wdl + 2
+                     && std::abs(probed - expected) <= 1;
+        if (!matching) {
+            throw std::runtime_error("DTZ mismatch in " + m.name() + " at position " + std::to_string(index)
+                                     + ": expected " + std::to_string(expected)
+                                     + ", probed " + std::to_string(probed) + ".");
+        }
+    }
+    std::cout << "Checked " << n_checked << " positions of " << m.name() << "." << std::endl;
+}
+
+static int run(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <directory> <ending>..." << std::endl;
+        return 1;
+    }
+    init();
+
+    std::string dir = argv[1];
+    Solver solver;
+    std::vector<const Solution*> written;
+    for (int i = 2; i < argc; ++i) {
+        const Solution& sol = solver.solve(Material::parse(argv[i]));
+        generate_table(dir, sol);
+        written.push_back(&sol);
+    }
+
+    if (!tb_init(dir.c_str()) || TB_LARGEST == 0) {
+        std::cerr << "Failed to load the tables from " << dir << "." << std::endl;
+        return 1;
+    }
+    for (const Solution* sol: written) {
+        verify_table(*sol);
+    }
+    tb_free();
+    return 0;
+}
+
+} // illumina
+
+int main(int argc, char* argv[]) {
+    try {
+        return illumina::run(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}